@@ -1,6 +1,7 @@
 #include <QCoreApplication>
 #include <VApp>
 #include <VFile> // for VERR_INVALID_FILENAME
+#include <SnoopCapture>
 #include "explicit_link.h"
 #include "param.h"
 #include "main.h"
@@ -39,9 +40,21 @@ bool Main::doOpen()
 bool Main::doClose()
 {
   graph.close();
+  printStats();
   return true;
 }
 
+void Main::printStats()
+{
+  int _count = graph.objectList.count();
+  for (int i = 0; i < _count; i++)
+  {
+    SnoopCapture* capture = dynamic_cast<SnoopCapture*>(graph.objectList.at(i));
+    if (capture == NULL) continue;
+    printf("%s %s\n", qPrintable(capture->name), qPrintable(capture->stats.str()));
+  }
+}
+
 void Main::terminate()
 {
   LOG_DEBUG("terminate application");
@@ -35,6 +35,9 @@ public:
   QString fileName;
   VGraph  graph;
 
+protected:
+  void printStats();
+
 public slots:
   void terminate();
 };
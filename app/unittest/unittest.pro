@@ -17,4 +17,7 @@ TEMPLATE  = app
 DESTDIR   = ../../bin
 
 SOURCES += main.cpp \
-    ../../include/common/snoopautodetectadapter.cpp
+    ../../include/common/snoopautodetectadapter.cpp \
+    ../../include/capture/snoopfile.cpp \
+    ../../include/capture/snoopfilemap.cpp \
+    ../../include/process/snoopxdpoffload.cpp
@@ -2,6 +2,11 @@
 #include <SnoopTcp> // for SnoopTcp::checksum
 #include <VDebugNew>
 
+#ifdef linux
+#include <QFile>
+#include <linux/if_packet.h>
+#endif // linux
+
 REGISTER_METACLASS(SnoopArpSpoof, SnoopCapture)
 
 // ----------------------------------------------------------------------------
@@ -215,6 +220,8 @@ SnoopArpSpoof::SnoopArpSpoof(void* owner) : SnoopAdapter(owner), sessionList(thi
   virtualMac            = Mac::cleanMac();
   selfRelay             = true;
   disableAutoRouting    = true;
+  ignoreOutgoing        = true;
+  kernelForward         = false;
   infectInterval        = 1000; // 1 sec
   sessionList.clear();
 
@@ -223,6 +230,8 @@ SnoopArpSpoof::SnoopArpSpoof(void* owner) : SnoopAdapter(owner), sessionList(thi
   findHost.scanInterval = 1000;
   findHost.sendInterval = 0;
   infectThread          = NULL;
+  m_kernelIgnoreOutgoing = false;
+  m_kernelForwardOpened = false;
 }
 
 SnoopArpSpoof::~SnoopArpSpoof()
@@ -238,11 +247,24 @@ bool SnoopArpSpoof::doOpen()
     return true;
   }
   
+  if (kernelForward)
+  {
+#ifndef linux
+    SET_ERROR(SnoopError, "kernel forward is supported only on linux", VERR_NOT_SUPPORTED);
+    return false;
+#endif // linux
+    if (filter == "")
+    {
+      SET_ERROR(SnoopError, "kernel forward needs filter selecting flows relayed here", VERR_NOT_SUPPORTED);
+      return false;
+    }
+  }
+
   //
   // Inherited open
   //
   QString tempFilter = filter;
-  filter = "ip or arp";
+  filter = kernelForward ? "arp or (" + tempFilter + ")" : "ip or arp"; // other flows stay in kernel
   bool res = SnoopAdapter::doOpen();
   filter = tempFilter;
   if (!res) return false;
@@ -262,6 +284,26 @@ bool SnoopArpSpoof::doOpen()
   }
   LOG_DEBUG("realVirtualMac=%s", qPrintable(realVirtualMac.str()));
 
+  //
+  // Fanout replica only keeps write handle, the original object infects and relays.
+  //
+  if (replica) return true;
+
+  setIgnoreOutgoing();
+
+  //
+  // Kernel forwards only frames sent to its own mac
+  //
+  if (kernelForward)
+  {
+    if (realVirtualMac != netInfo.mac)
+    {
+      SET_ERROR(SnoopError, qformat("kernel forward can not use virtual mac(%s)", qPrintable(realVirtualMac.str())), VERR_NOT_SUPPORTED);
+      return false;
+    }
+    if (!openKernelForward()) return false;
+  }
+
   //
   // Retrieve unknown mac host list
   //
@@ -280,7 +322,7 @@ bool SnoopArpSpoof::doOpen()
   //
   // Disable Auto Routing
   //
-  if (disableAutoRouting)
+  if (disableAutoRouting && !kernelForward)
   {
     static bool done = false;
     if (!done)
@@ -333,6 +375,8 @@ bool SnoopArpSpoof::doClose()
     return true;
   }
   
+  if (replica) return SnoopAdapter::doClose();
+
   bpFilter.close();
   SAFE_DELETE(infectThread);
   for (int i = 0; i < 3; i++)
@@ -340,6 +384,7 @@ bool SnoopArpSpoof::doClose()
     sendArpRecoverAll();
     msleep(100); // gilgil temp 2014.03.29
   }
+  closeKernelForward();
   return SnoopAdapter::doClose();
 }
 
@@ -348,6 +393,15 @@ int SnoopArpSpoof::read(SnoopPacket* packet)
   int res = SnoopAdapter::read(packet);
   if (res <= 0) return res;
 
+  //
+  // Own relayed frame read back(kernel could not drop it)?
+  //
+  if (ignoreOutgoing && packet->ethHdr != NULL && packet->ethHdr->ether_shost == realVirtualMac)
+  {
+    stats.selfFrames++;
+    return 0;
+  }
+
   //
   // If ARP packet?
   //
@@ -380,7 +434,7 @@ int SnoopArpSpoof::read(SnoopPacket* packet)
       if (!bpFilter._check(packet->pktData, (UINT)packet->pktHdr->caplen))
       {
         emit capturedOther(packet);
-        relay(packet);
+        if (!m_kernelForwardOpened) relay(packet); // kernel forwards it
         res = 0;
       }
       break;
@@ -400,6 +454,14 @@ int SnoopArpSpoof::read(SnoopPacket* packet)
   return res;
 }
 
+int SnoopArpSpoof::readBurst(SnoopPacketBatch& batch, int max)
+{
+  //
+  // Every packet must pass through read() for session lookup and relay.
+  //
+  return SnoopCapture::readBurst(batch, max);
+}
+
 int SnoopArpSpoof::write(SnoopPacket* packet)
 {
   return SnoopAdapter::write(packet);
@@ -423,7 +485,181 @@ bool SnoopArpSpoof::relay(SnoopPacket* packet)
     packet->tcpHdr->th_sum = htons(newChecksum);
   }
   // --------------------------------
-  return write(packet);
+  bool res = write(packet) > 0; // VERR_FAIL is not a relay
+  if (res && m_kernelIgnoreOutgoing) stats.selfFrames++;
+  return res;
+}
+
+void SnoopArpSpoof::setIgnoreOutgoing()
+{
+  m_kernelIgnoreOutgoing = false;
+  if (!ignoreOutgoing) return;
+
+  //
+  // Self relay reads frames that this host sends to realVirtualMac, so they must stay visible.
+  // Own frames are then skipped by source mac in read().
+  //
+  if (selfRelay && realVirtualMac != netInfo.mac)
+  {
+    LOG_DEBUG("self relay reads outgoing frames, ignore outgoing by source mac only");
+    return;
+  }
+
+#ifdef linux
+#ifdef PACKET_IGNORE_OUTGOING
+  int one = 1;
+  if (setsockopt(pcap_fileno(m_pcap), SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) == 0)
+  {
+    m_kernelIgnoreOutgoing = true;
+    return;
+  }
+  LOG_DEBUG("setsockopt(PACKET_IGNORE_OUTGOING) failed(%s)", strerror(errno));
+#endif // PACKET_IGNORE_OUTGOING
+  if (pcap_setdirection(m_pcap, PCAP_D_IN) == 0)
+  {
+    m_kernelIgnoreOutgoing = true;
+    return;
+  }
+  LOG_DEBUG("pcap_setdirection(PCAP_D_IN) failed(%s)", pcap_geterr(m_pcap));
+#endif // linux
+}
+
+#ifdef linux
+static QString readProc(QString path)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) return "";
+  return QString(file.readAll()).trimmed();
+}
+
+static bool writeProc(QString path, QString value)
+{
+  if (value == "") return false;
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) return false;
+  return file.write((value + "\n").toLatin1()) > 0;
+}
+
+static bool runIptables(QStringList args, QString& errorStr)
+{
+  QProcess process;
+  process.start("iptables", args);
+  if (!process.waitForFinished())
+  {
+    errorStr = "can not run iptables " + args.join(" ");
+    return false;
+  }
+  if (process.exitCode() != 0)
+  {
+    errorStr = QString(process.readAllStandardError()).trimmed();
+    return false;
+  }
+  return true;
+}
+
+static QString forwardChain(QString devName)
+{
+  return "SNOOP_AS_" + devName; // iptables chain name is at most 28 characters
+}
+#endif // linux
+
+bool SnoopArpSpoof::openKernelForward()
+{
+#ifdef linux
+  QString devName = SnoopInterfaces::instance().at(adapterIndex).name;
+  QString chain   = forwardChain(devName);
+
+  //
+  // Netfilter sees packets from ip header, so filter is compiled for raw ip(xt_bpf bytecode).
+  //
+  pcap_t* pcap = pcap_open_dead(DLT_RAW, snoop::DEFAULT_SNAPLEN);
+  if (pcap == NULL)
+  {
+    SET_ERROR(SnoopError, "error in pcap_open_dead return NULL", VERR_IN_PCAP_OPEN_DEAD);
+    return false;
+  }
+  bpf_program code;
+  if (pcap_compile(pcap, &code, qPrintable(filter), 1, 0xFFFFFFFF) < 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_compile(%s)", pcap_geterr(pcap)), VERR_IN_PCAP_COMPILE);
+    pcap_close(pcap);
+    return false;
+  }
+  QString bytecode = QString::number(code.bf_len);
+  for (u_int i = 0; i < code.bf_len; i++)
+  {
+    bpf_insn& insn = code.bf_insns[i];
+    bytecode += qformat(",%u %u %u %u", insn.code, insn.jt, insn.jf, insn.k);
+  }
+  pcap_freecode(&code);
+  pcap_close(pcap);
+
+  //
+  // Flows matching filter are dropped in FORWARD, so that only relay() sends them.
+  //
+  QString errorStr;
+  QStringList args;
+  args << "-N" << chain;
+  runIptables(args, errorStr); // may be left by previous run
+  m_kernelForwardOpened = true;
+  args.clear(); args << "-F" << chain;
+  bool res = runIptables(args, errorStr);
+  if (res)
+  {
+    args.clear(); args << "-A" << chain << "-i" << devName << "-m" << "bpf" << "--bytecode" << bytecode << "-j" << "DROP";
+    res = runIptables(args, errorStr);
+  }
+  if (res)
+  {
+    args.clear(); args << "-I" << "FORWARD" << "-j" << chain;
+    res = runIptables(args, errorStr);
+  }
+  if (!res)
+  {
+    SET_ERROR(SnoopError, qformat("error in iptables(%s)", qPrintable(errorStr)), VERR_RUN_PROCESS);
+    return false;
+  }
+
+  //
+  // Packets leave through the interface they came in, which would make kernel send ICMP redirect.
+  //
+  m_oldIpForward        = readProc("/proc/sys/net/ipv4/ip_forward");
+  m_oldSendRedirects[0] = readProc("/proc/sys/net/ipv4/conf/all/send_redirects");
+  m_oldSendRedirects[1] = readProc("/proc/sys/net/ipv4/conf/" + devName + "/send_redirects");
+  if (!writeProc("/proc/sys/net/ipv4/ip_forward", "1"))
+  {
+    SET_ERROR(SnoopError, "can not enable /proc/sys/net/ipv4/ip_forward", VERR_RUN_PROCESS);
+    return false;
+  }
+  writeProc("/proc/sys/net/ipv4/conf/all/send_redirects", "0");
+  writeProc("/proc/sys/net/ipv4/conf/" + devName + "/send_redirects", "0");
+  LOG_DEBUG("kernel forward opened(%s %s)", qPrintable(chain), qPrintable(filter));
+#endif // linux
+  return true;
+}
+
+void SnoopArpSpoof::closeKernelForward()
+{
+  if (!m_kernelForwardOpened) return;
+  m_kernelForwardOpened = false;
+#ifdef linux
+  QString devName = SnoopInterfaces::instance().at(adapterIndex).name;
+  QString chain   = forwardChain(devName);
+
+  writeProc("/proc/sys/net/ipv4/ip_forward", m_oldIpForward);
+  writeProc("/proc/sys/net/ipv4/conf/all/send_redirects", m_oldSendRedirects[0]);
+  writeProc("/proc/sys/net/ipv4/conf/" + devName + "/send_redirects", m_oldSendRedirects[1]);
+  m_oldIpForward = m_oldSendRedirects[0] = m_oldSendRedirects[1] = "";
+
+  QString errorStr;
+  QStringList args;
+  args << "-D" << "FORWARD" << "-j" << chain;
+  if (!runIptables(args, errorStr)) LOG_WARN("error in iptables(%s)", qPrintable(errorStr));
+  args.clear(); args << "-F" << chain;
+  runIptables(args, errorStr);
+  args.clear(); args << "-X" << chain;
+  if (!runIptables(args, errorStr)) LOG_WARN("error in iptables(%s)", qPrintable(errorStr));
+#endif // linux
 }
 
 bool SnoopArpSpoof::retrieveUnknownMacHostList()
@@ -803,6 +1039,8 @@ void SnoopArpSpoof::load(VXml xml)
   virtualMac         = xml.getStr("virtualMac", virtualMac.str());
   selfRelay          = xml.getBool("selfRelay", selfRelay);
   disableAutoRouting = xml.getBool("disableAutoRouting", disableAutoRouting);
+  ignoreOutgoing     = xml.getBool("ignoreOutgoing", ignoreOutgoing);
+  kernelForward      = xml.getBool("kernelForward", kernelForward);
   infectInterval     = xml.getULong("infectInterval", infectInterval);
   sessionList.load(xml.gotoChild("sessionList"));
 }
@@ -814,6 +1052,8 @@ void SnoopArpSpoof::save(VXml xml)
   xml.setStr("virtualMac",          virtualMac.str());
   xml.setBool("selfRelay",          selfRelay);
   xml.setBool("disableAutoRouting", disableAutoRouting);
+  xml.setBool("ignoreOutgoing",     ignoreOutgoing);
+  xml.setBool("kernelForward",      kernelForward);
   xml.setULong("infectInterval", infectInterval);
   sessionList.save(xml.gotoChild("sessionList"));
 }
@@ -826,6 +1066,8 @@ void SnoopArpSpoof::optionAddWidget(QLayout* layout)
   VOptionable::addLineEdit(layout, "leVirtualMac", "Virtual Mac", virtualMac.str());
   VOptionable::addCheckBox(layout, "chkSelfRelay", "Self Relay", selfRelay);
   VOptionable::addCheckBox(layout, "chkDisableAutoRouting", "Disable Auto Routing", disableAutoRouting);
+  VOptionable::addCheckBox(layout, "chkIgnoreOutgoing", "Ignore Outgoing", ignoreOutgoing);
+  VOptionable::addCheckBox(layout, "chkKernelForward", "Kernel Forward", kernelForward);
   VOptionable::addLineEdit(layout, "leInfectInterval", "Infect Interval", QString::number(infectInterval));
   sessionList.optionAddWidget(layout);
 }
@@ -837,6 +1079,8 @@ void SnoopArpSpoof::optionSaveDlg(QDialog* dialog)
   virtualMac = dialog->findChild<QLineEdit*>("leVirtualMac")->text();
   selfRelay  = dialog->findChild<QCheckBox*>("chkSelfRelay")->checkState() == Qt::Checked;
   disableAutoRouting  = dialog->findChild<QCheckBox*>("chkDisableAutoRouting")->checkState() == Qt::Checked;
+  ignoreOutgoing = dialog->findChild<QCheckBox*>("chkIgnoreOutgoing")->checkState() == Qt::Checked;
+  kernelForward  = dialog->findChild<QCheckBox*>("chkKernelForward")->checkState() == Qt::Checked;
   infectInterval = dialog->findChild<QLineEdit*>("leInfectInterval")->text().toULong();
   sessionList.optionSaveDlg(dialog);
 }
@@ -16,7 +16,6 @@
 #include <SnoopNetInfo>
 #include <SnoopFindHost>
 #include <SnoopBpFilter>
-#include <SnoopBpFilter>
 
 // ----------------------------------------------------------------------------
 // SnoopArpSpoofSession
@@ -160,6 +159,7 @@ protected:
 
 public:
   virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
   virtual int write(SnoopPacket* packet);
   virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
 
@@ -172,6 +172,8 @@ public:
   Mac                        virtualMac;
   bool                       selfRelay;
   bool                       disableAutoRouting;
+  bool                       ignoreOutgoing; // do not read back own relayed frames
+  bool                       kernelForward;  // linux : kernel forwards flows not matching filter, only matching ones are relayed here
   VTimeout                   infectInterval;
   SnoopArpSpoofSessionList   sessionList;
 
@@ -181,9 +183,16 @@ protected:
   SnoopFindHost              findHost;
   SnoopBpFilter              bpFilter;
   SnoopArpSpoofInfectThread* infectThread;
+  bool                       m_kernelIgnoreOutgoing; // outgoing frames are dropped by kernel(linux)
+  bool                       m_kernelForwardOpened;
+  QString                    m_oldIpForward;
+  QString                    m_oldSendRedirects[2]; // all, adapter
 
 protected:
   bool retrieveUnknownMacHostList();
+  void setIgnoreOutgoing();
+  bool openKernelForward();
+  void closeKernelForward();
 
 protected:
   bool sendArpInfect(SnoopArpSpoofSession& session);
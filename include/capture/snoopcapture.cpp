@@ -1,6 +1,33 @@
 #include <SnoopCapture>
 #include <VDebugNew>
 
+// ----------------------------------------------------------------------------
+// SnoopCaptureStats
+// ----------------------------------------------------------------------------
+void SnoopCaptureStats::clear()
+{
+  packets     = 0;
+  bytes       = 0;
+  relayed     = 0;
+  dropped     = 0;
+  kernelDrops = 0;
+  ifDrops     = 0;
+  readErrors  = 0;
+  txPackets   = 0;
+  txDrops     = 0;
+  txBlocked   = 0;
+  selfFrames  = 0;
+}
+
+QString SnoopCaptureStats::str()
+{
+  return qformat("packets=%llu bytes=%llu relayed=%llu dropped=%llu kernelDrops=%llu ifDrops=%llu readErrors=%llu txPackets=%llu txDrops=%llu txBlocked=%llu selfFrames=%llu",
+    (unsigned long long)packets, (unsigned long long)bytes, (unsigned long long)relayed, (unsigned long long)dropped,
+    (unsigned long long)kernelDrops, (unsigned long long)ifDrops, (unsigned long long)readErrors,
+    (unsigned long long)txPackets, (unsigned long long)txDrops, (unsigned long long)txBlocked,
+    (unsigned long long)selfFrames);
+}
+
 // ----------------------------------------------------------------------------
 // SnoopCapture
 // ----------------------------------------------------------------------------
@@ -9,6 +36,14 @@ SnoopCapture::SnoopCapture(void* owner) : VObject(owner)
   enabled   = true;
   autoRead  = true;
   autoParse = true;
+  burstSize = 1;
+  statsInterval = 1000; // 1 sec
+  workerIndex = 0;
+  replica   = false;
+  stats.clear();
+  m_statsTick = 0;
+  m_captureType = SnoopCaptureType::None;
+  driver    = NULL;
   packet.clear();
 }
 
@@ -18,6 +53,16 @@ SnoopCapture::~SnoopCapture()
 
 bool SnoopCapture::doOpen()
 {
+  stats.clear();
+  m_statsTick = tick();
+  if (driver != NULL)
+  {
+    //
+    // Driver may dispatch at once, and read checks VState::Opened(same as thread below).
+    //
+    this->m_state = VState::Opened;
+    driver->attach(this);
+  } else
   if (autoRead)
   {
     // ----- by gilgil 2009.08.31 -----
@@ -46,6 +91,25 @@ int SnoopCapture::read(SnoopPacket* packet)
   return -1;
 }
 
+//
+// Default burst read delivers one packet per call using read().
+// Captures that can fetch several frames per system call override this.
+//
+int SnoopCapture::readBurst(SnoopPacketBatch& batch, int max)
+{
+  Q_UNUSED(max)
+  batch.clear();
+  SnoopPacket* packet = batch.next();
+  if (packet == NULL) return 0;
+  int res = read(packet);
+  if (res <= 0)
+  {
+    batch.clear();
+    return res;
+  }
+  return batch.count;
+}
+
 int SnoopCapture::write(SnoopPacket* packet)
 {
   Q_UNUSED(packet)
@@ -121,22 +185,116 @@ bool SnoopCapture::relay(SnoopPacket* packet)
   return false;
 }
 
-void SnoopCapture::run()
+bool SnoopCapture::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  Q_UNUSED(drops)
+  Q_UNUSED(ifDrops)
+  return false;
+}
+
+void SnoopCapture::sampleStats(bool force)
+{
+  if (!force)
+  {
+    if (statsInterval <= 0) return;
+    VTick now = tick();
+    if (now - m_statsTick < (VTick)statsInterval) return;
+    m_statsTick = now;
+  }
+  UINT64 drops, ifDrops;
+  if (kernelStats(drops, ifDrops))
+  {
+    stats.kernelDrops = drops;
+    stats.ifDrops     = ifDrops;
+  }
+}
+
+void SnoopCapture::count(SnoopPacket* packet, bool relayed)
+{
+  stats.packets++;
+  stats.bytes += packet->pktHdr->caplen;
+  if (packet->drop) stats.dropped++;
+  if (relayed) stats.relayed++;
+}
+
+void SnoopCapture::dispatchBegin()
 {
-  SnoopCaptureType _captureType = captureType();
+  m_captureType = captureType();
+  if (burstSize > 1) batch.reserve(burstSize);
   emit opened();
-  while (runThread().active())
+}
+
+int SnoopCapture::dispatch()
+{
+  sampleStats();
+  int res = burstSize > 1 ? dispatchBurst() : dispatchOne();
+  //
+  // Frames relayed in this round go out together, read timeout(res == 0) bounds their delay.
+  //
+  flushTx();
+  return res;
+}
+
+int SnoopCapture::dispatchOne()
+{
+  int res = read(&packet);
+  if (res == 0) return 0;
+  if (res < 0)
+  {
+    stats.readErrors++;
+    return res;
+  }
+  emit captured(&packet);
+  bool relayed = false;
+  if (m_captureType == SnoopCaptureType::InPath && !packet.drop)
+    relayed = relay(&packet);
+  count(&packet, relayed);
+  return res;
+}
+
+int SnoopCapture::dispatchBurst()
+{
+  int res = readBurst(batch, burstSize);
+  if (res == 0) return 0;
+  if (res < 0)
+  {
+    stats.readErrors++;
+    return res;
+  }
+  emit capturedBurst(&batch);
+  //
+  // Per packet signal is emitted only when someone is listening to it.
+  //
+  bool perPacket = receivers(SIGNAL(captured(SnoopPacket*))) > 0;
+  for (int i = 0; i < batch.count; i++)
   {
-    int res = read(&packet);
-    if (res == 0) continue;
-    if (res < 0) break;
-    emit captured(&packet);
-    if (_captureType == SnoopCaptureType::InPath && !packet.drop)
-      relay(&packet);
+    SnoopPacket* packet = batch.at(i);
+    if (perPacket) emit captured(packet);
+    bool relayed = false;
+    if (m_captureType == SnoopCaptureType::InPath && !packet->drop)
+      relayed = relay(packet);
+    count(packet, relayed);
   }
+  return res;
+}
+
+void SnoopCapture::dispatchEnd()
+{
+  flushTx();
+  sampleStats(true);
   emit closed();
 }
 
+void SnoopCapture::run()
+{
+  dispatchBegin();
+  while (runThread().active())
+  {
+    if (dispatch() < 0) break;
+  }
+  dispatchEnd();
+}
+
 void SnoopCapture::load(VXml xml)
 {
   VObject::load(xml);
@@ -144,6 +302,8 @@ void SnoopCapture::load(VXml xml)
   enabled   = xml.getBool("enabled",   enabled);
   autoRead  = xml.getBool("autoRead",  autoRead);
   autoParse = xml.getBool("autoParse", autoParse);
+  burstSize = xml.getInt("burstSize", burstSize);
+  statsInterval = xml.getInt("statsInterval", statsInterval);
 }
 
 void SnoopCapture::save(VXml xml)
@@ -153,6 +313,8 @@ void SnoopCapture::save(VXml xml)
   xml.setBool("enabled",   enabled);
   xml.setBool("autoRead",  autoRead);
   xml.setBool("autoParse", autoParse);
+  xml.setInt("burstSize",  burstSize);
+  xml.setInt("statsInterval", statsInterval);
 }
 
 #ifdef QT_GUI_LIB
@@ -161,6 +323,8 @@ void SnoopCapture::optionAddWidget(QLayout* layout)
   VOptionable::addCheckBox(layout, "chkEnabled",   "Enabled",    enabled);
   VOptionable::addCheckBox(layout, "chkAutoRead",  "Auto Read",  autoRead);
   VOptionable::addCheckBox(layout, "chkAutoParse", "Auto Parse", autoParse);
+  VOptionable::addLineEdit(layout, "leBurstSize",  "Burst Size", QString::number(burstSize));
+  VOptionable::addLineEdit(layout, "leStatsInterval", "Stats Interval", QString::number(statsInterval));
 }
 
 void SnoopCapture::optionSaveDlg(QDialog* dialog)
@@ -168,5 +332,7 @@ void SnoopCapture::optionSaveDlg(QDialog* dialog)
   enabled   = dialog->findChild<QCheckBox*>("chkEnabled")->checkState() == Qt::Checked;
   autoRead  = dialog->findChild<QCheckBox*>("chkAutoRead")->checkState() == Qt::Checked;
   autoParse = dialog->findChild<QCheckBox*>("chkAutoParse")->checkState() == Qt::Checked;
+  burstSize = dialog->findChild<QLineEdit*>("leBurstSize")->text().toInt();
+  statsInterval = dialog->findChild<QLineEdit*>("leStatsInterval")->text().toInt();
 }
 #endif // QT_GUI_LIB
@@ -15,6 +15,82 @@
 #include <VThread>
 #include <VObjectWidget>
 #include <VGraph>
+#include <VTick>
+
+// ----------------------------------------------------------------------------
+// SnoopStatsCounter
+// ----------------------------------------------------------------------------
+/// 64 bit counter with one writer. Loads and stores are atomic(relaxed), so other threads
+/// never see a torn value, and the writer needs no read-modify-write instruction.
+class SnoopStatsCounter
+{
+public:
+  UINT64 load() const
+  {
+#ifdef _MSC_VER
+    return (UINT64)InterlockedCompareExchange64((volatile LONGLONG*)&m_value, 0, 0);
+#else
+    return __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+  }
+  void store(UINT64 value)
+  {
+#ifdef _MSC_VER
+    InterlockedExchange64((volatile LONGLONG*)&m_value, (LONGLONG)value);
+#else
+    __atomic_store_n(&m_value, value, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+  }
+
+public:
+  operator UINT64() const                         { return load();                     }
+  SnoopStatsCounter& operator =(UINT64 value)     { store(value);         return *this; }
+  SnoopStatsCounter& operator +=(UINT64 value)    { store(load() + value); return *this; }
+  SnoopStatsCounter& operator ++()                { store(load() + 1);    return *this; }
+  void               operator ++(int)             { store(load() + 1);                 }
+
+private:
+  UINT64 m_value;
+};
+
+// ----------------------------------------------------------------------------
+// SnoopCaptureStats
+// ----------------------------------------------------------------------------
+/// Capture counters. Written only by the capture thread, other threads may read them at any time.
+class SnoopCaptureStats
+{
+public:
+  SnoopStatsCounter packets;
+  SnoopStatsCounter bytes;
+  SnoopStatsCounter relayed;
+  SnoopStatsCounter dropped;     // dropped by graph(packet->drop)
+  SnoopStatsCounter kernelDrops; // ps_drop
+  SnoopStatsCounter ifDrops;     // ps_ifdrop
+  SnoopStatsCounter readErrors;  // read failures ending capture(end of file included)
+  SnoopStatsCounter txPackets;   // frames sent by batched write
+  SnoopStatsCounter txDrops;     // frames dropped by batched or queued write
+  SnoopStatsCounter txBlocked;   // queued writes that waited for room
+  SnoopStatsCounter selfFrames;  // own relayed frames not read back(in path capture)
+
+public:
+  void    clear();
+  QString str();
+};
+
+// ----------------------------------------------------------------------------
+// SnoopCaptureDriver
+// ----------------------------------------------------------------------------
+/// External dispatcher serving captures whose own thread does not run(SnoopReactor)
+class SnoopCapture;
+class SnoopCaptureDriver
+{
+public:
+  virtual ~SnoopCaptureDriver() {}
+
+public:
+  virtual void attach(SnoopCapture* capture) = 0; // capture is opened, start dispatching it
+  virtual void detach(SnoopCapture* capture) = 0; // capture is closing, stop dispatching only it
+};
 
 // ----------------------------------------------------------------------------
 // SnoopCapture
@@ -34,6 +110,7 @@ protected:
 
 public:
   virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
   virtual int write(SnoopPacket* packet);
   virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
 
@@ -44,6 +121,7 @@ public:
   virtual SnoopCaptureType captureType() { return SnoopCaptureType::None; }
   virtual int              dataLink()    { return DLT_NULL; }
   virtual bool             relay(SnoopPacket* packet);
+  virtual void             flushTx() {} // send frames queued by write(called after every dispatch)
 
   //
   // Properties
@@ -52,15 +130,48 @@ public:
   bool enabled;
   bool autoRead;
   bool autoParse;
+  int  burstSize;
+  int  statsInterval; // msec, kernel counters are sampled in capture thread(0 : only on close)
+
+public:
+  //
+  // Set by SnoopFanout, not saved.
+  //
+  int  workerIndex; // fanout worker(0 : primary)
+  bool replica;     // opened in a fanout replica graph, never starts its own fanout
+
+public:
+  SnoopCaptureStats stats;
+  virtual bool kernelStats(UINT64& drops, UINT64& ifDrops); // ps_drop and ps_ifdrop, false if not supported
+
+protected:
+  VTick m_statsTick;
+  void  sampleStats(bool force = false);
+  void  count(SnoopPacket* packet, bool relayed);
+
+public:
+  //
+  // Capture loop body. run() calls these when autoRead is true and driver is NULL,
+  // otherwise an external dispatcher(SnoopReactor) drives the capture with them.
+  //
+  void dispatchBegin();
+  int  dispatch(); // read once and deliver to graph, return read result
+  void dispatchEnd();
+  SnoopCaptureDriver* driver; // external dispatcher overriding autoRead(reference, not saved)
 
 protected:
+  SnoopCaptureType m_captureType;
+  int  dispatchOne();
+  int  dispatchBurst();
   virtual void run();
 
 signals:
   void captured(SnoopPacket* packet);
+  void capturedBurst(SnoopPacketBatch* batch);
 
 protected:
-  SnoopPacket packet;
+  SnoopPacket      packet;
+  SnoopPacketBatch batch;
 
 public:
   virtual void load(VXml xml);
@@ -3,11 +3,18 @@
 #include <VXmlDoc>
 #include <SnoopAdapter>
 #include <SnoopArpSpoof>
+#include <SnoopDpdk>
 #include <SnoopFile>
+#include <SnoopFileSet>
+#include <SnoopNfQueue>
+#include <SnoopPacketMmap>
+#include <SnoopShmPipe>
 #include <SnoopSourcePcap>
 #include <SnoopRemote>
+#include <SnoopTun>
 #include <SnoopVirtualNat>
 #include <SnoopWinDivert>
+#include <SnoopXdpCapture>
 #include <VDebugNew>
 
 // ----------------------------------------------------------------------------
@@ -17,13 +24,32 @@ void SnoopCaptureFactory::explicitLink()
 {
   SnoopAdapter     adapter;
   SnoopArpSpoof    arpSpoof;
+#if defined(linux) && defined(SNOOP_DPDK)
+  SnoopDpdk        dpdk;
+#endif // linux && SNOOP_DPDK
   SnoopFile        file;
+  SnoopFileSet     fileSet;
+#if defined(linux) && defined(SNOOP_NFQUEUE)
+  SnoopNfQueue     nfQueue;
+#endif // linux && SNOOP_NFQUEUE
+#ifdef linux
+  SnoopPacketMmap  packetMmap;
+#endif // linux
+#ifdef linux
+  SnoopShmPipe     shmPipe;
+#endif // linux
   SnoopSourcePcap  pcap;
-#ifdef WIN32
+#if defined(WIN32) || defined(linux)
   SnoopRemote      remote;
-#endif // WIN32
+#endif // WIN32 || linux
+#ifdef linux
+  SnoopTun         tun;
+#endif // linux
   SnoopVirtualNat  virtualNAT;
   SnoopWinDivert   winDivert;
+#if defined(linux) && defined(SNOOP_XDP)
+  SnoopXdpCapture  xdpCapture;
+#endif // linux && SNOOP_XDP
 }
 
 SnoopCapture* SnoopCaptureFactory::createDefaultCapture()
@@ -0,0 +1,588 @@
+#include <SnoopDpdk>
+#include <VDebugNew>
+
+#if defined(linux) && defined(SNOOP_DPDK)
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+
+REGISTER_METACLASS(SnoopDpdk, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopDpdkPort
+// ----------------------------------------------------------------------------
+//
+// EAL and ports live as long as the process(a stopped port is started again on next open).
+// TX queues of a port opened with inPath : [0, queueCount) relay of its own readers, [queueCount, queueCount * 2) relay
+// of readers of the other port, queueCount * 2 write() from any thread.
+// Otherwise, or when driver has fewer TX queues(net_af_packet has qpairs), there is only queue 0 shared by every sender under lock.
+//
+class SnoopDpdkPort
+{
+public:
+  int          refs;
+  int          queueCount;
+  int          txQueues;   // queueCount * 2 + 1, or 1(shared)
+  rte_mempool* pool;
+  bool         started;
+};
+
+static VLockable                g_dpdkLock; // for port map and write queue
+static QMap<int, SnoopDpdkPort> g_dpdkPorts;
+static bool                     g_ealInited = false;
+static QList<QByteArray>        g_ealArgv;  // kept for EAL
+
+// ----------------------------------------------------------------------------
+// SnoopDpdk
+// ----------------------------------------------------------------------------
+SnoopDpdk::SnoopDpdk(void* owner) : SnoopCapture(owner)
+{
+  ealArgs     = "-l 0 --no-huge --no-pci --vdev=net_af_packet0,iface=eth0";
+  portId      = 0;
+  txPortId    = -1;
+  inPath      = false;
+  queueCount  = 1;
+  lcores      = "";
+  rxDesc      = 1024;
+  txDesc      = 1024;
+  mbufCount   = 8191;
+  idleSleep   = 0;
+
+  fanout      = NULL;
+
+  m_pool      = NULL;
+  m_txPortId  = 0;
+  m_txShared  = false;
+  m_rxCount   = 0;
+  m_relayHint = 0;
+  m_txCount   = 0;
+}
+
+SnoopDpdk::~SnoopDpdk()
+{
+  close();
+}
+
+bool SnoopDpdk::initEal()
+{
+  VLock lock(g_dpdkLock);
+  if (g_ealInited) return true;
+
+  g_ealArgv.clear();
+  g_ealArgv.push_back("snoop");
+  foreach (const QString& arg, ealArgs.split(' ', QString::SkipEmptyParts))
+    g_ealArgv.push_back(arg.toLocal8Bit());
+  QVector<char*> argv;
+  for (int i = 0; i < g_ealArgv.count(); i++)
+    argv.push_back(g_ealArgv[i].data());
+
+  if (rte_eal_init(argv.count(), argv.data()) < 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in rte_eal_init(%s)(%s)", qPrintable(ealArgs), rte_strerror(rte_errno)), VERR_FAIL);
+    return false;
+  }
+  g_ealInited = true;
+  LOG_DEBUG("eal initialized(%s) ports=%u", qPrintable(ealArgs), rte_eth_dev_count_avail());
+  return true;
+}
+
+bool SnoopDpdk::openPort(int port)
+{
+  VLock lock(g_dpdkLock);
+
+  if (port < 0 || !rte_eth_dev_is_valid_port((uint16_t)port))
+  {
+    SET_ERROR(SnoopError, qformat("invalid port(%d)", port), VERR_INVALID_INDEX);
+    return false;
+  }
+
+  QMap<int, SnoopDpdkPort>::iterator it = g_dpdkPorts.find(port);
+  if (it != g_dpdkPorts.end())
+  {
+    SnoopDpdkPort& p = it.value();
+    if (p.queueCount != queueCount)
+    {
+      SET_ERROR(SnoopError, qformat("port %d is configured with %d queues(not %d)", port, p.queueCount, queueCount), VERR_FAIL);
+      return false;
+    }
+    if (!p.started)
+    {
+      int res = rte_eth_dev_start((uint16_t)port);
+      if (res < 0)
+      {
+        SET_ERROR(SnoopError, qformat("error in rte_eth_dev_start(%d)(%s)", port, rte_strerror(-res)), VERR_FAIL);
+        return false;
+      }
+      p.started = true;
+    }
+    p.refs++;
+    return true;
+  }
+
+  rte_eth_dev_info info;
+  int res = rte_eth_dev_info_get((uint16_t)port, &info);
+  if (res != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in rte_eth_dev_info_get(%d)(%s)", port, rte_strerror(-res)), VERR_FAIL);
+    return false;
+  }
+  int rxQueues = queueCount;
+  int txQueues = inPath ? queueCount * 2 + 1 : 1;
+  if (rxQueues > info.max_rx_queues)
+  {
+    SET_ERROR(SnoopError, qformat("port %d supports %u rx queues(%d needed)", port, info.max_rx_queues, rxQueues), VERR_FAIL);
+    return false;
+  }
+  if (txQueues > info.max_tx_queues)
+  {
+    LOG_WARN("port %d supports %u tx queues(%d needed), relay shares one tx queue under lock", port, info.max_tx_queues, txQueues);
+    txQueues = 1;
+  }
+
+  int socketId = rte_eth_dev_socket_id((uint16_t)port);
+  if (socketId < 0) socketId = (int)rte_socket_id();
+  rte_mempool* pool = rte_pktmbuf_pool_create(qPrintable(qformat("snoop_pool_%d", port)), (unsigned)mbufCount, 256, 0, RTE_MBUF_DEFAULT_BUF_SIZE, socketId);
+  if (pool == NULL)
+  {
+    SET_ERROR(SnoopError, qformat("error in rte_pktmbuf_pool_create(%d)(%s)", mbufCount, rte_strerror(rte_errno)), VERR_FAIL);
+    return false;
+  }
+
+  rte_eth_conf conf;
+  memset(&conf, 0, sizeof(conf));
+  uint16_t nbRx = (uint16_t)rxDesc;
+  uint16_t nbTx = (uint16_t)txDesc;
+  bool ok = (res = rte_eth_dev_configure((uint16_t)port, (uint16_t)rxQueues, (uint16_t)txQueues, &conf)) == 0 &&
+            (res = rte_eth_dev_adjust_nb_rx_tx_desc((uint16_t)port, &nbRx, &nbTx)) == 0;
+  for (int q = 0; ok && q < rxQueues; q++)
+    ok = (res = rte_eth_rx_queue_setup((uint16_t)port, (uint16_t)q, nbRx, (unsigned)socketId, NULL, pool)) == 0;
+  for (int q = 0; ok && q < txQueues; q++)
+    ok = (res = rte_eth_tx_queue_setup((uint16_t)port, (uint16_t)q, nbTx, (unsigned)socketId, NULL)) == 0;
+  if (ok) ok = (res = rte_eth_dev_start((uint16_t)port)) == 0;
+  if (!ok)
+  {
+    SET_ERROR(SnoopError, qformat("can not set up port %d(%s)", port, rte_strerror(-res)), VERR_FAIL);
+    rte_mempool_free(pool);
+    return false;
+  }
+  rte_eth_promiscuous_enable((uint16_t)port);
+
+  SnoopDpdkPort p;
+  p.refs       = 1;
+  p.queueCount = queueCount;
+  p.txQueues   = txQueues;
+  p.pool       = pool;
+  p.started    = true;
+  g_dpdkPorts[port] = p;
+  LOG_DEBUG("port %d started(%s) rxq=%d txq=%d rxDesc=%u txDesc=%u", port, info.driver_name, rxQueues, txQueues, nbRx, nbTx);
+  return true;
+}
+
+void SnoopDpdk::closePort(int port)
+{
+  VLock lock(g_dpdkLock);
+  QMap<int, SnoopDpdkPort>::iterator it = g_dpdkPorts.find(port);
+  if (it == g_dpdkPorts.end()) return;
+  SnoopDpdkPort& p = it.value();
+  if (--p.refs > 0) return;
+  rte_eth_dev_stop((uint16_t)port);
+  p.started = false;
+}
+
+bool SnoopDpdk::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (queueCount <= 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid queueCount(%d)", queueCount), VERR_FAIL);
+    return false;
+  }
+  if (!initEal()) return false;
+
+  //
+  // Primary sets up ports, replicas only take their queue.
+  //
+  m_txPortId = txPortId == -1 ? portId : txPortId;
+  if (!openPort(portId)) return false;
+  if (m_txPortId != portId && !openPort(m_txPortId))
+  {
+    closePort(portId);
+    return false;
+  }
+  {
+    VLock lock(g_dpdkLock);
+    m_pool     = g_dpdkPorts[portId].pool;
+    m_txShared = g_dpdkPorts[m_txPortId].txQueues == 1;
+  }
+  m_rxCount   = 0;
+  m_relayHint = 0;
+  m_txCount   = 0;
+
+  if (!SnoopCapture::doOpen()) return false;
+
+  if (!replica && queueCount > 1)
+  {
+    fanout = new SnoopFanout(this);
+    if (!fanout->open(queueCount, prepareWorker))
+    {
+      error = fanout->error;
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnoopDpdk::prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex)
+{
+  Q_UNUSED(capture)
+  Q_UNUSED(worker)
+  Q_UNUSED(workerIndex) // set by SnoopFanout, RX queue of worker
+}
+
+bool SnoopDpdk::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  SAFE_DELETE(fanout);
+
+  //
+  // mbufs are referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+  if (m_pool != NULL)
+  {
+    release();
+    closePort(portId);
+    if (m_txPortId != portId) closePort(m_txPortId);
+    m_pool = NULL;
+  }
+
+  return SnoopCapture::doClose();
+}
+
+void SnoopDpdk::bindThread()
+{
+  QStringList cpus = lcores.split(';', QString::SkipEmptyParts);
+  if (workerIndex >= cpus.count()) return;
+  int cpu = cpus.at(workerIndex).toInt();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (res != 0) LOG_WARN("pthread_setaffinity_np(%d) return %d", cpu, res);
+}
+
+void SnoopDpdk::run()
+{
+  //
+  // Registered thread gets an lcore id, so that mempool per-lcore cache is used.
+  //
+  bindThread();
+  bool registered = rte_thread_register() == 0;
+  if (!registered) LOG_WARN("rte_thread_register return -1(%s)", rte_strerror(rte_errno));
+  LOG_DEBUG("port=%d queue=%d lcore=%u", portId, workerIndex, rte_lcore_id());
+
+  SnoopCapture::run();
+
+  if (registered) rte_thread_unregister();
+}
+
+void SnoopDpdk::fill(SnoopPacket* packet, PKT_HDR* pktHdr, rte_mbuf* mbuf, struct timespec& ts)
+{
+  pktHdr->ts.tv_sec  = ts.tv_sec;
+  pktHdr->ts.tv_usec = ts.tv_nsec / 1000;
+  pktHdr->caplen     = rte_pktmbuf_data_len(mbuf); // first segment
+  pktHdr->len        = rte_pktmbuf_pkt_len(mbuf);
+  packet->pktHdr     = pktHdr;
+  packet->pktData    = rte_pktmbuf_mtod(mbuf, BYTE*);
+  packet->linkType   = DLT_EN10MB;
+  packet->tsNsec     = (UINT32)ts.tv_nsec;
+}
+
+void SnoopDpdk::sendTx()
+{
+  if (m_txCount == 0) return;
+  uint16_t sent;
+  if (m_txShared)
+  {
+    VLock lock(g_dpdkLock);
+    sent = rte_eth_tx_burst((uint16_t)m_txPortId, 0, m_tx, (uint16_t)m_txCount);
+  } else
+    sent = rte_eth_tx_burst((uint16_t)m_txPortId, (uint16_t)relayQueue(), m_tx, (uint16_t)m_txCount);
+  for (int i = sent; i < m_txCount; i++)
+    rte_pktmbuf_free(m_tx[i]);
+  stats.txPackets += sent;
+  stats.txDrops   += (UINT64)(m_txCount - sent);
+  m_txCount = 0;
+}
+
+void SnoopDpdk::release()
+{
+  //
+  // Relayed mbufs now belong to driver, the others go back to pool.
+  //
+  sendTx();
+  for (int i = 0; i < m_rxCount; i++)
+    if (!m_relayed[i]) rte_pktmbuf_free(m_rx[i]);
+  m_rxCount   = 0;
+  m_relayHint = 0;
+}
+
+void SnoopDpdk::flushTx()
+{
+  release();
+}
+
+int SnoopDpdk::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  release();
+
+  uint16_t n = rte_eth_rx_burst((uint16_t)portId, (uint16_t)workerIndex, m_rx, 1);
+  if (n == 0)
+  {
+    if (idleSleep > 0) usleep(idleSleep);
+    return 0;
+  }
+  m_rxCount    = 1;
+  m_relayed[0] = false;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  packet->clear();
+  fill(packet, &m_pktHdr, m_rx[0], ts);
+  if (autoParse) parse(packet);
+  return (int)m_pktHdr.caplen;
+}
+
+int SnoopDpdk::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  release();
+
+  if (max > MAX_BURST) max = MAX_BURST;
+  batch.reserve(max, 0);
+  batch.clear();
+  uint16_t n = rte_eth_rx_burst((uint16_t)portId, (uint16_t)workerIndex, m_rx, (uint16_t)max);
+  if (n == 0)
+  {
+    if (idleSleep > 0) usleep(idleSleep);
+    return 0;
+  }
+  m_rxCount = n;
+
+  //
+  // One clock read per burst.
+  //
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  for (int i = 0; i < n; i++)
+  {
+    m_relayed[i] = false;
+    rte_prefetch0(rte_pktmbuf_mtod(m_rx[i], void*));
+    SnoopPacket* packet = batch.next();
+    fill(packet, packet->pktHdr, m_rx[i], ts);
+  }
+
+  if (autoParse)
+  {
+    for (int i = 0; i < batch.count; i++)
+      parse(batch.at(i));
+  }
+  return batch.count;
+}
+
+int SnoopDpdk::write(SnoopPacket* packet)
+{
+  return write(packet->pktData, packet->pktHdr->caplen);
+}
+
+int SnoopDpdk::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  Q_UNUSED(divertAddr)
+  return writeTo(portId, buf, size);
+}
+
+int SnoopDpdk::writeTo(int port, u_char* buf, int size)
+{
+  if (m_pool == NULL) return VERR_FAIL;
+
+  rte_mbuf* mbuf = rte_pktmbuf_alloc(m_pool);
+  if (mbuf == NULL)
+  {
+    LOG_ERROR("rte_pktmbuf_alloc return null");
+    return VERR_FAIL;
+  }
+  char* p = rte_pktmbuf_append(mbuf, (uint16_t)size);
+  if (p == NULL)
+  {
+    LOG_ERROR("too big packet(%d)", size);
+    rte_pktmbuf_free(mbuf);
+    return VERR_FAIL;
+  }
+  memcpy(p, buf, (size_t)size);
+
+  //
+  // write() may be called from any thread, so it has its own queue(last one) under lock.
+  //
+  uint16_t sent;
+  {
+    VLock lock(g_dpdkLock);
+    int writeQueue = g_dpdkPorts[port].txQueues - 1;
+    sent = rte_eth_tx_burst((uint16_t)port, (uint16_t)writeQueue, &mbuf, 1);
+  }
+  if (sent == 0)
+  {
+    rte_pktmbuf_free(mbuf);
+    return VERR_FAIL;
+  }
+  return size;
+}
+
+bool SnoopDpdk::relay(SnoopPacket* packet)
+{
+  //
+  // Find mbuf of packet in last burst(relay usually comes in read order, so search starts at hint).
+  //
+  int found = -1;
+  for (int k = 0; k < m_rxCount; k++)
+  {
+    int i = (m_relayHint + k) % m_rxCount;
+    if (!m_relayed[i] && rte_pktmbuf_mtod(m_rx[i], BYTE*) == packet->pktData)
+    {
+      found = i;
+      break;
+    }
+  }
+  if (found == -1) return writeTo(m_txPortId, packet->pktData, packet->pktHdr->caplen) != VERR_FAIL;
+
+  rte_mbuf* mbuf = m_rx[found];
+  UINT32 caplen = packet->pktHdr->caplen;
+  if (caplen != rte_pktmbuf_data_len(mbuf))
+  {
+    //
+    // Graph changed packet length, only single segment mbuf with enough room is sent as is.
+    //
+    if (mbuf->nb_segs != 1 || caplen > (UINT32)(mbuf->buf_len - mbuf->data_off))
+      return writeTo(m_txPortId, packet->pktData, caplen) != VERR_FAIL;
+    mbuf->data_len = (uint16_t)caplen;
+    mbuf->pkt_len  = caplen;
+  }
+
+  if (m_txCount == MAX_BURST) sendTx();
+  m_relayed[found] = true;
+  m_tx[m_txCount++] = mbuf;
+  m_relayHint = found + 1;
+  return true;
+}
+
+bool SnoopDpdk::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  //
+  // Counters are per port, so only primary reports them.
+  //
+  if (replica || m_pool == NULL) return false;
+  rte_eth_stats ethStats;
+  if (rte_eth_stats_get((uint16_t)portId, &ethStats) != 0) return false;
+  drops   = ethStats.imissed + ethStats.rx_nombuf;
+  ifDrops = ethStats.ierrors;
+  return true;
+}
+
+void SnoopDpdk::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  ealArgs    = xml.getStr("ealArgs", ealArgs);
+  portId     = xml.getInt("portId", portId);
+  txPortId   = xml.getInt("txPortId", txPortId);
+  inPath     = xml.getBool("inPath", inPath);
+  queueCount = xml.getInt("queueCount", queueCount);
+  lcores     = xml.getStr("lcores", lcores);
+  rxDesc     = xml.getInt("rxDesc", rxDesc);
+  txDesc     = xml.getInt("txDesc", txDesc);
+  mbufCount  = xml.getInt("mbufCount", mbufCount);
+  idleSleep  = xml.getInt("idleSleep", idleSleep);
+}
+
+void SnoopDpdk::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setStr("ealArgs", ealArgs);
+  xml.setInt("portId", portId);
+  xml.setInt("txPortId", txPortId);
+  xml.setBool("inPath", inPath);
+  xml.setInt("queueCount", queueCount);
+  xml.setStr("lcores", lcores);
+  xml.setInt("rxDesc", rxDesc);
+  xml.setInt("txDesc", txDesc);
+  xml.setInt("mbufCount", mbufCount);
+  xml.setInt("idleSleep", idleSleep);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopDpdk::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leEalArgs",    "EAL Args",    ealArgs);
+  VOptionable::addLineEdit(layout, "lePortId",     "Port Id",     QString::number(portId));
+  VOptionable::addLineEdit(layout, "leTxPortId",   "Tx Port Id",  QString::number(txPortId));
+  VOptionable::addCheckBox(layout, "chkInPath",    "In Path",     inPath);
+  VOptionable::addLineEdit(layout, "leQueueCount", "Queue Count", QString::number(queueCount));
+  VOptionable::addLineEdit(layout, "leLcores",     "Lcores",      lcores);
+  VOptionable::addLineEdit(layout, "leRxDesc",     "Rx Desc",     QString::number(rxDesc));
+  VOptionable::addLineEdit(layout, "leTxDesc",     "Tx Desc",     QString::number(txDesc));
+  VOptionable::addLineEdit(layout, "leMbufCount",  "Mbuf Count",  QString::number(mbufCount));
+  VOptionable::addLineEdit(layout, "leIdleSleep",  "Idle Sleep",  QString::number(idleSleep));
+}
+
+void SnoopDpdk::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  ealArgs    = dialog->findChild<QLineEdit*>("leEalArgs")->text();
+  portId     = dialog->findChild<QLineEdit*>("lePortId")->text().toInt();
+  txPortId   = dialog->findChild<QLineEdit*>("leTxPortId")->text().toInt();
+  inPath     = dialog->findChild<QCheckBox*>("chkInPath")->checkState() == Qt::Checked;
+  queueCount = dialog->findChild<QLineEdit*>("leQueueCount")->text().toInt();
+  lcores     = dialog->findChild<QLineEdit*>("leLcores")->text();
+  rxDesc     = dialog->findChild<QLineEdit*>("leRxDesc")->text().toInt();
+  txDesc     = dialog->findChild<QLineEdit*>("leTxDesc")->text().toInt();
+  mbufCount  = dialog->findChild<QLineEdit*>("leMbufCount")->text().toInt();
+  idleSleep  = dialog->findChild<QLineEdit*>("leIdleSleep")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux && SNOOP_DPDK
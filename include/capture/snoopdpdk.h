@@ -0,0 +1,109 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_DPDK_H__
+#define __SNOOP_DPDK_H__
+
+#include <SnoopCapture>
+#include <SnoopFanout>
+
+#if defined(linux) && defined(SNOOP_DPDK)
+
+#include <rte_mbuf.h>
+
+// ----------------------------------------------------------------------------
+// SnoopDpdk
+// ----------------------------------------------------------------------------
+/// DPDK poll mode capture. Each RX queue is read by its own graph replica(thread) pinned to an lcore.
+/// Without a DPDK NIC, ealArgs can create a software port(--vdev=net_af_packet0,iface=eth0 or net_pcap0,...).
+/// With inPath, relay() sends the received mbuf out of txPortId without copy.
+class SnoopDpdk : public SnoopCapture
+{
+public:
+  SnoopDpdk(void* owner = NULL);
+  virtual ~SnoopDpdk();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+  virtual int write(SnoopPacket* packet);
+  virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
+
+public:
+  virtual SnoopCaptureType captureType() { return inPath ? SnoopCaptureType::InPath : SnoopCaptureType::OutOfPath; }
+  virtual int              dataLink()    { return DLT_EN10MB; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual void             flushTx();
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  QString ealArgs;    // rte_eal_init arguments(first object opened in process wins)
+  int     portId;
+  int     txPortId;   // relay destination(-1 : portId)
+  bool    inPath;
+  int     queueCount; // RX queues, one graph replica per extra queue
+  QString lcores;     // ';' separated cpu per queue(empty : not pinned)
+  int     rxDesc;
+  int     txDesc;
+  int     mbufCount;  // mbuf pool size per port
+  int     idleSleep;  // usec to sleep on empty poll(0 : busy poll)
+
+protected:
+  SnoopFanout*     fanout; // workerIndex is RX queue id
+  static void      prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex);
+
+protected:
+  static const int MAX_BURST = 256;
+  rte_mempool*     m_pool;
+  int              m_txPortId;     // txPortId resolved
+  bool             m_txShared;     // m_txPortId has only one tx queue, taken under lock
+  rte_mbuf*        m_rx[MAX_BURST]; // handed to graph in last read
+  bool             m_relayed[MAX_BURST];
+  int              m_rxCount;
+  int              m_relayHint;
+  rte_mbuf*        m_tx[MAX_BURST];
+  int              m_txCount;
+  PKT_HDR          m_pktHdr;       // for read()
+
+protected:
+  bool initEal();
+  bool openPort(int port);
+  void closePort(int port);
+  int  relayQueue() { return (m_txPortId == portId ? 0 : queueCount) + workerIndex; }
+  int  writeTo(int port, u_char* buf, int size); // copy into new mbuf and send on write queue of port
+  void fill(SnoopPacket* packet, PKT_HDR* pktHdr, rte_mbuf* mbuf, struct timespec& ts);
+  void sendTx();
+  void release();
+  void bindThread();
+
+protected:
+  virtual void run();
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux && SNOOP_DPDK
+
+#endif // __SNOOP_DPDK_H__
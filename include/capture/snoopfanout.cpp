@@ -0,0 +1,170 @@
+#include <SnoopFanout>
+#include <VXmlDoc>
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// SnoopFanout
+// ----------------------------------------------------------------------------
+SnoopFanout::SnoopFanout(SnoopCapture* capture)
+{
+  this->capture = capture;
+}
+
+SnoopFanout::~SnoopFanout()
+{
+  close();
+}
+
+bool SnoopFanout::isShared(VObject* object)
+{
+  int index = object->metaObject()->indexOfClassInfo("fanout");
+  if (index == -1) return false;
+  return QString(object->metaObject()->classInfo(index).value()) == "shared";
+}
+
+void SnoopFanout::collect(VGraph* graph, QStringList& cloned, QStringList& shared)
+{
+  //
+  // Objects reachable by signal from the capture. Shared objects end the path.
+  //
+  cloned.clear();
+  shared.clear();
+  cloned.push_back(capture->name);
+  int _count = graph->connectList.count();
+  for (int i = 0; i < cloned.count(); i++)
+  {
+    for (int j = 0; j < _count; j++)
+    {
+      VGraphConnect connect = (VGraphConnect&)graph->connectList.at(j);
+      if (connect.sender != cloned.at(i)) continue;
+      if (cloned.contains(connect.receiver) || shared.contains(connect.receiver)) continue;
+      VObject* receiver = graph->objectList.findByName(connect.receiver);
+      if (receiver == NULL) continue;
+      if (isShared(receiver))
+        shared.push_back(connect.receiver);
+      else
+        cloned.push_back(connect.receiver);
+    }
+  }
+}
+
+bool SnoopFanout::open(int workerCount, PrepareFunc prepare)
+{
+  VGraph* graph = (VGraph*)capture->owner;
+  if (graph == NULL)
+  {
+    SET_ERROR(SnoopError, "fanout capture is not owned by graph", VERR_OBJECT_IS_NULL);
+    return false;
+  }
+
+  QStringList cloned, shared;
+  collect(graph, cloned, shared);
+  int reachableCount = cloned.count();
+
+  //
+  // Replica graph holds the reachable objects and the ones they refer to by name(writer, flow manager).
+  //
+  static const char* REF_KEYS[] = { "writerName", "flowMgrName", "fromFlowMgrName", "toFlowMgrName", "captureName", "filterName" };
+  VXmlDoc doc;
+  VXml xml = doc.root().gotoChild("graph");
+  VXml objectListXml = xml.gotoChild("objectList");
+  for (int i = 0; i < cloned.count(); i++)
+  {
+    VObject* object = graph->objectList.findByName(cloned.at(i));
+    VXml childXml = objectListXml.addChild("object");
+    object->save(childXml);
+    childXml.setStr("_class", object->className());
+    childXml.setStr("name", object->name);
+
+    for (int k = 0; k < (int)(sizeof(REF_KEYS) / sizeof(REF_KEYS[0])); k++)
+    {
+      QString refName = childXml.getStr(REF_KEYS[k], "");
+      if (refName == "" || cloned.contains(refName)) continue;
+      VObject* ref = graph->objectList.findByName(refName);
+      if (ref == NULL || isShared(ref)) continue;
+      cloned.push_back(refName);
+    }
+  }
+  VXml connectListXml = xml.gotoChild("connectList");
+  int _count = graph->connectList.count();
+  for (int j = 0; j < _count; j++)
+  {
+    VGraphConnect connect = (VGraphConnect&)graph->connectList.at(j);
+    int senderIndex = cloned.indexOf(connect.sender);
+    if (senderIndex == -1 || senderIndex >= reachableCount) continue; // referred objects do not deliver
+    if (!cloned.contains(connect.receiver)) continue;
+    VXml childXml = connectListXml.addChild("connect");
+    childXml.setStr("sender",   connect.sender);
+    childXml.setStr("signal",   connect.signal);
+    childXml.setStr("receiver", connect.receiver);
+    childXml.setStr("slot",     connect.slot);
+  }
+
+  for (int i = 1; i < workerCount; i++)
+  {
+    VGraph* replica = new VGraph;
+    replicas.push_back(replica);
+    replica->load(xml);
+
+    //
+    // Every object downstream of the capture gets its own instance(SnoopFlowMgr shard included).
+    // Other captures only keep their write handle, so that packets are read once,
+    // and none of them starts its own fanout.
+    //
+    SnoopCapture* worker = NULL;
+    int objectCount = replica->objectList.count();
+    for (int j = 0; j < objectCount; j++)
+    {
+      SnoopCapture* other = dynamic_cast<SnoopCapture*>(replica->objectList.at(j));
+      if (other == NULL) continue;
+      other->replica = true;
+      if (other->name == capture->name)
+        worker = other;
+      else
+        other->autoRead = false;
+    }
+    if (worker == NULL)
+    {
+      SET_ERROR(SnoopError, qformat("can not find object(%s) in replica", qPrintable(capture->name)), VERR_CAN_NOT_FIND_OBJECT);
+      return false;
+    }
+    worker->workerIndex = i;
+    prepare(capture, worker, i);
+
+    //
+    // Shared objects keep one instance, fed by every worker thread.
+    //
+    for (int j = 0; j < _count; j++)
+    {
+      VGraphConnect connect = (VGraphConnect&)graph->connectList.at(j);
+      int senderIndex = cloned.indexOf(connect.sender);
+      if (senderIndex == -1 || senderIndex >= reachableCount || !shared.contains(connect.receiver)) continue;
+      VObject* sender   = replica->objectList.findByName(connect.sender);
+      VObject* receiver = graph->objectList.findByName(connect.receiver);
+      if (sender == NULL || receiver == NULL) continue;
+      if (!QObject::connect(sender, qPrintable("2" + connect.signal), receiver, qPrintable("1" + connect.slot), Qt::DirectConnection))
+      {
+        SET_ERROR(SnoopError, qformat("can not connect %s to shared %s", qPrintable(connect.sender), qPrintable(connect.receiver)), VERR_CAN_NOT_FIND_OBJECT);
+        return false;
+      }
+    }
+
+    if (!replica->open())
+    {
+      error = replica->error;
+      return false;
+    }
+    LOG_DEBUG("fanout worker %d of %d opened(%s) cloned=%d shared=%d", i, workerCount, qPrintable(capture->name), cloned.count(), shared.count());
+  }
+  return true;
+}
+
+void SnoopFanout::close()
+{
+  foreach (VGraph* replica, replicas)
+  {
+    replica->close();
+    delete replica;
+  }
+  replicas.clear();
+}
@@ -0,0 +1,48 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FANOUT_H__
+#define __SNOOP_FANOUT_H__
+
+#include <SnoopCapture>
+
+// ----------------------------------------------------------------------------
+// SnoopFanout
+// ----------------------------------------------------------------------------
+/// Replicas of the objects downstream of a capture, one per extra fanout worker.
+/// A class declaring Q_CLASSINFO("fanout", "shared") is not cloned : every worker feeds
+/// the one instance of the original graph, so its slots must be thread safe.
+class SnoopFanout
+{
+public:
+  SnoopFanout(SnoopCapture* capture);
+  virtual ~SnoopFanout();
+
+public:
+  VError         error;
+  QList<VGraph*> replicas;
+
+public:
+  //
+  // prepare is called for the capture object of each replica(workerIndex 1 .. workerCount - 1).
+  //
+  typedef void (*PrepareFunc)(SnoopCapture* capture, SnoopCapture* worker, int workerIndex);
+  bool open(int workerCount, PrepareFunc prepare);
+  void close();
+
+protected:
+  SnoopCapture* capture; // reference
+
+protected:
+  static bool isShared(VObject* object);
+  void        collect(VGraph* graph, QStringList& cloned, QStringList& shared);
+};
+
+#endif // __SNOOP_FANOUT_H__
@@ -1,6 +1,9 @@
 #include <SnoopFile>
 
 #include <VFile> // for VERR_FILENAME_NOT_SPECIFIED
+#include <SnoopIp>
+#include <VTick>
+#include <QDateTime>
 #include <VDebugNew>
 
 REGISTER_METACLASS(SnoopFile, SnoopCapture)
@@ -12,8 +15,23 @@ SnoopFile::SnoopFile(void* owner) : SnoopPcap(owner)
 {
   fileName  = "";
   speed     = 0;
-  startTS   = 0;
-  startTick = 0;
+  memoryMap = false;
+  m_mapMode = false;
+  burstGap  = (int)(pacer.burstNsec / 1000);
+  spinTime  = (int)(pacer.spinNsec / 1000);
+  startTime = "";
+  endTime   = "";
+  indexInterval = 1000;
+  loopCount   = 1;
+  loopRewrite = true;
+  m_loaded    = false;
+  m_loopIdx   = 0;
+  m_loopIter  = 0;
+  m_loopSpan  = 0;
+  m_loopSnapLen = 0;
+  m_codeValid = false;
+  m_startTs = 0;
+  m_endTs   = 0;
 }
 
 SnoopFile::~SnoopFile()
@@ -39,16 +57,47 @@ bool SnoopFile::doOpen()
     SET_ERROR(VFileError, qformat("file(%s) not exist", qPrintable(fileName)), VERR_FILE_NOT_EXIST);
     return false;
   }
-  QString source = "file://" + fileName;
-  if (!pcapOpen((char*)(qPrintable(source)), NULL, NULL))
+  if (!parseTime(startTime, m_startTs)) return false;
+  if (!parseTime(endTime, m_endTs)) return false;
+  //
+  // Compressed capture can not be read by libpcap, so it always goes through SnoopFileMap.
+  //
+  m_mapMode = memoryMap || SnoopFileStream::detect(fileName) != SnoopFileStream::None;
+  //
+  // libpcap pcapng reader loses interfaces defined between its start and the seek offset.
+  //
+  if (!m_mapMode && m_startTs != 0 && isPcapng(fileName))
   {
-    return false;
+    LOG_DEBUG("pcapng with startTime is read through memory map(%s)", qPrintable(fileName));
+    m_mapMode = true;
+  }
+  if (m_mapMode)
+  {
+    if (!mapOpen()) return false;
+  } else
+  {
+    QString source = "file://" + fileName;
+    if (!pcapOpen((char*)(qPrintable(source)), NULL, NULL))
+    {
+      return false;
+    }
   }
+  if (m_startTs != 0 && !seekStart()) return false;
+
+  loopData.clear();
+  loopItems.clear();
+  m_loaded   = false;
+  m_loopIdx  = 0;
+  m_loopIter = 0;
+  m_loopSpan = 0;
+  m_loopSnapLen = 0;
 
   if (speed != 0)
   {
-    startTS = 0;
-    startTick = tick();
+    pacer.speed     = speed;
+    pacer.burstNsec = (INT64)burstGap * 1000;
+    pacer.spinNsec  = (INT64)spinTime * 1000;
+    pacer.start();
   }
 
   return SnoopPcap::doOpen();
@@ -62,36 +111,490 @@ bool SnoopFile::doClose()
     return true;
   }
   
-  return SnoopPcap::doClose();
+  bool res = SnoopPcap::doClose();
+  if (speed != 0) pacer.report(name);
+  fileMap.close();
+  loopData.clear();
+  loopItems.clear();
+  if (m_codeValid)
+  {
+    pcap_freecode(&m_code);
+    m_codeValid = false;
+  }
+  return res;
 }
 
 int SnoopFile::read(SnoopPacket* packet)
 {
-  int res = SnoopPcap::read(packet);
+  int res = loopCount != 1 ? loopRead(packet) : readRange(packet);
   if (res < 0) return res;
 
-  if (speed != 0)
+  if (speed != 0) pacer.wait(packet);
+  return res;
+}
+
+int SnoopFile::readRange(SnoopPacket* packet)
+{
+  int res;
+  while (true)
   {
-    long nowTS = packet->pktHdr->ts.tv_sec * 1000 + packet->pktHdr->ts.tv_usec / 1000;
-    if (startTS == 0) startTS = nowTS;
-    long elapsedTS = nowTS - startTS;
-    while (true)
+    res = m_mapMode ? mapRead(packet) : SnoopPcap::read(packet);
+    if (res < 0) return res;
+    int check = timeCheck(packet);
+    if (check < 0) continue;
+    if (check > 0)
     {
-      VTick nowTick     = tick();
-      VTick elapsedTick = nowTick - startTick;
-      if (elapsedTick * speed >= elapsedTS) break;
-      msleep(1);
+      SET_DEBUG_ERROR(SnoopError, "end time reached", VERR_IN_PCAP_NEXT_EX);
+      return VERR_FAIL;
     }
+    break;
   }
   return res;
 }
 
+int SnoopFile::readBurst(SnoopPacketBatch& batch, int max)
+{
+  //
+  // Paced or time ranged libpcap reading works on each packet, as a packet read ahead can not be put back.
+  //
+  if (loopCount != 1)
+  {
+    if (speed != 0) return SnoopCapture::readBurst(batch, max);
+    return loopReadBurst(batch, max);
+  }
+  if (m_mapMode) return mapReadBurst(batch, max);
+  if (speed != 0 || m_startTs != 0 || m_endTs != 0) return SnoopCapture::readBurst(batch, max);
+  return SnoopPcap::readBurst(batch, max);
+}
+
+bool SnoopFile::mapOpen()
+{
+  if (!fileMap.open(fileName))
+  {
+    error = fileMap.error;
+    return false;
+  }
+  m_dataLink = fileMap.dataLink();
+
+  //
+  // Dead handle is used only to compile filter and lets write() fail as it does on offline capture.
+  //
+  int _snapLen = qMax(snapLen, fileMap.snapLen());
+  m_pcap = pcap_open_dead(m_dataLink, _snapLen);
+  if (m_pcap == NULL)
+  {
+    SET_ERROR(SnoopError, "error in pcap_open_dead return NULL", VERR_IN_PCAP_OPEN_DEAD);
+    return false;
+  }
+  if (filter != "")
+  {
+    if (pcap_compile(m_pcap, &m_code, qPrintable(filter), 1, 0xFFFFFFFF) < 0)
+    {
+      SET_ERROR(SnoopError, qformat("error in pcap_compile(%s)", pcap_geterr(m_pcap)), VERR_IN_PCAP_COMPILE);
+      return false;
+    }
+    m_codeValid = true;
+  }
+  return true;
+}
+
+int SnoopFile::mapRead(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  fileMap.release(); // packet of last read is done
+  packet->clear();
+  packet->pktHdr = &m_pktHdr;
+  while (true)
+  {
+    int i = fileMap.next(packet);
+    if (i == 0)
+    {
+      SET_DEBUG_ERROR(SnoopError, "end of file", VERR_IN_PCAP_NEXT_EX);
+      return VERR_FAIL;
+    }
+    if (i < 0)
+    {
+      error = fileMap.error;
+      return VERR_FAIL;
+    }
+    if (!mapFilter(packet)) continue;
+    break;
+  }
+  if (autoParse) parse(packet);
+  return packet->pktHdr->caplen;
+}
+
+int SnoopFile::mapReadBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  //
+  // Packet data stays in the mapping, so no arena is needed.
+  //
+  batch.reserve(max, 0);
+  batch.clear();
+  fileMap.release(); // packets of last burst are done
+  while (batch.count < max)
+  {
+    SnoopPacket* packet = batch.next();
+    int i = fileMap.next(packet);
+    if (i <= 0)
+    {
+      batch.count--; // give back unused descriptor
+      if (i < 0)
+      {
+        error = fileMap.error;
+        return VERR_FAIL;
+      }
+      if (batch.count == 0)
+      {
+        SET_DEBUG_ERROR(SnoopError, "end of file", VERR_IN_PCAP_NEXT_EX);
+        return VERR_FAIL;
+      }
+      break;
+    }
+    if (!mapFilter(packet))
+    {
+      batch.count--;
+      continue;
+    }
+    int check = timeCheck(packet);
+    if (check != 0)
+    {
+      batch.count--;
+      if (check < 0) continue;
+      fileMap.unread(); // stays at end time
+      if (batch.count == 0)
+      {
+        SET_DEBUG_ERROR(SnoopError, "end time reached", VERR_IN_PCAP_NEXT_EX);
+        return VERR_FAIL;
+      }
+      break;
+    }
+    if (speed != 0)
+    {
+      //
+      // First packet waits for its time. Following ones join the burst only while they are due,
+      // otherwise the record is put back for the next call.
+      //
+      if (batch.count > 1 && !pacer.due(packet))
+      {
+        batch.count--;
+        fileMap.unread();
+        break;
+      }
+      pacer.wait(packet);
+    }
+  }
+
+  if (autoParse)
+  {
+    for (int j = 0; j < batch.count; j++)
+      parse(batch.at(j));
+  }
+  return batch.count;
+}
+
+bool SnoopFile::mapFilter(SnoopPacket* packet)
+{
+  //
+  // Filter is compiled for the first link type. Packets of other pcapng interfaces are not filtered.
+  //
+  if (!m_codeValid || packet->linkType != m_dataLink) return true;
+  return pcap_offline_filter(&m_code, packet->pktHdr, packet->pktData) != 0;
+}
+
+bool SnoopFile::parseTime(QString s, INT64& ts)
+{
+  ts = 0;
+  if (s == "") return true;
+  bool ok;
+  double d = s.toDouble(&ok);
+  if (ok)
+  {
+    ts = (INT64)(d * 1000000);
+    return true;
+  }
+  QDateTime dt = QDateTime::fromString(s, Qt::ISODate);
+  if (!dt.isValid()) dt = QDateTime::fromString(s, "yyyy-MM-dd hh:mm:ss.zzz");
+  if (!dt.isValid()) dt = QDateTime::fromString(s, "yyyy-MM-dd hh:mm:ss");
+  if (!dt.isValid())
+  {
+    SET_ERROR(SnoopError, qformat("invalid time(%s)", qPrintable(s)), VERR_FAIL);
+    return false;
+  }
+  ts = (INT64)dt.toMSecsSinceEpoch() * 1000;
+  return true;
+}
+
+bool SnoopFile::isPcapng(QString fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  UINT32 type = 0;
+  if (file.read((char*)&type, sizeof(type)) != sizeof(type)) return false;
+  return type == 0x0A0D0D0A; // Section Header Block type is palindromic
+}
+
+bool SnoopFile::seekStart()
+{
+  //
+  // Index is built on first use. Without it(compressed file, read only directory, ...) records are skipped one by one.
+  //
+  if (fileMap.compressed()) return true;
+  if (!index.load(fileName))
+  {
+    LOG_DEBUG("building index(%s)", qPrintable(SnoopFileIndex::indexFileName(fileName)));
+    if (!index.build(fileName, indexInterval))
+    {
+      LOG_WARN("can not build index(%s)", qPrintable(index.error.msg));
+      if (index.entries.count() == 0) return true;
+    }
+  }
+  UINT64 offset = index.find(m_startTs);
+  LOG_DEBUG("seek to %llu for startTime %s", (unsigned long long)offset, qPrintable(startTime));
+  if (m_mapMode)
+  {
+    if (!fileMap.seek(offset, index.headerBlocks.isEmpty() ? NULL : &index.headerBlocks))
+    {
+      error = fileMap.error;
+      return false;
+    }
+    return true;
+  }
+  FILE* fp = pcap_file(m_pcap); // pcap only, pcapng goes through map mode
+  if (fp == NULL || fseek(fp, (long)offset, SEEK_SET) != 0)
+    LOG_WARN("can not seek to %llu(%s)", (unsigned long long)offset, qPrintable(fileName));
+  return true;
+}
+
+int SnoopFile::timeCheck(SnoopPacket* packet)
+{
+  if (m_startTs == 0 && m_endTs == 0) return 0;
+  INT64 ts = (INT64)packet->pktHdr->ts.tv_sec * 1000000 + packet->pktHdr->ts.tv_usec;
+  if (m_startTs != 0 && ts < m_startTs) return -1;
+  if (m_endTs != 0 && ts > m_endTs) return 1;
+  return 0;
+}
+
+bool SnoopFile::loopLoad()
+{
+  VTick startTick = tick();
+  bool  _autoParse = autoParse;
+  autoParse = false;
+  SnoopPacket packet;
+  INT64 firstTs = 0, lastTs = 0;
+  while (true)
+  {
+    int res = readRange(&packet);
+    if (res < 0) break;
+    LoopItem item;
+    item.pktHdr      = *packet.pktHdr;
+    item.tsNsec      = packet.tsNsec;
+    item.linkType    = packet.linkType;
+    item.interfaceId = packet.interfaceId;
+    item.offset      = loopData.size();
+    if ((qint64)loopData.size() + (qint64)packet.pktHdr->caplen > (qint64)MAX_LOOP_DATA)
+    {
+      SET_ERROR(SnoopError, qformat("packets of %s exceed %d MB of memory replay, narrow startTime and endTime or set loopCount to 1",
+        qPrintable(fileName), MAX_LOOP_DATA / (1024 * 1024)), VERR_NOT_SUPPORTED);
+      autoParse = _autoParse;
+      loopData.clear();
+      loopItems.clear();
+      return false;
+    }
+    loopData.append((const char*)packet.pktData, (int)packet.pktHdr->caplen);
+    loopItems.push_back(item);
+    if ((int)item.pktHdr.caplen > m_loopSnapLen) m_loopSnapLen = (int)item.pktHdr.caplen;
+
+    INT64 ts = (INT64)item.pktHdr.ts.tv_sec * 1000000 + item.pktHdr.ts.tv_usec;
+    if (loopItems.count() == 1) firstTs = ts;
+    lastTs = ts;
+  }
+  autoParse = _autoParse;
+  m_loaded  = true;
+
+  int _count = loopItems.count();
+  if (_count == 0)
+  {
+    SET_ERROR(SnoopError, qformat("no packet to replay(%s)", qPrintable(fileName)), VERR_VALUE_IS_ZERO);
+    return false;
+  }
+  //
+  // Next replay starts one average gap after the last packet, so that timestamps keep increasing.
+  //
+  INT64 span = lastTs - firstTs;
+  if (span < 0) span = 0;
+  m_loopSpan = span + (_count > 1 ? span / (_count - 1) : 0) + 1;
+  LOG_DEBUG("%d packets(%d bytes) loaded for replay in %llu msec", _count, loopData.size(), (unsigned long long)(tick() - startTick));
+  return true;
+}
+
+bool SnoopFile::loopNext(SnoopPacket* packet, PKT_HDR* pktHdr, BYTE* buf)
+{
+  if (!m_loaded && !loopLoad()) return false;
+  if (m_loopIdx >= loopItems.count())
+  {
+    m_loopIdx = 0;
+    m_loopIter++;
+  }
+  if (loopCount != 0 && m_loopIter >= loopCount)
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("replay done(%d)", loopCount), VERR_IN_PCAP_NEXT_EX);
+    return false;
+  }
+  LoopItem& item = loopItems[m_loopIdx++];
+
+  *pktHdr = item.pktHdr;
+  INT64 ts = (INT64)pktHdr->ts.tv_sec * 1000000 + pktHdr->ts.tv_usec + m_loopSpan * m_loopIter;
+  pktHdr->ts.tv_sec  = (long)(ts / 1000000);
+  pktHdr->ts.tv_usec = (long)(ts % 1000000);
+  memcpy(buf, loopData.constData() + item.offset, pktHdr->caplen);
+
+  packet->pktHdr      = pktHdr;
+  packet->pktData     = buf;
+  packet->tsNsec      = item.tsNsec != 0 ? (UINT32)(pktHdr->ts.tv_usec * 1000 + item.tsNsec % 1000) : 0;
+  packet->linkType    = item.linkType;
+  packet->interfaceId = item.interfaceId;
+  if (m_loopIter > 0 && loopRewrite)
+  {
+    parse(packet);
+    loopRewritePacket(packet);
+  } else
+  if (autoParse) parse(packet);
+  return true;
+}
+
+static inline Ip loopIp(Ip ip, int iter)
+{
+  //
+  // Lower 16 bits are xored with a key unique for each replay(0x9E37 is odd), the same for both directions of a flow.
+  //
+  UINT32 key = ((UINT32)iter * 0x9E37) & 0xFFFF;
+  return Ip((UINT32)ip ^ key);
+}
+
+static inline UINT16 loopPort(UINT16 port, int iter)
+{
+  if (port < 1024) return port; // well known service stays
+  return (UINT16)(1024 + ((UINT32)(port - 1024) + (UINT32)iter * 7919) % 64512);
+}
+
+void SnoopFile::loopRewritePacket(SnoopPacket* packet)
+{
+  IP_HDR* ipHdr = packet->ipHdr;
+  if (ipHdr == NULL) return;
+
+  Ip oldSrcIp = ntohl(ipHdr->ip_src);
+  Ip oldDstIp = ntohl(ipHdr->ip_dst);
+  Ip newSrcIp = loopIp(oldSrcIp, m_loopIter);
+  Ip newDstIp = loopIp(oldDstIp, m_loopIter);
+  ipHdr->ip_src = htonl(newSrcIp);
+  ipHdr->ip_dst = htonl(newDstIp);
+
+  UINT16 ipChecksum = ntohs(ipHdr->ip_sum);
+  ipChecksum = SnoopIp::recalculateChecksum(ipChecksum, (UINT32)oldSrcIp, (UINT32)newSrcIp);
+  ipChecksum = SnoopIp::recalculateChecksum(ipChecksum, (UINT32)oldDstIp, (UINT32)newDstIp);
+  ipHdr->ip_sum = htons(ipChecksum);
+
+  UINT16* sport = NULL;
+  UINT16* dport = NULL;
+  UINT16* sum   = NULL;
+  if (packet->tcpHdr != NULL)
+  {
+    sport = &packet->tcpHdr->th_sport;
+    dport = &packet->tcpHdr->th_dport;
+    sum   = &packet->tcpHdr->th_sum;
+  } else
+  if (packet->udpHdr != NULL)
+  {
+    sport = &packet->udpHdr->uh_sport;
+    dport = &packet->udpHdr->uh_dport;
+    sum   = packet->udpHdr->uh_sum != 0 ? &packet->udpHdr->uh_sum : NULL; // 0 : no checksum
+  }
+  if (sport == NULL) return;
+
+  UINT16 oldSrcPort = ntohs(*sport);
+  UINT16 oldDstPort = ntohs(*dport);
+  UINT16 newSrcPort = loopPort(oldSrcPort, m_loopIter);
+  UINT16 newDstPort = loopPort(oldDstPort, m_loopIter);
+  *sport = htons(newSrcPort);
+  *dport = htons(newDstPort);
+
+  if (sum == NULL) return;
+  UINT16 checksum = ntohs(*sum);
+  checksum = SnoopIp::recalculateChecksum(checksum, (UINT32)oldSrcIp, (UINT32)newSrcIp);
+  checksum = SnoopIp::recalculateChecksum(checksum, (UINT32)oldDstIp, (UINT32)newDstIp);
+  checksum = SnoopIp::recalculateChecksum(checksum, oldSrcPort, newSrcPort);
+  checksum = SnoopIp::recalculateChecksum(checksum, oldDstPort, newDstPort);
+  *sum = htons(checksum);
+}
+
+int SnoopFile::loopRead(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  packet->clear();
+  if (!m_loaded && !loopLoad()) return VERR_FAIL;
+  if (loopBuf.size() < m_loopSnapLen) loopBuf.resize(m_loopSnapLen);
+  if (!loopNext(packet, &m_loopHdr, (BYTE*)loopBuf.data())) return VERR_FAIL;
+  return packet->pktHdr->caplen;
+}
+
+int SnoopFile::loopReadBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  if (!m_loaded && !loopLoad()) return VERR_FAIL;
+
+  //
+  // Each packet is copied into batch arena and rewritten there.
+  //
+  batch.reserve(max, m_loopSnapLen);
+  batch.clear();
+  while (batch.count < max)
+  {
+    int i = batch.count;
+    SnoopPacket* packet = batch.next();
+    if (!loopNext(packet, packet->pktHdr, batch.buffer(i)))
+    {
+      batch.count--;
+      if (batch.count == 0) return VERR_FAIL;
+      break;
+    }
+  }
+  return batch.count;
+}
+
 void SnoopFile::load(VXml xml)
 {
   SnoopPcap::load(xml);
 
   fileName = xml.getStr("fileName", fileName);
   speed    = xml.getDouble("speed", speed);
+  memoryMap = xml.getBool("memoryMap", memoryMap);
+  burstGap  = xml.getInt("burstGap", burstGap);
+  spinTime  = xml.getInt("spinTime", spinTime);
+  startTime = xml.getStr("startTime", startTime);
+  endTime   = xml.getStr("endTime", endTime);
+  indexInterval = xml.getInt("indexInterval", indexInterval);
+  loopCount   = xml.getInt("loopCount", loopCount);
+  loopRewrite = xml.getBool("loopRewrite", loopRewrite);
 }
 
 void SnoopFile::save(VXml xml)
@@ -100,6 +603,14 @@ void SnoopFile::save(VXml xml)
 
   xml.setStr("fileName", fileName);
   xml.setDouble("speed", speed);
+  xml.setBool("memoryMap", memoryMap);
+  xml.setInt("burstGap", burstGap);
+  xml.setInt("spinTime", spinTime);
+  xml.setStr("startTime", startTime);
+  xml.setStr("endTime", endTime);
+  xml.setInt("indexInterval", indexInterval);
+  xml.setInt("loopCount", loopCount);
+  xml.setBool("loopRewrite", loopRewrite);
 }
 
 #ifdef QT_GUI_LIB
@@ -109,6 +620,14 @@ void SnoopFile::optionAddWidget(QLayout *layout)
 
   VOptionable::addLineEdit(layout, "leFileName", "File Name", fileName);
   VOptionable::addLineEdit(layout, "leSpeed",    "Speed",     QString::number(speed));
+  VOptionable::addCheckBox(layout, "chkMemoryMap", "Memory Map", memoryMap);
+  VOptionable::addLineEdit(layout, "leBurstGap",   "Burst Gap", QString::number(burstGap));
+  VOptionable::addLineEdit(layout, "leSpinTime",   "Spin Time", QString::number(spinTime));
+  VOptionable::addLineEdit(layout, "leStartTime",  "Start Time", startTime);
+  VOptionable::addLineEdit(layout, "leEndTime",    "End Time",   endTime);
+  VOptionable::addLineEdit(layout, "leIndexInterval", "Index Interval", QString::number(indexInterval));
+  VOptionable::addLineEdit(layout, "leLoopCount",  "Loop Count", QString::number(loopCount));
+  VOptionable::addCheckBox(layout, "chkLoopRewrite", "Loop Rewrite", loopRewrite);
 }
 
 void SnoopFile::optionSaveDlg(QDialog *dialog)
@@ -117,5 +636,151 @@ void SnoopFile::optionSaveDlg(QDialog *dialog)
 
   fileName = dialog->findChild<QLineEdit*>("leFileName")->text();
   speed    = dialog->findChild<QLineEdit*>("leSpeed")->text().toDouble();
+  memoryMap = dialog->findChild<QCheckBox*>("chkMemoryMap")->checkState() == Qt::Checked;
+  burstGap  = dialog->findChild<QLineEdit*>("leBurstGap")->text().toInt();
+  spinTime  = dialog->findChild<QLineEdit*>("leSpinTime")->text().toInt();
+  startTime = dialog->findChild<QLineEdit*>("leStartTime")->text();
+  endTime   = dialog->findChild<QLineEdit*>("leEndTime")->text();
+  indexInterval = dialog->findChild<QLineEdit*>("leIndexInterval")->text().toInt();
+  loopCount   = dialog->findChild<QLineEdit*>("leLoopCount")->text().toInt();
+  loopRewrite = dialog->findChild<QCheckBox*>("chkLoopRewrite")->checkState() == Qt::Checked;
 }
 #endif // QT_GUI_LIB
+
+#ifdef GTEST
+#include <gtest/gtest.h>
+#include <SnoopTcp>
+#include <SnoopUdp>
+
+class SnoopFileLoopTest : public SnoopFile
+{
+public:
+  void rewrite(SnoopPacket* packet, int iter)
+  {
+    m_loopIter = iter;
+    loopRewritePacket(packet);
+  }
+};
+
+//
+// Ethernet + IPv4 + TCP or UDP + 3 bytes of data, with valid checksums.
+//
+static void loopTestPacket(BYTE* buf, PKT_HDR* pktHdr, SnoopPacket* packet, UINT8 proto, UINT32 srcIp, UINT32 dstIp, UINT16 srcPort, UINT16 dstPort, bool udpChecksum = true)
+{
+  int l4Len = proto == IPPROTO_TCP ? 20 : 8;
+  int size  = sizeof(ETH_HDR) + sizeof(IP_HDR) + l4Len + 3;
+  memset(buf, 0, size);
+
+  ETH_HDR* ethHdr = (ETH_HDR*)buf;
+  ethHdr->ether_type = htons(ETHERTYPE_IP);
+
+  IP_HDR* ipHdr = (IP_HDR*)(buf + sizeof(ETH_HDR));
+  *(BYTE*)ipHdr  = 0x45;
+  ipHdr->ip_len  = htons((UINT16)(size - sizeof(ETH_HDR)));
+  ipHdr->ip_ttl  = 64;
+  ipHdr->ip_p    = proto;
+  ipHdr->ip_src  = htonl(srcIp);
+  ipHdr->ip_dst  = htonl(dstIp);
+
+  BYTE* l4 = (BYTE*)ipHdr + sizeof(IP_HDR);
+  memcpy(l4 + l4Len, "abc", 3);
+  if (proto == IPPROTO_TCP)
+  {
+    TCP_HDR* tcpHdr = (TCP_HDR*)l4;
+    tcpHdr->th_sport = htons(srcPort);
+    tcpHdr->th_dport = htons(dstPort);
+    l4[12] = 0x50; // data offset
+    tcpHdr->th_sum = htons(SnoopTcp::checksum(ipHdr, tcpHdr));
+  } else
+  {
+    UDP_HDR* udpHdr = (UDP_HDR*)l4;
+    udpHdr->uh_sport = htons(srcPort);
+    udpHdr->uh_dport = htons(dstPort);
+    udpHdr->uh_ulen  = htons((UINT16)(l4Len + 3));
+    if (udpChecksum) udpHdr->uh_sum = htons(SnoopUdp::checksum(ipHdr, udpHdr));
+  }
+  ipHdr->ip_sum = htons(SnoopIp::checksum(ipHdr));
+
+  pktHdr->caplen = pktHdr->len = (UINT32)size;
+  packet->clear();
+  packet->pktHdr   = pktHdr;
+  packet->pktData  = buf;
+  packet->linkType = DLT_EN10MB;
+}
+
+static bool loopSumEqual(UINT16 a, UINT16 b) // 0x0000 and 0xFFFF are the same in one's complement
+{
+  return a == b || (a == 0x0000 && b == 0xFFFF) || (a == 0xFFFF && b == 0x0000);
+}
+
+TEST( SnoopFile, loopRewriteTcp )
+{
+  SnoopFileLoopTest file;
+  BYTE        buf[128];
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+
+  int iters[] = { 1, 2, 3, 7, 1000, 65536 };
+  for (int i = 0; i < (int)(sizeof(iters) / sizeof(iters[0])); i++)
+  {
+    int iter = iters[i];
+    loopTestPacket(buf, &pktHdr, &packet, IPPROTO_TCP, 0xC0A80A01, 0x08080808, 40000, 80);
+    file.parse(&packet);
+    ASSERT_TRUE( packet.tcpHdr != NULL );
+    file.rewrite(&packet, iter);
+
+    EXPECT_TRUE( loopSumEqual(ntohs(packet.ipHdr->ip_sum), SnoopIp::checksum(packet.ipHdr)) );
+    EXPECT_TRUE( loopSumEqual(ntohs(packet.tcpHdr->th_sum), SnoopTcp::checksum(packet.ipHdr, packet.tcpHdr)) );
+    EXPECT_EQ( 80, ntohs(packet.tcpHdr->th_dport) ); // well known port stays
+    EXPECT_NE( 40000, ntohs(packet.tcpHdr->th_sport) );
+    EXPECT_EQ( 0xC0A80000u, ntohl(packet.ipHdr->ip_src) & 0xFFFF0000 ); // upper 16 bits stay
+  }
+}
+
+TEST( SnoopFile, loopRewriteUdp )
+{
+  SnoopFileLoopTest file;
+  BYTE        buf[128];
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+
+  loopTestPacket(buf, &pktHdr, &packet, IPPROTO_UDP, 0x0A000001, 0x0A000002, 5353, 33333);
+  file.parse(&packet);
+  ASSERT_TRUE( packet.udpHdr != NULL );
+  file.rewrite(&packet, 5);
+  EXPECT_TRUE( loopSumEqual(ntohs(packet.ipHdr->ip_sum), SnoopIp::checksum(packet.ipHdr)) );
+  EXPECT_TRUE( loopSumEqual(ntohs(packet.udpHdr->uh_sum), SnoopUdp::checksum(packet.ipHdr, packet.udpHdr)) );
+
+  //
+  // No checksum stays no checksum.
+  //
+  loopTestPacket(buf, &pktHdr, &packet, IPPROTO_UDP, 0x0A000001, 0x0A000002, 5353, 33333, false);
+  file.parse(&packet);
+  file.rewrite(&packet, 5);
+  EXPECT_EQ( 0, packet.udpHdr->uh_sum );
+  EXPECT_TRUE( loopSumEqual(ntohs(packet.ipHdr->ip_sum), SnoopIp::checksum(packet.ipHdr)) );
+  EXPECT_NE( 5353, ntohs(packet.udpHdr->uh_sport) );
+}
+
+TEST( SnoopFile, loopRewriteFlow )
+{
+  //
+  // Both directions of a flow map to the same rewritten flow.
+  //
+  SnoopFileLoopTest file;
+  BYTE        buf1[128], buf2[128];
+  PKT_HDR     pktHdr1, pktHdr2;
+  SnoopPacket packet1, packet2;
+
+  loopTestPacket(buf1, &pktHdr1, &packet1, IPPROTO_TCP, 0xC0A80A01, 0xC0A80A02, 40000, 50000);
+  loopTestPacket(buf2, &pktHdr2, &packet2, IPPROTO_TCP, 0xC0A80A02, 0xC0A80A01, 50000, 40000);
+  file.parse(&packet1);
+  file.parse(&packet2);
+  file.rewrite(&packet1, 3);
+  file.rewrite(&packet2, 3);
+  EXPECT_EQ( packet1.ipHdr->ip_src, packet2.ipHdr->ip_dst );
+  EXPECT_EQ( packet1.ipHdr->ip_dst, packet2.ipHdr->ip_src );
+  EXPECT_EQ( packet1.tcpHdr->th_sport, packet2.tcpHdr->th_dport );
+  EXPECT_EQ( packet1.tcpHdr->th_dport, packet2.tcpHdr->th_sport );
+}
+#endif // GTEST
@@ -12,7 +12,9 @@
 #define __SNOOP_FILE_H__
 
 #include <SnoopPcap>
-#include <VTick>
+#include <SnoopFileIndex>
+#include <SnoopFileMap>
+#include <SnoopPacer>
 
 // ----------------------------------------------------------------------------
 // SnoopFile
@@ -29,14 +31,73 @@ protected:
 
 public:
   virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
 
 public:
   QString fileName;
   double      speed;
+  bool        memoryMap; // read pcap or pcapng file through mmap without copy
+  int         burstGap;  // usec, packets closer than this are released together when speed is not zero
+  int         spinTime;  // usec, busy wait instead of sleeping for the last spinTime before a packet is due
+  QString     startTime; // epoch seconds or ISO date time, empty : from first packet
+  QString     endTime;   // epoch seconds or ISO date time, empty : to last packet
+  int         indexInterval; // packets per entry of sidecar time index
+  int         loopCount;     // 1 : read file once, n : replay n times from memory, 0 : replay forever
+  bool        loopRewrite;   // rewrite ip and port on each replay so that every replay makes new flows
+
+public:
+  SnoopPacer  pacer;
+
+protected:
+  SnoopFileMap fileMap;
+  bool         m_mapMode; // memoryMap or compressed file
+  bpf_program  m_code;
+  bool         m_codeValid;
+  PKT_HDR      m_pktHdr; // for read() in memoryMap mode
+  bool         mapOpen();
+  int          mapRead(SnoopPacket* packet);
+  int          mapReadBurst(SnoopPacketBatch& batch, int max);
+  bool         mapFilter(SnoopPacket* packet);
+
+protected:
+  SnoopFileIndex index;
+  INT64        m_startTs; // usec, 0 : not used
+  INT64        m_endTs;   // usec, 0 : not used
+  bool         parseTime(QString s, INT64& ts);
+  bool         seekStart();
+  static bool  isPcapng(QString fileName);
+  int          timeCheck(SnoopPacket* packet); // -1 : before startTime, 0 : in range, 1 : after endTime
+  int          readRange(SnoopPacket* packet);
 
 protected:
-  long  startTS;
-  VTick startTick;
+  //
+  // Loop replay. Packets are loaded on first read, and each one is copied out before rewriting,
+  // so that processors changing packet data do not touch loaded packets.
+  //
+  class LoopItem
+  {
+  public:
+    PKT_HDR pktHdr;
+    UINT32  tsNsec;
+    int     linkType;
+    int     interfaceId;
+    int     offset; // in loopData
+  };
+  static const int MAX_LOOP_DATA = 0x7FF00000; // QByteArray with int offset
+  QByteArray       loopData;
+  QVector<LoopItem> loopItems;
+  QByteArray       loopBuf;    // for read()
+  PKT_HDR          m_loopHdr;  // for read()
+  bool             m_loaded;
+  int              m_loopIdx;  // next item
+  int              m_loopIter; // current replay, 0 : original
+  INT64            m_loopSpan; // usec, timestamp shift of each replay
+  int              m_loopSnapLen; // largest caplen loaded
+  bool             loopLoad();
+  bool             loopNext(SnoopPacket* packet, PKT_HDR* pktHdr, BYTE* buf);
+  void             loopRewritePacket(SnoopPacket* packet);
+  int              loopRead(SnoopPacket* packet);
+  int              loopReadBurst(SnoopPacketBatch& batch, int max);
 
 public:
   virtual void load(VXml xml);
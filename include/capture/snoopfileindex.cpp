@@ -0,0 +1,164 @@
+#include <SnoopFileIndex>
+#include <SnoopFileMap>
+#include <QFileInfo>
+#include <VFile> // for VERR_FILE_NOT_EXIST
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// index file format(host byte order)
+// ----------------------------------------------------------------------------
+static const UINT32 INDEX_MAGIC   = 0x58444E53; // "SNDX"
+static const UINT32 INDEX_VERSION = 2;
+
+#pragma pack(push, 1)
+typedef struct
+{
+  UINT32 magic;
+  UINT32 version;
+  UINT32 interval;
+  UINT32 headerCount; // pcapng header block offsets after entries
+  UINT64 fileSize;
+  INT64  fileTime; // last modified(secs since epoch)
+  UINT64 count;
+} INDEX_HDR;
+#pragma pack(pop)
+
+// ----------------------------------------------------------------------------
+// SnoopFileIndex
+// ----------------------------------------------------------------------------
+SnoopFileIndex::SnoopFileIndex()
+{
+  interval = 0;
+  fileSize = 0;
+}
+
+SnoopFileIndex::~SnoopFileIndex()
+{
+}
+
+bool SnoopFileIndex::build(QString fileName, int interval)
+{
+  if (interval <= 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid interval(%d)", interval), VERR_VALUE_IS_ZERO);
+    return false;
+  }
+  SnoopFileMap fileMap;
+  if (!fileMap.open(fileName))
+  {
+    error = fileMap.error;
+    return false;
+  }
+  if (fileMap.compressed())
+  {
+    SET_ERROR(SnoopError, "index not supported on compressed file", VERR_NOT_SUPPORTED);
+    return false;
+  }
+
+  this->interval = interval;
+  fileSize = fileMap.size();
+  entries.clear();
+  headerBlocks.clear();
+
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+  packet.clear();
+  packet.pktHdr = &pktHdr;
+  SnoopFileIndexEntry entry;
+  int n = 0;
+  while (true)
+  {
+    int i = fileMap.next(&packet);
+    if (i < 0)
+    {
+      error = fileMap.error;
+      entries.clear();
+      return false;
+    }
+    if (i == 0) break;
+
+    INT64 ts = (INT64)pktHdr.ts.tv_sec * 1000000 + pktHdr.ts.tv_usec;
+    if (n == 0)
+    {
+      entry.offset = fileMap.recordOffset();
+      entry.maxTs  = ts;
+    } else
+    if (ts > entry.maxTs) entry.maxTs = ts;
+    if (++n == interval)
+    {
+      entries.push_back(entry);
+      n = 0;
+    }
+  }
+  if (n != 0) entries.push_back(entry);
+  headerBlocks = fileMap.headerBlocks();
+  LOG_DEBUG("index built file=%s entries=%d headers=%d interval=%d", qPrintable(fileName), entries.count(), headerBlocks.count(), interval);
+
+  return save(fileName);
+}
+
+bool SnoopFileIndex::load(QString fileName)
+{
+  QFile file(indexFileName(fileName));
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("can not open index(%s)", qPrintable(file.fileName())), VERR_FILE_NOT_EXIST);
+    return false;
+  }
+  INDEX_HDR hdr;
+  QFileInfo fi(fileName);
+  if (file.read((char*)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+      hdr.magic != INDEX_MAGIC || hdr.version != INDEX_VERSION ||
+      hdr.fileSize != (UINT64)fi.size() || hdr.fileTime != (INT64)fi.lastModified().toTime_t())
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("stale index(%s)", qPrintable(file.fileName())), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  entries.resize((int)hdr.count);
+  headerBlocks.resize((int)hdr.headerCount);
+  qint64 size = (qint64)hdr.count * (qint64)sizeof(SnoopFileIndexEntry);
+  qint64 headerSize = (qint64)hdr.headerCount * (qint64)sizeof(UINT64);
+  if (file.read((char*)entries.data(), size) != size || file.read((char*)headerBlocks.data(), headerSize) != headerSize)
+  {
+    SET_ERROR(SnoopError, qformat("truncated index(%s)", qPrintable(file.fileName())), VERR_INVALID_PCAP_FILE);
+    entries.clear();
+    headerBlocks.clear();
+    return false;
+  }
+  interval = (int)hdr.interval;
+  fileSize = hdr.fileSize;
+  return true;
+}
+
+bool SnoopFileIndex::save(QString fileName)
+{
+  QFile file(indexFileName(fileName));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    SET_ERROR(SnoopError, qformat("can not write index(%s) %s", qPrintable(file.fileName()), qPrintable(file.errorString())), VERR_NOT_WRITABLE);
+    return false;
+  }
+  INDEX_HDR hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic       = INDEX_MAGIC;
+  hdr.version     = INDEX_VERSION;
+  hdr.interval    = (UINT32)interval;
+  hdr.fileSize    = fileSize;
+  hdr.fileTime    = (INT64)QFileInfo(fileName).lastModified().toTime_t();
+  hdr.count       = (UINT64)entries.count();
+  hdr.headerCount = (UINT32)headerBlocks.count();
+  file.write((const char*)&hdr, sizeof(hdr));
+  file.write((const char*)entries.constData(), (qint64)entries.count() * (qint64)sizeof(SnoopFileIndexEntry));
+  file.write((const char*)headerBlocks.constData(), (qint64)headerBlocks.count() * (qint64)sizeof(UINT64));
+  return true;
+}
+
+UINT64 SnoopFileIndex::find(INT64 ts)
+{
+  int _count = entries.count();
+  for (int i = 0; i < _count; i++)
+  {
+    if (entries[i].maxTs >= ts) return entries[i].offset;
+  }
+  return fileSize;
+}
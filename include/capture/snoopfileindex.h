@@ -0,0 +1,56 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FILE_INDEX_H__
+#define __SNOOP_FILE_INDEX_H__
+
+#include <SnoopCommon>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+// SnoopFileIndexEntry
+// ----------------------------------------------------------------------------
+class SnoopFileIndexEntry
+{
+public:
+  UINT64 offset; // file offset of first record in block
+  INT64  maxTs;  // usec, latest timestamp in block(timestamps need not be sorted)
+};
+
+// ----------------------------------------------------------------------------
+// SnoopFileIndex
+// ----------------------------------------------------------------------------
+/// Sidecar time index(fileName.idx) of a pcap or pcapng file, one entry every interval packets
+class SnoopFileIndex
+{
+public:
+  SnoopFileIndex();
+  virtual ~SnoopFileIndex();
+
+public:
+  VError                       error;
+  int                          interval;
+  UINT64                       fileSize;
+  QVector<SnoopFileIndexEntry> entries;
+  QVector<UINT64>              headerBlocks; // pcapng : offsets of SHB and IDB blocks, replayed on seek
+
+public:
+  static QString indexFileName(QString fileName) { return fileName + ".idx"; }
+
+public:
+  bool build(QString fileName, int interval);
+  bool load(QString fileName); // fails if index is missing or older than file
+  bool save(QString fileName);
+
+public:
+  UINT64 find(INT64 ts); // offset of first block which may hold a packet at ts or later(fileSize if none)
+};
+
+#endif // __SNOOP_FILE_INDEX_H__
@@ -0,0 +1,789 @@
+#include <SnoopFileMap>
+#ifdef linux
+#include <sys/mman.h>
+#endif // linux
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// pcap file format
+// ----------------------------------------------------------------------------
+static const UINT32 PCAP_MAGIC_USEC = 0xA1B2C3D4;
+static const UINT32 PCAP_MAGIC_NSEC = 0xA1B23C4D;
+static const UINT32 MAX_CAPLEN      = 262144;
+
+// ----------------------------------------------------------------------------
+// pcapng file format
+// ----------------------------------------------------------------------------
+static const UINT32 PCAPNG_SHB              = 0x0A0D0D0A; // Section Header Block
+static const UINT32 PCAPNG_IDB              = 1;          // Interface Description Block
+static const UINT32 PCAPNG_PB               = 2;          // Packet Block(obsolete)
+static const UINT32 PCAPNG_SPB              = 3;          // Simple Packet Block
+static const UINT32 PCAPNG_EPB              = 6;          // Enhanced Packet Block
+static const UINT32 PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static const UINT16 PCAPNG_OPT_ENDOFOPT     = 0;
+static const UINT16 PCAPNG_OPT_IF_TSRESOL   = 9;
+static const UINT16 PCAPNG_OPT_IF_TSOFFSET  = 14;
+
+#pragma pack(push, 1)
+typedef struct
+{
+  UINT32 magic;
+  UINT16 versionMajor;
+  UINT16 versionMinor;
+  INT32  thisZone;
+  UINT32 sigFigs;
+  UINT32 snapLen;
+  UINT32 linkType;
+} PCAP_FILE_HDR;
+
+typedef struct
+{
+  UINT32 tsSec;
+  UINT32 tsFrac; // usec or nsec
+  UINT32 capLen;
+  UINT32 len;
+} PCAP_REC_HDR;
+#pragma pack(pop)
+
+// ----------------------------------------------------------------------------
+// SnoopFileMap
+// ----------------------------------------------------------------------------
+SnoopFileMap::SnoopFileMap()
+{
+  m_begin    = NULL;
+  m_end      = NULL;
+  m_pos      = NULL;
+  m_recordPos = NULL;
+  m_dataLink = DLT_NULL;
+  m_snapLen  = 0;
+  m_nsec     = false;
+  m_swapped  = false;
+  m_ng       = false;
+  stream     = NULL;
+}
+
+SnoopFileMap::~SnoopFileMap()
+{
+  close();
+}
+
+bool SnoopFileMap::open(QString fileName)
+{
+  if (SnoopFileStream::detect(fileName) != SnoopFileStream::None)
+  {
+    //
+    // Compressed file is decompressed by a background thread, and the window moves from block to block.
+    //
+    stream = new SnoopFileStream;
+    stream->fileName = fileName;
+    if (!stream->open())
+    {
+      error = stream->error;
+      return false;
+    }
+    m_pos = m_end = NULL;
+    if (!need(4))
+    {
+      SET_ERROR(SnoopError, qformat("empty stream(%s) %s", qPrintable(fileName), qPrintable(stream->errorMsg())), VERR_INVALID_PCAP_FILE);
+      return false;
+    }
+    return readHeader(fileName);
+  }
+
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::ReadOnly))
+  {
+    SET_ERROR(SnoopError, qformat("can not open file(%s) %s", qPrintable(fileName), qPrintable(m_file.errorString())), VERR_IN_MMAP);
+    return false;
+  }
+  qint64 _size = m_file.size();
+  if (_size < (qint64)sizeof(PCAP_FILE_HDR))
+  {
+    SET_ERROR(SnoopError, qformat("too small file(%s) size=%lld", qPrintable(fileName), _size), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  m_begin = (BYTE*)m_file.map(0, _size);
+  if (m_begin == NULL)
+  {
+    SET_ERROR(SnoopError, qformat("error in map(%s) %s", qPrintable(fileName), qPrintable(m_file.errorString())), VERR_IN_MMAP);
+    return false;
+  }
+  m_end = m_begin + _size;
+  m_pos = m_begin;
+#ifdef linux
+  //
+  // Records are walked once from the start, so let kernel read ahead aggressively.
+  //
+  if (madvise(m_begin, (size_t)_size, MADV_SEQUENTIAL) == -1)
+    LOG_WARN("error in madvise(%s)", strerror(errno));
+#endif // linux
+  return readHeader(fileName);
+}
+
+bool SnoopFileMap::readHeader(QString fileName)
+{
+  UINT32 magic;
+  memcpy(&magic, m_pos, sizeof(magic));
+  if (magic == PCAPNG_SHB)
+  {
+    //
+    // Header blocks are read now, so that dataLink is known before first packet.
+    //
+    m_ng        = true;
+    m_recordPos = m_pos;
+    while (need(8))
+    {
+      UINT32 type = get32(m_pos);
+      if (type == PCAPNG_PB || type == PCAPNG_SPB || type == PCAPNG_EPB) break;
+      if (nextBlock(NULL) < 0) return false;
+    }
+    if (interfaces.count() > 0)
+    {
+      m_dataLink = interfaces[0].dataLink;
+      m_snapLen  = interfaces[0].snapLen;
+    }
+    LOG_DEBUG("file=%s dataLink=%d interfaces=%d swapped=%d", qPrintable(fileName), m_dataLink, interfaces.count(), m_swapped);
+    return true;
+  }
+
+  if (!need(sizeof(PCAP_FILE_HDR)))
+  {
+    SET_ERROR(SnoopError, qformat("too small file(%s)", qPrintable(fileName)), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  PCAP_FILE_HDR fileHdr;
+  memcpy(&fileHdr, m_pos, sizeof(fileHdr));
+  switch (fileHdr.magic)
+  {
+    case PCAP_MAGIC_USEC: m_nsec = false; m_swapped = false; break;
+    case PCAP_MAGIC_NSEC: m_nsec = true;  m_swapped = false; break;
+    default:
+      if      (fileHdr.magic == qbswap<quint32>(PCAP_MAGIC_USEC)) { m_nsec = false; m_swapped = true; }
+      else if (fileHdr.magic == qbswap<quint32>(PCAP_MAGIC_NSEC)) { m_nsec = true;  m_swapped = true; }
+      else
+      {
+        SET_ERROR(SnoopError, qformat("not pcap file(%s) magic=0x%08x", qPrintable(fileName), fileHdr.magic), VERR_INVALID_PCAP_FILE);
+        return false;
+      }
+  }
+  m_snapLen  = (int)get32(fileHdr.snapLen);
+  m_dataLink = (int)(get32(fileHdr.linkType) & 0x0FFFFFFF); // upper bits are FCS info
+  m_pos     += sizeof(PCAP_FILE_HDR);
+  m_recordPos = m_pos;
+  LOG_DEBUG("file=%s dataLink=%d nsec=%d swapped=%d", qPrintable(fileName), m_dataLink, m_nsec, m_swapped);
+  return true;
+}
+
+void SnoopFileMap::close()
+{
+  if (stream == NULL && m_begin != NULL)
+  {
+    m_file.unmap(m_begin);
+  }
+  SAFE_DELETE(stream); // stops decompression thread
+  m_begin    = NULL;
+  m_file.close();
+  m_end      = NULL;
+  m_pos      = NULL;
+  m_recordPos = NULL;
+  m_dataLink = DLT_NULL;
+  m_snapLen  = 0;
+  m_ng       = false;
+  interfaces.clear();
+  m_headerBlocks.clear();
+}
+
+bool SnoopFileMap::refill(UINT64 n)
+{
+  if (stream == NULL) return false;
+  while ((UINT64)(m_end - m_pos) < n)
+  {
+    //
+    // Bytes left in current block(a record split at block end) are moved into head room of next block.
+    // The current block itself is only held, so packets already returned from it stay valid.
+    //
+    int left = (int)(m_end - m_pos);
+    if (left > stream->headRoom)
+    {
+      SET_ERROR(SnoopError, qformat("record(%d) larger than head room(%d)", left, stream->headRoom), VERR_INVALID_PCAP_FILE);
+      return false;
+    }
+    SnoopFileStreamBlock* block = stream->next();
+    if (block == NULL)
+    {
+      if (stream->failed())
+        SET_ERROR(SnoopError, qformat("error in decompression(%s)", qPrintable(stream->errorMsg())), VERR_INVALID_PCAP_FILE);
+      return false;
+    }
+    BYTE* dst = block->data - left;
+    if (left > 0) memcpy(dst, m_pos, left);
+    m_begin = dst;
+    m_pos   = dst;
+    m_end   = block->data + block->len;
+  }
+  return true;
+}
+
+void SnoopFileMap::release()
+{
+  if (stream != NULL) stream->releaseHeld();
+}
+
+void SnoopFileMap::unread()
+{
+  m_pos = m_recordPos;
+}
+
+int SnoopFileMap::next(SnoopPacket* packet)
+{
+  if (m_pos == NULL)
+  {
+    SET_DEBUG_ERROR(SnoopError, "file not opened", VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  if (!m_ng) return nextRecord(packet);
+  while (true)
+  {
+    int i = nextBlock(packet);
+    if (i != 2) return i;
+  }
+}
+
+int SnoopFileMap::nextRecord(SnoopPacket* packet)
+{
+  if (!need(1)) return 0; // eof
+
+  if (!need(sizeof(PCAP_REC_HDR)))
+  {
+    LOG_WARN("truncated record header at offset %llu", (unsigned long long)offset());
+    m_pos = m_end;
+    return 0;
+  }
+  PCAP_REC_HDR recHdr;
+  memcpy(&recHdr, m_pos, sizeof(recHdr)); // record may not be aligned
+  UINT32 capLen = get32(recHdr.capLen);
+  if (!need(sizeof(PCAP_REC_HDR) + (UINT64)capLen))
+  {
+    LOG_WARN("truncated record data at offset %llu caplen=%u", (unsigned long long)offset(), capLen);
+    m_pos = m_end;
+    return 0;
+  }
+  if (capLen > (UINT32)m_snapLen && capLen > MAX_CAPLEN) // corrupted record
+  {
+    SET_ERROR(SnoopError, qformat("invalid caplen(%u) at offset %llu", capLen, (unsigned long long)offset()), VERR_INVALID_PCAP_FILE);
+    m_pos = m_end;
+    return VERR_FAIL;
+  }
+
+  BYTE*  data   = m_pos + sizeof(PCAP_REC_HDR);
+  UINT32 tsFrac = get32(recHdr.tsFrac);
+  PKT_HDR* pktHdr = packet->pktHdr;
+  pktHdr->ts.tv_sec  = get32(recHdr.tsSec);
+  pktHdr->ts.tv_usec = m_nsec ? tsFrac / 1000 : tsFrac;
+  pktHdr->caplen     = capLen;
+  pktHdr->len        = get32(recHdr.len);
+  packet->pktData    = data;
+  packet->tsNsec     = m_nsec ? tsFrac : tsFrac * 1000;
+  packet->linkType   = m_dataLink;
+  packet->interfaceId = 0;
+
+  m_recordPos = m_pos;
+  m_pos = data + capLen;
+  return 1;
+}
+
+int SnoopFileMap::nextBlock(SnoopPacket* packet)
+{
+  if (!need(1)) return 0; // eof
+  if (!need(12))
+  {
+    LOG_WARN("truncated block header at offset %llu", (unsigned long long)offset());
+    m_pos = m_end;
+    return 0;
+  }
+
+  //
+  // Section Header Block type is palindromic, and its byte order magic sets byte order of the section.
+  //
+  UINT32 type;
+  memcpy(&type, m_pos, 4);
+  if (type == PCAPNG_SHB)
+  {
+    UINT32 magic;
+    memcpy(&magic, m_pos + 8, 4);
+    if      (magic == PCAPNG_BYTE_ORDER_MAGIC)                  m_swapped = false;
+    else if (magic == qbswap<quint32>(PCAPNG_BYTE_ORDER_MAGIC)) m_swapped = true;
+    else
+    {
+      SET_ERROR(SnoopError, qformat("invalid byte order magic(0x%08x) at offset %llu", magic, (unsigned long long)offset()), VERR_INVALID_PCAP_FILE);
+      m_pos = m_end;
+      return VERR_FAIL;
+    }
+    interfaces.clear();
+  }
+  type = get32(type);
+  UINT32 blockLen = get32(m_pos + 4);
+  if (blockLen < 12 || blockLen % 4 != 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid block length(%u) at offset %llu", blockLen, (unsigned long long)offset()), VERR_INVALID_PCAP_FILE);
+    m_pos = m_end;
+    return VERR_FAIL;
+  }
+  if (!need(blockLen))
+  {
+    LOG_WARN("truncated block at offset %llu length=%u", (unsigned long long)offset(), blockLen);
+    m_pos = m_end;
+    return 0;
+  }
+  BYTE*  block   = m_pos;
+  BYTE*  body    = block + 8;
+  UINT32 bodyLen = blockLen - 12;
+  m_pos += blockLen;
+
+  if (stream == NULL && (type == PCAPNG_SHB || type == PCAPNG_IDB))
+  {
+    UINT64 blockOffset = (UINT64)(block - m_begin);
+    if (m_headerBlocks.isEmpty() || m_headerBlocks.last() < blockOffset) m_headerBlocks.push_back(blockOffset);
+  }
+
+  switch (type)
+  {
+    case PCAPNG_IDB:
+      if (!addInterface(body, bodyLen)) return VERR_FAIL;
+      return 2;
+    case PCAPNG_EPB:
+      if (bodyLen < 20) break;
+      m_recordPos = block;
+      return fillBlock(packet, get32(body), get32(body + 4), get32(body + 8), get32(body + 12), get32(body + 16), body + 20);
+    case PCAPNG_PB:
+      if (bodyLen < 20) break;
+      m_recordPos = block;
+      return fillBlock(packet, get16(body), get32(body + 4), get32(body + 8), get32(body + 12), get32(body + 16), body + 20);
+    case PCAPNG_SPB:
+    {
+      if (bodyLen < 4) break;
+      UINT32 len    = get32(body);
+      UINT32 capLen = qMin(len, bodyLen - 4);
+      if (interfaces.count() > 0 && interfaces[0].snapLen > 0) capLen = qMin(capLen, (UINT32)interfaces[0].snapLen);
+      m_recordPos = block;
+      return fillBlock(packet, 0, 0, 0, capLen, len, body + 4); // no timestamp
+    }
+    default:
+      return 2; // SHB, NRB, ISB, DSB, custom, ...
+  }
+  SET_ERROR(SnoopError, qformat("too short block(type=%u length=%u) at offset %llu", type, blockLen, (unsigned long long)(block - m_begin)), VERR_INVALID_PCAP_FILE);
+  m_pos = m_end;
+  return VERR_FAIL;
+}
+
+bool SnoopFileMap::addInterface(BYTE* body, UINT32 bodyLen)
+{
+  if (bodyLen < 8)
+  {
+    SET_ERROR(SnoopError, qformat("too short interface description block(%u)", bodyLen), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  SnoopFileMapInterface intf;
+  intf.dataLink = (int)get16(body);
+  intf.snapLen  = (int)get32(body + 4);
+  intf.tsUnits  = 1000000; // default resolution is usec
+  intf.tsOffset = 0;
+
+  BYTE* opt = body + 8;
+  BYTE* end = body + bodyLen;
+  while (opt + 4 <= end)
+  {
+    UINT16 code = get16(opt);
+    UINT16 len  = get16(opt + 2);
+    BYTE*  val  = opt + 4;
+    if (code == PCAPNG_OPT_ENDOFOPT || val + len > end) break;
+    if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1)
+    {
+      UINT8 resol = *val;
+      UINT8 exp   = resol & 0x7F;
+      if (resol & 0x80)
+      {
+        if (exp < 64) intf.tsUnits = (UINT64)1 << exp;
+      } else
+      {
+        if (exp <= 19) { intf.tsUnits = 1; for (int i = 0; i < exp; i++) intf.tsUnits *= 10; }
+      }
+    } else
+    if (code == PCAPNG_OPT_IF_TSOFFSET && len >= 8)
+    {
+      intf.tsOffset = (INT64)get64(val);
+    }
+    opt = val + ((len + 3) & ~3);
+  }
+  interfaces.push_back(intf);
+  return true;
+}
+
+int SnoopFileMap::fillBlock(SnoopPacket* packet, UINT32 ifId, UINT32 tsHigh, UINT32 tsLow, UINT32 capLen, UINT32 len, BYTE* data)
+{
+  if (ifId >= (UINT32)interfaces.count())
+  {
+    SET_ERROR(SnoopError, qformat("unknown interface id(%u) at offset %llu", ifId, (unsigned long long)recordOffset()), VERR_INVALID_PCAP_FILE);
+    m_pos = m_end;
+    return VERR_FAIL;
+  }
+  if (data + capLen > m_pos)
+  {
+    SET_ERROR(SnoopError, qformat("invalid caplen(%u) at offset %llu", capLen, (unsigned long long)recordOffset()), VERR_INVALID_PCAP_FILE);
+    m_pos = m_end;
+    return VERR_FAIL;
+  }
+  SnoopFileMapInterface& intf = interfaces[(int)ifId];
+
+  UINT64 ts   = ((UINT64)tsHigh << 32) | (UINT64)tsLow;
+  UINT64 frac = ts % intf.tsUnits;
+  UINT32 nsec;
+  if (intf.tsUnits <= 1000000000)
+    nsec = (UINT32)(frac * 1000000000 / intf.tsUnits);
+  else
+    nsec = (UINT32)(frac / (intf.tsUnits / 1000000000));
+
+  PKT_HDR* pktHdr = packet->pktHdr;
+  pktHdr->ts.tv_sec  = (long)((INT64)(ts / intf.tsUnits) + intf.tsOffset);
+  pktHdr->ts.tv_usec = nsec / 1000;
+  pktHdr->caplen     = capLen;
+  pktHdr->len        = len;
+  packet->pktData     = data;
+  packet->tsNsec      = nsec;
+  packet->linkType    = intf.dataLink;
+  packet->interfaceId = (int)ifId;
+  return 1;
+}
+
+bool SnoopFileMap::seek(UINT64 offset, const QVector<UINT64>* headerBlocks)
+{
+  if (stream != NULL)
+  {
+    SET_ERROR(SnoopError, "seek not supported on compressed file", VERR_NOT_SUPPORTED);
+    return false;
+  }
+  UINT64 first = m_ng ? 0 : sizeof(PCAP_FILE_HDR);
+  if (m_begin == NULL || offset < first || offset > size())
+  {
+    SET_ERROR(SnoopError, qformat("invalid offset(%llu)", (unsigned long long)offset), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  m_pos = m_begin;
+  if (!m_ng)
+  {
+    m_pos += offset;
+    return true;
+  }
+
+  //
+  // Byte order and interface table come from SHB and IDB blocks before offset.
+  // With their offsets(index) only those blocks are replayed, otherwise blocks are hopped from the start.
+  //
+  interfaces.clear();
+  if (headerBlocks != NULL)
+  {
+    for (int i = 0; i < headerBlocks->count() && headerBlocks->at(i) < offset; i++)
+      if (!replayHeader(headerBlocks->at(i))) return false;
+    m_pos = m_begin + offset;
+    return true;
+  }
+
+  BYTE* target = m_begin + offset;
+  while (m_pos < target)
+  {
+    if (target - m_pos < 12)
+    {
+      SET_ERROR(SnoopError, qformat("offset(%llu) is not on block boundary", (unsigned long long)offset), VERR_INVALID_PCAP_FILE);
+      return false;
+    }
+    UINT32 type;
+    memcpy(&type, m_pos, 4);
+    if (type == PCAPNG_SHB)
+    {
+      UINT32 magic;
+      memcpy(&magic, m_pos + 8, 4);
+      m_swapped = magic != PCAPNG_BYTE_ORDER_MAGIC;
+      interfaces.clear();
+    }
+    type = get32(type);
+    UINT32 blockLen = get32(m_pos + 4);
+    if (blockLen < 12 || blockLen % 4 != 0 || (UINT64)(target - m_pos) < blockLen)
+    {
+      SET_ERROR(SnoopError, qformat("invalid block length(%u) at offset %llu", blockLen, (unsigned long long)(m_pos - m_begin)), VERR_INVALID_PCAP_FILE);
+      return false;
+    }
+    if (type == PCAPNG_IDB && !addInterface(m_pos + 8, blockLen - 12)) return false;
+    m_pos += blockLen;
+  }
+  return true;
+}
+
+bool SnoopFileMap::replayHeader(UINT64 offset)
+{
+  BYTE* block = m_begin + offset;
+  if (offset + 12 > size())
+  {
+    SET_ERROR(SnoopError, qformat("invalid header block offset(%llu)", (unsigned long long)offset), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  UINT32 type;
+  memcpy(&type, block, 4);
+  if (type == PCAPNG_SHB)
+  {
+    UINT32 magic;
+    memcpy(&magic, block + 8, 4);
+    m_swapped = magic != PCAPNG_BYTE_ORDER_MAGIC;
+    interfaces.clear();
+    return true;
+  }
+  UINT32 blockLen = get32(block + 4);
+  if (get32(type) != PCAPNG_IDB || blockLen < 12 || offset + blockLen > size())
+  {
+    SET_ERROR(SnoopError, qformat("no header block at offset %llu", (unsigned long long)offset), VERR_INVALID_PCAP_FILE);
+    return false;
+  }
+  return addInterface(block + 8, blockLen - 12);
+}
+
+#ifdef GTEST
+#include <gtest/gtest.h>
+#include <QDir>
+
+class SnoopFileMapTestFile
+{
+public:
+  SnoopFileMapTestFile(bool swapped = false) : swapped(swapped) {}
+
+public:
+  QByteArray data;
+  bool       swapped;
+
+public:
+  void put16(QByteArray& b, UINT16 v) { if (swapped) v = qbswap<quint16>(v); b.append((const char*)&v, 2); }
+  void put32(QByteArray& b, UINT32 v) { if (swapped) v = qbswap<quint32>(v); b.append((const char*)&v, 4); }
+
+  UINT64 block(UINT32 type, QByteArray body)
+  {
+    UINT64 offset = (UINT64)data.size();
+    while (body.size() % 4 != 0) body.append('\0');
+    put32(data, type);
+    put32(data, 12 + body.size());
+    data.append(body);
+    put32(data, 12 + body.size());
+    return offset;
+  }
+
+  UINT64 shb()
+  {
+    QByteArray b;
+    put32(b, PCAPNG_BYTE_ORDER_MAGIC);
+    put16(b, 1); put16(b, 0);
+    put32(b, 0xFFFFFFFF); put32(b, 0xFFFFFFFF); // section length unknown
+    return block(PCAPNG_SHB, b);
+  }
+
+  UINT64 idb(UINT16 dataLink, UINT32 snapLen, int tsResol = -1)
+  {
+    QByteArray b;
+    put16(b, dataLink); put16(b, 0);
+    put32(b, snapLen);
+    if (tsResol >= 0)
+    {
+      put16(b, PCAPNG_OPT_IF_TSRESOL); put16(b, 1);
+      b.append((char)tsResol); b.append(QByteArray(3, '\0'));
+      put16(b, PCAPNG_OPT_ENDOFOPT); put16(b, 0);
+    }
+    return block(PCAPNG_IDB, b);
+  }
+
+  UINT64 epb(UINT32 ifId, UINT64 ts, QByteArray pkt)
+  {
+    QByteArray b;
+    put32(b, ifId);
+    put32(b, (UINT32)(ts >> 32)); put32(b, (UINT32)ts);
+    put32(b, pkt.size()); put32(b, pkt.size());
+    b.append(pkt);
+    return block(PCAPNG_EPB, b);
+  }
+
+  QString save()
+  {
+    QString fileName = QDir::tempPath() + "/snoopfilemap_test.pcapng";
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    file.write(data);
+    return fileName;
+  }
+};
+
+static void testFileMapNext(bool swapped)
+{
+  SnoopFileMapTestFile f(swapped);
+  f.shb();
+  f.idb(DLT_EN10MB, 65535);
+  f.idb(DLT_RAW, 1500, 9); // nsec
+  f.epb(0, 1500000000ULL * 1000000 + 123456, "abcd");
+  f.epb(1, 1500000000ULL * 1000000000 + 123456789, "efghi");
+
+  SnoopFileMap map;
+  ASSERT_TRUE( map.open(f.save()) );
+  EXPECT_TRUE( map.ng() );
+  EXPECT_EQ( swapped, map.swapped() );
+  EXPECT_EQ( DLT_EN10MB, map.dataLink() );
+  EXPECT_EQ( 65535, map.snapLen() );
+
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+  packet.pktHdr = &pktHdr;
+
+  ASSERT_EQ( 1, map.next(&packet) );
+  EXPECT_EQ( 4u, pktHdr.caplen );
+  EXPECT_EQ( 1500000000, pktHdr.ts.tv_sec );
+  EXPECT_EQ( 123456, pktHdr.ts.tv_usec );
+  EXPECT_EQ( 123456000u, packet.tsNsec );
+  EXPECT_EQ( DLT_EN10MB, packet.linkType );
+  EXPECT_EQ( 0, packet.interfaceId );
+  EXPECT_EQ( 0, memcmp(packet.pktData, "abcd", 4) );
+
+  ASSERT_EQ( 1, map.next(&packet) );
+  EXPECT_EQ( 5u, pktHdr.caplen );
+  EXPECT_EQ( 1500000000, pktHdr.ts.tv_sec );
+  EXPECT_EQ( 123456, pktHdr.ts.tv_usec );
+  EXPECT_EQ( 123456789u, packet.tsNsec );
+  EXPECT_EQ( DLT_RAW, packet.linkType );
+  EXPECT_EQ( 1, packet.interfaceId );
+  EXPECT_EQ( 0, memcmp(packet.pktData, "efghi", 5) );
+
+  EXPECT_EQ( 0, map.next(&packet) );
+}
+
+TEST( SnoopFileMap, pcapngNext )
+{
+  testFileMapNext(false);
+}
+
+TEST( SnoopFileMap, pcapngSwapped )
+{
+  testFileMapNext(true);
+}
+
+TEST( SnoopFileMap, pcapngSection )
+{
+  //
+  // New section starts with an empty interface table.
+  //
+  SnoopFileMapTestFile f;
+  f.shb();
+  f.idb(DLT_EN10MB, 65535);
+  f.epb(0, 0, "a");
+  f.shb();
+  f.idb(DLT_RAW, 65535);
+  f.epb(0, 0, "b");
+  f.epb(1, 0, "c");
+
+  SnoopFileMap map;
+  ASSERT_TRUE( map.open(f.save()) );
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+  packet.pktHdr = &pktHdr;
+  ASSERT_EQ( 1, map.next(&packet) );
+  EXPECT_EQ( DLT_EN10MB, packet.linkType );
+  ASSERT_EQ( 1, map.next(&packet) );
+  EXPECT_EQ( DLT_RAW, packet.linkType );
+  EXPECT_EQ( VERR_FAIL, map.next(&packet) ); // interface 1 is of previous section
+}
+
+TEST( SnoopFileMap, pcapngSeek )
+{
+  SnoopFileMapTestFile f;
+  f.shb();
+  f.idb(DLT_EN10MB, 65535);
+  UINT64 first  = f.epb(0, 1000000, "a");
+  f.idb(DLT_RAW, 65535, 9);
+  UINT64 second = f.epb(1, 2000000000, "b");
+
+  SnoopFileMap map;
+  ASSERT_TRUE( map.open(f.save()) );
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+  packet.pktHdr = &pktHdr;
+  while (map.next(&packet) == 1);
+  QVector<UINT64> headerBlocks = map.headerBlocks();
+  ASSERT_EQ( 3, headerBlocks.count() );
+  EXPECT_EQ( 0u, headerBlocks[0] );
+  EXPECT_LT( headerBlocks[1], first );
+  EXPECT_LT( headerBlocks[2], second );
+
+  //
+  // With and without header block offsets, seek gives the same interface table.
+  //
+  for (int i = 0; i < 2; i++)
+  {
+    const QVector<UINT64>* blocks = i == 0 ? &headerBlocks : NULL;
+    ASSERT_TRUE( map.seek(second, blocks) );
+    ASSERT_EQ( 1, map.next(&packet) );
+    EXPECT_EQ( DLT_RAW, packet.linkType );
+    EXPECT_EQ( 2, pktHdr.ts.tv_sec );
+    EXPECT_EQ( second, map.recordOffset() );
+
+    ASSERT_TRUE( map.seek(first, blocks) );
+    ASSERT_EQ( 1, map.next(&packet) );
+    EXPECT_EQ( DLT_EN10MB, packet.linkType );
+    EXPECT_EQ( 1, pktHdr.ts.tv_sec );
+    ASSERT_EQ( 1, map.next(&packet) );
+    EXPECT_EQ( DLT_RAW, packet.linkType );
+    EXPECT_EQ( 0, map.next(&packet) );
+  }
+  EXPECT_FALSE( map.seek(map.size() + 1) );
+}
+
+TEST( SnoopFileMap, pcapngInvalid )
+{
+  PKT_HDR     pktHdr;
+  SnoopPacket packet;
+  packet.pktHdr = &pktHdr;
+
+  //
+  // Block length not multiple of 4 is an error.
+  //
+  {
+    SnoopFileMapTestFile f;
+    f.shb();
+    f.idb(DLT_EN10MB, 65535);
+    f.put32(f.data, PCAPNG_EPB);
+    f.put32(f.data, 13);
+    f.data.append(QByteArray(8, '\0'));
+    SnoopFileMap map;
+    ASSERT_TRUE( map.open(f.save()) );
+    EXPECT_EQ( VERR_FAIL, map.next(&packet) );
+  }
+
+  //
+  // Truncated last block ends the file.
+  //
+  {
+    SnoopFileMapTestFile f;
+    f.shb();
+    f.idb(DLT_EN10MB, 65535);
+    f.epb(0, 0, "abcd");
+    f.epb(0, 0, "efgh");
+    f.data.chop(8);
+    SnoopFileMap map;
+    ASSERT_TRUE( map.open(f.save()) );
+    EXPECT_EQ( 1, map.next(&packet) );
+    EXPECT_EQ( 0, map.next(&packet) );
+  }
+
+  //
+  // Packet of undefined interface is an error.
+  //
+  {
+    SnoopFileMapTestFile f;
+    f.shb();
+    f.epb(0, 0, "abcd");
+    SnoopFileMap map;
+    ASSERT_TRUE( map.open(f.save()) );
+    EXPECT_EQ( VERR_FAIL, map.next(&packet) );
+  }
+}
+#endif // GTEST
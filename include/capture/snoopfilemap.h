@@ -0,0 +1,116 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FILE_MAP_H__
+#define __SNOOP_FILE_MAP_H__
+
+#include <SnoopPacket>
+#include <SnoopFileStream>
+#include <QFile>
+#include <QtEndian>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+// SnoopFileMapInterface
+// ----------------------------------------------------------------------------
+/// pcapng Interface Description Block
+class SnoopFileMapInterface
+{
+public:
+  int    dataLink;
+  int    snapLen;
+  UINT64 tsUnits;  // timestamp units per second(if_tsresol)
+  INT64  tsOffset; // seconds added to timestamp(if_tsoffset)
+};
+
+// ----------------------------------------------------------------------------
+// SnoopFileMap
+// ----------------------------------------------------------------------------
+/// Memory mapped pcap or pcapng file reader. Packet data points into the mapping(zero copy).
+/// gzip or zstd compressed file is read through SnoopFileStream blocks instead of mapping.
+class SnoopFileMap
+{
+public:
+  SnoopFileMap();
+  virtual ~SnoopFileMap();
+
+public:
+  VError error;
+
+public:
+  bool open(QString fileName);
+  void close();
+
+  //
+  // Caller sets packet->pktHdr to its own storage. pktData points into the mapping and is valid until close.
+  // linkType and interfaceId are set for each packet, as pcapng interfaces may differ.
+  // Returns 1 for a packet, 0 on end of file and VERR_FAIL on error.
+  //
+  int next(SnoopPacket* packet);
+
+  //
+  // Compressed file only : blocks holding packets returned so far are given back to decompressor.
+  // Call before next when those packets are no longer used.
+  //
+  void release();
+  void unread(); // next returns the last packet again
+
+public:
+  int    dataLink() { return m_dataLink; } // pcapng : link type of first interface
+  bool   ng()       { return m_ng;       }
+  int    snapLen()  { return m_snapLen;  }
+  bool   nsec()     { return m_nsec;     }
+  bool   swapped()  { return m_swapped;  }
+  bool   compressed() { return stream != NULL; }
+
+  //
+  // Mapped file only
+  //
+  UINT64 size()     { return (UINT64)(m_end - m_begin); }
+  UINT64 offset()   { return (UINT64)(m_pos - m_begin); }
+  UINT64 recordOffset() { return (UINT64)(m_recordPos - m_begin); } // record of last packet
+  bool   seek(UINT64 offset, const QVector<UINT64>* headerBlocks = NULL); // offset of a record(pcapng : of a block, interfaces before it are replayed)
+  const QVector<UINT64>& headerBlocks() { return m_headerBlocks; } // pcapng : offsets of SHB and IDB blocks read so far
+
+protected:
+  QFile  m_file;
+  SnoopFileStream* stream;
+  BYTE*  m_begin;   // mapping or current stream block
+  BYTE*  m_end;
+  BYTE*  m_pos;
+  BYTE*  m_recordPos;
+  int    m_dataLink;
+  int    m_snapLen;
+  bool   m_nsec;    // timestamp fraction is nanosecond
+  bool   m_swapped; // file(pcapng : section) byte order differs from host
+  bool   m_ng;      // pcapng
+
+protected:
+  QVector<SnoopFileMapInterface> interfaces; // of current pcapng section
+  QVector<UINT64>                m_headerBlocks;
+
+protected:
+  bool   need(UINT64 n) { return (UINT64)(m_end - m_pos) >= n || refill(n); }
+  bool   refill(UINT64 n);
+  bool   readHeader(QString fileName);
+  int    nextRecord(SnoopPacket* packet);
+  int    nextBlock(SnoopPacket* packet); // 2 : block without packet
+  bool   addInterface(BYTE* body, UINT32 bodyLen);
+  bool   replayHeader(UINT64 offset); // SHB or IDB block at offset
+  int    fillBlock(SnoopPacket* packet, UINT32 ifId, UINT32 tsHigh, UINT32 tsLow, UINT32 capLen, UINT32 len, BYTE* data);
+
+protected:
+  UINT16 get16(BYTE* p) { UINT16 v; memcpy(&v, p, 2); return m_swapped ? qbswap<quint16>(v) : v; }
+  UINT32 get32(BYTE* p) { UINT32 v; memcpy(&v, p, 4); return m_swapped ? qbswap<quint32>(v) : v; }
+  UINT64 get64(BYTE* p) { UINT64 v; memcpy(&v, p, 8); return m_swapped ? qbswap<quint64>(v) : v; }
+  UINT32 get32(UINT32 value) { return m_swapped ? qbswap<quint32>(value) : value; }
+};
+
+#endif // __SNOOP_FILE_MAP_H__
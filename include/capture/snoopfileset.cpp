@@ -0,0 +1,285 @@
+#include <SnoopFileSet>
+
+#include <VFile> // for VERR_FILENAME_NOT_SPECIFIED
+#include <QDir>
+#include <VDebugNew>
+
+REGISTER_METACLASS(SnoopFileSet, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopFileSet
+// ----------------------------------------------------------------------------
+SnoopFileSet::SnoopFileSet(void* owner) : SnoopCapture(owner)
+{
+  fileNames    = "";
+  filter       = "";
+  maxOpenFiles = 256;
+  m_dataLink   = DLT_NULL;
+  m_openCount  = 0;
+  current      = NULL;
+}
+
+SnoopFileSet::~SnoopFileSet()
+{
+  close();
+}
+
+bool SnoopFileSet::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (fileNames == "")
+  {
+    SET_ERROR(VFileError, "file names not specified", VERR_FILENAME_NOT_SPECIFIED);
+    return false;
+  }
+  QStringList list = expand();
+  if (list.count() == 0)
+  {
+    SET_ERROR(VFileError, qformat("no file matches(%s)", qPrintable(fileNames)), VERR_FILE_NOT_EXIST);
+    return false;
+  }
+
+  int index = 0;
+  foreach (QString fileName, list)
+  {
+    SnoopFileSetItem* item = new SnoopFileSetItem;
+    item->index    = index++;
+    item->fileName = fileName;
+    item->pcap     = NULL;
+    item->dataLink = DLT_NULL;
+    item->pktHdr   = NULL;
+    item->pktData  = NULL;
+    item->ts       = 0;
+    items.push_back(item);
+    //
+    // Only first timestamp is needed to place the file, so the handle is given back at once.
+    //
+    if (!openItem(item))
+    {
+      closeItem(item);
+      return false;
+    }
+    bool res = advance(item);
+    closeItem(item);
+    if (res) heap.push(item);
+  }
+  m_dataLink = items.first()->dataLink;
+  LOG_DEBUG("%d files merged(%s)", items.count(), qPrintable(fileNames));
+
+  return SnoopCapture::doOpen();
+}
+
+bool SnoopFileSet::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  //
+  // pcap_next_ex after pcap_close is not safe(see SnoopPcap::doClose), so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+
+  while (!heap.empty()) heap.pop();
+  current = NULL;
+  foreach (SnoopFileSetItem* item, items)
+  {
+    closeItem(item);
+    delete item;
+  }
+  items.clear();
+  m_dataLink = DLT_NULL;
+
+  return SnoopCapture::doClose();
+}
+
+int SnoopFileSet::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  //
+  // Packet returned last time lives in its file's pcap buffer, so the file is advanced only now.
+  //
+  if (current != NULL)
+  {
+    if (advance(current)) heap.push(current); else closeItem(current);
+    current = NULL;
+  }
+  while (true)
+  {
+    if (heap.empty())
+    {
+      SET_DEBUG_ERROR(SnoopError, "end of all files", VERR_IN_PCAP_NEXT_EX);
+      return VERR_FAIL;
+    }
+    SnoopFileSetItem* item = heap.top();
+    heap.pop();
+    if (item->pcap != NULL)
+    {
+      current = item;
+      break;
+    }
+
+    //
+    // File reaches heap front for the first time. It is opened again and its first packet is read once more.
+    //
+    if (m_openCount >= maxOpenFiles)
+    {
+      SET_ERROR(SnoopError, qformat("too many files overlap in time(maxOpenFiles=%d) file=%s", maxOpenFiles, qPrintable(item->fileName)), VERR_TOO_MANY_OPEN_FILES);
+      heap.push(item);
+      return VERR_FAIL;
+    }
+    if (!openItem(item))
+    {
+      closeItem(item);
+      return VERR_FAIL;
+    }
+    if (advance(item))
+    {
+      current = item;
+      break;
+    }
+    closeItem(item); // file changed since doOpen, others go on
+  }
+
+  packet->clear();
+  packet->pktHdr   = current->pktHdr;
+  packet->pktData  = current->pktData;
+  packet->linkType = current->dataLink;
+  if (autoParse) parse(packet);
+  return packet->pktHdr->caplen;
+}
+
+QStringList SnoopFileSet::expand()
+{
+  QStringList res;
+  foreach (QString s, fileNames.split(';', QString::SkipEmptyParts))
+  {
+    s = s.trimmed();
+    if (s == "") continue;
+    QFileInfo fi(s);
+    QFileInfoList entries;
+    if (fi.isDir())
+    {
+      entries = QDir(s).entryInfoList(QStringList() << "*.pcap" << "*.pcapng" << "*.cap", QDir::Files, QDir::Name);
+    } else
+    if (s.contains('*') || s.contains('?') || s.contains('['))
+    {
+      entries = QDir(fi.path()).entryInfoList(QStringList() << fi.fileName(), QDir::Files, QDir::Name);
+    } else
+    {
+      res.push_back(s);
+      continue;
+    }
+    foreach (QFileInfo entry, entries)
+      res.push_back(entry.filePath());
+  }
+  return res;
+}
+
+bool SnoopFileSet::openItem(SnoopFileSetItem* item)
+{
+  char errBuf[PCAP_ERRBUF_SIZE];
+  item->pcap = pcap_open_offline(qPrintable(item->fileName), errBuf);
+  if (item->pcap == NULL)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_open_offline(%s) %s", qPrintable(item->fileName), errBuf), VERR_IN_PCAP_OPEN);
+    return false;
+  }
+  m_openCount++;
+  item->dataLink = pcap_datalink(item->pcap);
+
+  if (filter != "")
+  {
+    bpf_program code;
+    if (pcap_compile(item->pcap, &code, qPrintable(filter), 1, 0xFFFFFFFF) < 0)
+    {
+      SET_ERROR(SnoopError, qformat("error in pcap_compile(%s)", pcap_geterr(item->pcap)), VERR_IN_PCAP_COMPILE);
+      return false;
+    }
+    int res = pcap_setfilter(item->pcap, &code);
+    pcap_freecode(&code);
+    if (res < 0)
+    {
+      SET_ERROR(SnoopError, qformat("error in pcap_setfilter(%s)", pcap_geterr(item->pcap)), VERR_IN_PCAP_SETFILTER);
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnoopFileSet::closeItem(SnoopFileSetItem* item)
+{
+  if (item->pcap == NULL) return;
+  pcap_close(item->pcap);
+  item->pcap    = NULL;
+  item->pktHdr  = NULL;
+  item->pktData = NULL;
+  m_openCount--;
+}
+
+bool SnoopFileSet::advance(SnoopFileSetItem* item)
+{
+  int i = pcap_next_ex(item->pcap, (pcap_pkthdr**)&item->pktHdr, (const u_char**)&item->pktData);
+  if (i == 1)
+  {
+    item->ts = (INT64)item->pktHdr->ts.tv_sec * 1000000 + item->pktHdr->ts.tv_usec;
+    return true;
+  }
+  if (i == -1)
+    LOG_ERROR("pcap_next_ex return -1(%s) file=%s", pcap_geterr(item->pcap), qPrintable(item->fileName));
+  return false; // this file is done, others go on
+}
+
+void SnoopFileSet::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  fileNames    = xml.getStr("fileNames", fileNames);
+  filter       = xml.getStr("filter", filter);
+  maxOpenFiles = xml.getInt("maxOpenFiles", maxOpenFiles);
+}
+
+void SnoopFileSet::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setStr("fileNames", fileNames);
+  xml.setStr("filter", filter);
+  xml.setInt("maxOpenFiles", maxOpenFiles);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopFileSet::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leFileNames",    "File Names",     fileNames);
+  VOptionable::addLineEdit(layout, "leFilter",       "Filter",         filter);
+  VOptionable::addLineEdit(layout, "leMaxOpenFiles", "Max Open Files", QString::number(maxOpenFiles));
+}
+
+void SnoopFileSet::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  fileNames    = dialog->findChild<QLineEdit*>("leFileNames")->text();
+  filter       = dialog->findChild<QLineEdit*>("leFilter")->text();
+  maxOpenFiles = dialog->findChild<QLineEdit*>("leMaxOpenFiles")->text().toInt();
+}
+#endif // QT_GUI_LIB
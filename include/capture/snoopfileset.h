@@ -0,0 +1,104 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FILE_SET_H__
+#define __SNOOP_FILE_SET_H__
+
+#include <SnoopCapture>
+#include <queue>
+
+// ----------------------------------------------------------------------------
+// SnoopFileSetItem
+// ----------------------------------------------------------------------------
+class SnoopFileSetItem
+{
+public:
+  int      index;    // order in file list, breaks timestamp tie
+  QString  fileName;
+  pcap_t*  pcap;     // NULL until the file reaches heap front, and again when it is done
+  int      dataLink;
+
+public:
+  //
+  // Read ahead packet. Data stays in libpcap buffer until next pcap_next_ex on this file.
+  //
+  PKT_HDR* pktHdr;
+  BYTE*    pktData;
+  INT64    ts;       // usec, first packet time only while pcap is NULL
+};
+
+class SnoopFileSetItemGreater
+{
+public:
+  bool operator()(const SnoopFileSetItem* a, const SnoopFileSetItem* b) const
+  {
+    if (a->ts != b->ts) return a->ts > b->ts;
+    return a->index > b->index;
+  }
+};
+
+// ----------------------------------------------------------------------------
+// SnoopFileSet
+// ----------------------------------------------------------------------------
+/// Several pcap files merged into one timeline by timestamp.
+/// doOpen only reads the first timestamp of each file and closes it again. A file is opened when it reaches
+/// heap front and closed when it is done, so only files overlapping in time hold a handle.
+class SnoopFileSet : public SnoopCapture
+{
+public:
+  SnoopFileSet(void* owner = NULL);
+  virtual ~SnoopFileSet();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::OutOfPath; }
+  virtual int              dataLink()    { return m_dataLink; }
+
+  //
+  // Properties
+  //
+public:
+  QString fileNames;    // directory, glob or file, separated by ';'
+  QString filter;
+  int     maxOpenFiles; // files overlapping in time beyond this fail read()
+
+protected:
+  int                      m_dataLink;
+  int                      m_openCount;
+  QList<SnoopFileSetItem*> items;
+  SnoopFileSetItem*        current; // item returned by last read, advanced on next read
+  std::priority_queue<SnoopFileSetItem*, std::vector<SnoopFileSetItem*>, SnoopFileSetItemGreater> heap;
+
+public:
+  QStringList expand();
+
+protected:
+  bool openItem(SnoopFileSetItem* item);
+  void closeItem(SnoopFileSetItem* item);
+  bool advance(SnoopFileSetItem* item);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // __SNOOP_FILE_SET_H__
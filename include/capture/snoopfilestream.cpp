@@ -0,0 +1,313 @@
+#include <SnoopFileStream>
+#ifdef SNOOP_ZLIB
+#include <zlib.h>
+#endif // SNOOP_ZLIB
+#ifdef SNOOP_ZSTD
+#include <zstd.h>
+#endif // SNOOP_ZSTD
+#include <VDebugNew>
+
+static const int INPUT_CHUNK_SIZE = 256 * 1024;
+
+// ----------------------------------------------------------------------------
+// SnoopFileStream
+// ----------------------------------------------------------------------------
+SnoopFileStream::SnoopFileStream()
+{
+  fileName   = "";
+  blockSize  = 4 * 1024 * 1024;
+  blockCount = 4;
+  headRoom   = 1024 * 1024;
+  m_format   = None;
+  current    = NULL;
+  m_stop     = false;
+  m_eof      = false;
+  m_failed   = false;
+  m_errorMsg = "";
+}
+
+SnoopFileStream::~SnoopFileStream()
+{
+  close();
+}
+
+SnoopFileStream::Format SnoopFileStream::detect(QString fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) return None;
+  QByteArray magic = file.read(4);
+  if (magic.size() >= 2 && (BYTE)magic[0] == 0x1F && (BYTE)magic[1] == 0x8B) return Gzip;
+  if (magic.size() == 4 && (BYTE)magic[0] == 0x28 && (BYTE)magic[1] == 0xB5 && (BYTE)magic[2] == 0x2F && (BYTE)magic[3] == 0xFD) return Zstd;
+  return None;
+}
+
+bool SnoopFileStream::open()
+{
+  m_format = detect(fileName);
+  switch (m_format)
+  {
+    case None:
+      SET_ERROR(SnoopError, qformat("not compressed file(%s)", qPrintable(fileName)), VERR_INVALID_PCAP_FILE);
+      return false;
+#ifndef SNOOP_ZLIB
+    case Gzip:
+      SET_ERROR(SnoopError, "gzip not supported(build with SNOOP_ZLIB)", VERR_NOT_SUPPORTED);
+      return false;
+#endif // SNOOP_ZLIB
+#ifndef SNOOP_ZSTD
+    case Zstd:
+      SET_ERROR(SnoopError, "zstd not supported(build with SNOOP_ZSTD)", VERR_NOT_SUPPORTED);
+      return false;
+#endif // SNOOP_ZSTD
+    default:
+      break;
+  }
+  if (blockCount < 3)
+  {
+    SET_ERROR(SnoopError, qformat("blockCount(%d) must be at least 3", blockCount), VERR_INVALID_RING_SIZE);
+    return false;
+  }
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::ReadOnly))
+  {
+    SET_ERROR(SnoopError, qformat("can not open file(%s) %s", qPrintable(fileName), qPrintable(m_file.errorString())), VERR_FILE_NOT_EXIST);
+    return false;
+  }
+
+  blocks.resize(blockCount);
+  for (int i = 0; i < blockCount; i++)
+  {
+    SnoopFileStreamBlock& block = blocks[i];
+    block.mem  = new BYTE[(size_t)headRoom + (size_t)blockSize];
+    block.data = block.mem + headRoom;
+    block.len  = 0;
+    freeBlocks.enqueue(&block);
+  }
+  current    = NULL;
+  m_stop     = false;
+  m_eof      = false;
+  m_failed   = false;
+  m_errorMsg = "";
+  return VThread::open();
+}
+
+bool SnoopFileStream::close()
+{
+  mutex.lock();
+  m_stop = true;
+  freeCond.wakeAll();
+  filledCond.wakeAll();
+  mutex.unlock();
+  bool res = VThread::close();
+
+  freeBlocks.clear();
+  filledBlocks.clear();
+  heldBlocks.clear();
+  current = NULL;
+  for (int i = 0; i < blocks.count(); i++)
+    delete[] blocks[i].mem;
+  blocks.clear();
+  m_file.close();
+  return res;
+}
+
+SnoopFileStreamBlock* SnoopFileStream::next()
+{
+  QMutexLocker locker(&mutex);
+  if (current != NULL)
+  {
+    heldBlocks.push_back(current);
+    current = NULL;
+  }
+  while (filledBlocks.isEmpty() && !m_eof && !m_stop)
+    filledCond.wait(&mutex);
+  if (filledBlocks.isEmpty()) return NULL;
+  current = filledBlocks.dequeue();
+  return current;
+}
+
+void SnoopFileStream::releaseHeld()
+{
+  QMutexLocker locker(&mutex);
+  if (heldBlocks.isEmpty()) return;
+  foreach (SnoopFileStreamBlock* block, heldBlocks)
+    freeBlocks.enqueue(block);
+  heldBlocks.clear();
+  freeCond.wakeAll();
+}
+
+SnoopFileStreamBlock* SnoopFileStream::takeFree()
+{
+  QMutexLocker locker(&mutex);
+  while (freeBlocks.isEmpty() && !m_stop)
+    freeCond.wait(&mutex);
+  if (m_stop) return NULL;
+  SnoopFileStreamBlock* block = freeBlocks.dequeue();
+  block->len = 0;
+  return block;
+}
+
+void SnoopFileStream::publish(SnoopFileStreamBlock* block)
+{
+  QMutexLocker locker(&mutex);
+  filledBlocks.enqueue(block);
+  filledCond.wakeAll();
+}
+
+void SnoopFileStream::releaseBlock(SnoopFileStreamBlock* block)
+{
+  QMutexLocker locker(&mutex);
+  freeBlocks.enqueue(block);
+}
+
+void SnoopFileStream::finish(QString errorMsg)
+{
+  QMutexLocker locker(&mutex);
+  if (errorMsg != "")
+  {
+    m_failed   = true;
+    m_errorMsg = errorMsg;
+  }
+  m_eof = true;
+  filledCond.wakeAll();
+}
+
+bool SnoopFileStream::readInput(QByteArray& in, int& inPos)
+{
+  in = m_file.read(INPUT_CHUNK_SIZE);
+  inPos = 0;
+  return in.size() > 0;
+}
+
+void SnoopFileStream::run()
+{
+  switch (m_format)
+  {
+    case Gzip: runGzip(); break;
+    case Zstd: runZstd(); break;
+    default:   finish("unknown format"); break;
+  }
+}
+
+void SnoopFileStream::runGzip()
+{
+#ifdef SNOOP_ZLIB
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) // gzip header
+  {
+    finish("error in inflateInit2");
+    return;
+  }
+  QByteArray in;
+  int        inPos = 0;
+  QString    errorMsg = "";
+  bool       eof = false;
+  bool       inputEnd = false;
+  bool       streamEnd = false; // last member ended and nothing came after it
+  while (!eof && active())
+  {
+    SnoopFileStreamBlock* block = takeFree();
+    if (block == NULL) break;
+    while (block->len < blockSize)
+    {
+      //
+      // After input runs out, inflate is called with empty input until it gives no more output.
+      //
+      if (inPos >= in.size() && !inputEnd && !readInput(in, inPos)) inputEnd = true;
+      int oldPos = inPos, oldLen = block->len;
+      z.next_in   = (Bytef*)in.data() + inPos;
+      z.avail_in  = (uInt)(in.size() - inPos);
+      z.next_out  = (Bytef*)block->data + block->len;
+      z.avail_out = (uInt)(blockSize - block->len);
+      int res = inflate(&z, Z_NO_FLUSH);
+      inPos      = in.size() - (int)z.avail_in;
+      block->len = blockSize - (int)z.avail_out;
+      if (res == Z_STREAM_END)
+      {
+        inflateReset(&z); // concatenated gzip members
+        streamEnd = true;
+      } else
+      if (res != Z_OK && res != Z_BUF_ERROR)
+      {
+        errorMsg = qformat("error in inflate(%d %s)", res, z.msg != NULL ? z.msg : "");
+        eof = true;
+        break;
+      } else
+      if (inPos != oldPos || block->len != oldLen)
+      {
+        streamEnd = false;
+      } else
+      if (inputEnd)
+      {
+        if (!streamEnd) errorMsg = "truncated compressed stream";
+        eof = true;
+        break;
+      }
+    }
+    if (block->len > 0) publish(block); else releaseBlock(block);
+  }
+  inflateEnd(&z);
+  finish(errorMsg);
+#else
+  finish("gzip not supported");
+#endif // SNOOP_ZLIB
+}
+
+void SnoopFileStream::runZstd()
+{
+#ifdef SNOOP_ZSTD
+  ZSTD_DStream* ds = ZSTD_createDStream();
+  if (ds == NULL)
+  {
+    finish("error in ZSTD_createDStream");
+    return;
+  }
+  ZSTD_initDStream(ds);
+  QByteArray in;
+  int        inPos = 0;
+  QString    errorMsg = "";
+  bool       eof = false;
+  bool       inputEnd = false;
+  size_t     lastRes = 1; // of last call that made progress(0 : frame decoded and flushed)
+  while (!eof && active())
+  {
+    SnoopFileStreamBlock* block = takeFree();
+    if (block == NULL) break;
+    while (block->len < blockSize)
+    {
+      //
+      // DStream may hold a whole decoded block after input runs out, so it is drained with empty input.
+      //
+      if (inPos >= in.size() && !inputEnd && !readInput(in, inPos)) inputEnd = true;
+      int oldPos = inPos, oldLen = block->len;
+      ZSTD_inBuffer  zin  = { in.data(), (size_t)in.size(), (size_t)inPos };
+      ZSTD_outBuffer zout = { block->data, (size_t)blockSize, (size_t)block->len };
+      size_t res = ZSTD_decompressStream(ds, &zout, &zin);
+      inPos      = (int)zin.pos;
+      block->len = (int)zout.pos;
+      if (ZSTD_isError(res))
+      {
+        errorMsg = qformat("error in ZSTD_decompressStream(%s)", ZSTD_getErrorName(res));
+        eof = true;
+        break;
+      }
+      if (inPos != oldPos || block->len != oldLen)
+      {
+        lastRes = res;
+      } else
+      if (inputEnd)
+      {
+        if (lastRes != 0) errorMsg = "truncated compressed stream";
+        eof = true;
+        break;
+      }
+    }
+    if (block->len > 0) publish(block); else releaseBlock(block);
+  }
+  ZSTD_freeDStream(ds);
+  finish(errorMsg);
+#else
+  finish("zstd not supported");
+#endif // SNOOP_ZSTD
+}
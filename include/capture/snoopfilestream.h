@@ -0,0 +1,102 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FILE_STREAM_H__
+#define __SNOOP_FILE_STREAM_H__
+
+#include <SnoopCommon>
+#include <VThread>
+#include <QFile>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+// ----------------------------------------------------------------------------
+// SnoopFileStreamBlock
+// ----------------------------------------------------------------------------
+class SnoopFileStreamBlock
+{
+public:
+  BYTE* mem;  // headRoom + blockSize
+  BYTE* data; // mem + headRoom, decompressed bytes start here
+  int   len;
+};
+
+// ----------------------------------------------------------------------------
+// SnoopFileStream
+// ----------------------------------------------------------------------------
+/// Background decompression of a gzip or zstd capture file into a ring of blocks
+class SnoopFileStream : public VThread
+{
+public:
+  typedef enum
+  {
+    None,
+    Gzip, // SNOOP_ZLIB
+    Zstd  // SNOOP_ZSTD
+  } Format;
+
+public:
+  SnoopFileStream();
+  virtual ~SnoopFileStream();
+
+public:
+  QString fileName;
+  int     blockSize;
+  int     blockCount; // at least 3 : one being read, one held by graph, one being decompressed
+  int     headRoom;   // bytes of a record split at block end which are carried into next block
+
+public:
+  static Format detect(QString fileName);
+
+public:
+  virtual bool open();
+  virtual bool close();
+
+public:
+  //
+  // Called by reader. Current block is kept until releaseHeld, so packets of the last burst stay valid.
+  // Returns NULL on end of file or error(failed() tells).
+  //
+  SnoopFileStreamBlock* next();
+  void                  releaseHeld();
+  bool                  failed()   { return m_failed;   }
+  QString               errorMsg() { return m_errorMsg; }
+
+protected:
+  virtual void run();
+
+protected:
+  Format                        m_format;
+  QFile                         m_file;
+  QVector<SnoopFileStreamBlock> blocks;
+  QQueue<SnoopFileStreamBlock*> freeBlocks;
+  QQueue<SnoopFileStreamBlock*> filledBlocks;
+  QList<SnoopFileStreamBlock*>  heldBlocks;
+  SnoopFileStreamBlock*         current;
+  QMutex                        mutex;
+  QWaitCondition                freeCond;
+  QWaitCondition                filledCond;
+  bool                          m_stop;
+  bool                          m_eof;
+  bool                          m_failed;
+  QString                       m_errorMsg;
+
+protected:
+  SnoopFileStreamBlock* takeFree();
+  void                  publish(SnoopFileStreamBlock* block);
+  void                  releaseBlock(SnoopFileStreamBlock* block);
+  void                  finish(QString errorMsg);
+  bool                  readInput(QByteArray& in, int& inPos);
+  void                  runGzip();
+  void                  runZstd();
+};
+
+#endif // __SNOOP_FILE_STREAM_H__
@@ -0,0 +1,508 @@
+#include <SnoopNfQueue>
+#include <VDebugNew>
+
+#if defined(linux) && defined(SNOOP_NFQUEUE)
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <QFile>
+#include <linux/netfilter.h>
+#include <libnetfilter_queue/libnetfilter_queue.h>
+
+REGISTER_METACLASS(SnoopNfQueue, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopNfQueue
+// ----------------------------------------------------------------------------
+SnoopNfQueue::SnoopNfQueue(void* owner) : SnoopCapture(owner)
+{
+  queueNum     = 0;
+  queueCount   = 1;
+  queueLen     = 8192;
+  rcvBufSize   = 8 * 1024 * 1024;
+  readTimeout  = snoop::DEFAULT_READTIMEOUT;
+  batchVerdict = true;
+  failOpen     = true;
+  gso          = true;
+
+  m_h       = NULL;
+  m_fd      = -1;
+  m_rawSock = -1;
+  m_rxBuf   = NULL;
+  m_rxSlots = 0;
+  m_pktData = NULL;
+  m_batch   = NULL;
+  m_packet  = NULL;
+  m_enobufs = 0;
+}
+
+SnoopNfQueue::~SnoopNfQueue()
+{
+  close();
+}
+
+bool SnoopNfQueue::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (queueCount <= 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid queue count(%d)", queueCount), VERR_FAIL);
+    return false;
+  }
+
+  m_h = nfq_open();
+  if (m_h == NULL)
+  {
+    SET_ERROR(SnoopError, qformat("error in nfq_open(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  for (int i = 0; i < queueCount; i++)
+  {
+    int num = queueNum + i;
+    nfq_q_handle* qh = nfq_create_queue(m_h, (UINT16)num, callback, this);
+    if (qh == NULL)
+    {
+      SET_ERROR(SnoopError, qformat("error in nfq_create_queue(%d)(%s)", num, strerror(errno)), VERR_IN_BIND);
+      return false;
+    }
+    m_qhs.push_back(qh);
+
+    if (nfq_set_mode(qh, NFQNL_COPY_PACKET, 0xFFFF) < 0)
+    {
+      SET_ERROR(SnoopError, qformat("error in nfq_set_mode(%d)", num), VERR_IN_SETSOCKOPT);
+      return false;
+    }
+    if (nfq_set_queue_maxlen(qh, (UINT32)queueLen) < 0)
+    {
+      LOG_WARN("nfq_set_queue_maxlen(%d, %d) return -1", num, queueLen);
+    }
+
+    //
+    // Old kernel does not know these flags, so go on without them.
+    //
+    UINT32 mask  = NFQA_CFG_F_FAIL_OPEN | NFQA_CFG_F_GSO;
+    UINT32 flags = (failOpen ? NFQA_CFG_F_FAIL_OPEN : 0) | (gso ? NFQA_CFG_F_GSO : 0);
+    if (nfq_set_queue_flags(qh, mask, flags) < 0)
+    {
+      LOG_WARN("nfq_set_queue_flags(%d, 0x%x) return -1(%s)", num, flags, strerror(errno));
+    }
+  }
+
+  m_fd = nfq_fd(m_h);
+  if (rcvBufSize > 0) nfnl_rcvbufsiz(nfq_nfnlh(m_h), (unsigned int)rcvBufSize);
+
+  m_pktData = new BYTE[MAXBUF];
+  reserveRx(1);
+  items.clear();
+  m_enobufs = 0;
+
+  if (!SnoopCapture::doOpen()) return false;
+
+  return true;
+}
+
+bool SnoopNfQueue::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  //
+  // Receive buffers are referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+  flushTx(); // packets read but not yet judged
+
+  foreach (nfq_q_handle* qh, m_qhs)
+    nfq_destroy_queue(qh);
+  m_qhs.clear();
+  if (m_h != NULL)
+  {
+    nfq_close(m_h);
+    m_h = NULL;
+  }
+  m_fd = -1;
+  if (m_rawSock != -1)
+  {
+    ::close(m_rawSock);
+    m_rawSock = -1;
+  }
+  if (m_rxBuf != NULL)
+  {
+    delete[] m_rxBuf;
+    m_rxBuf = NULL;
+  }
+  m_rxSlots = 0;
+  if (m_pktData != NULL)
+  {
+    delete[] m_pktData;
+    m_pktData = NULL;
+  }
+
+  return SnoopCapture::doClose();
+}
+
+void SnoopNfQueue::reserveRx(int slots)
+{
+  if (slots <= m_rxSlots) return;
+  if (m_rxBuf != NULL) delete[] m_rxBuf;
+  m_rxBuf   = new BYTE[(size_t)slots * RX_SLOT];
+  m_rxSlots = slots;
+}
+
+int SnoopNfQueue::callback(nfq_q_handle* qh, nfgenmsg* nfmsg, nfq_data* nfa, void* data)
+{
+  Q_UNUSED(nfmsg)
+  return ((SnoopNfQueue*)data)->onPacket(qh, nfa);
+}
+
+int SnoopNfQueue::onPacket(nfq_q_handle* qh, nfq_data* nfa)
+{
+  nfqnl_msg_packet_hdr* ph = nfq_get_msg_packet_hdr(nfa);
+  if (ph == NULL) return 0;
+  UINT32 id = ntohl(ph->packet_id);
+
+  unsigned char* payload;
+  int len = nfq_get_payload(nfa, &payload);
+  bool full = m_batch != NULL ? m_batch->full() : m_packet == NULL; // read() takes one packet
+  if (len < 0 || len > MAXBUF - (int)sizeof(ETH_HDR) || full)
+  {
+    verdict(qh, id, NF_ACCEPT, false);
+    return 0;
+  }
+
+  SnoopPacket* packet;
+  BYTE*        buf;
+  if (m_batch != NULL)
+  {
+    packet = m_batch->next();
+    buf    = m_batch->buffer(m_batch->count - 1);
+  } else
+  {
+    packet = m_packet;
+    buf    = m_pktData;
+    packet->pktHdr = &m_pktHdr;
+    m_packet = NULL;
+  }
+
+  //
+  // Netfilter gives layer 3 packet, so a clean ethernet header is put in front like SnoopWinDivert.
+  //
+  ETH_HDR* ethHdr     = (ETH_HDR*)buf;
+  ethHdr->ether_dhost = Mac::cleanMac();
+  ethHdr->ether_shost = Mac::cleanMac();
+  ethHdr->ether_type  = ph->hw_protocol;
+  memcpy(buf + sizeof(ETH_HDR), payload, (size_t)len);
+
+  struct timeval tv;
+  if (nfq_get_timestamp(nfa, &tv) != 0) gettimeofday(&tv, NULL);
+  packet->pktHdr->ts     = tv;
+  packet->pktHdr->caplen = (UINT32)(len + sizeof(ETH_HDR));
+  packet->pktHdr->len    = packet->pktHdr->caplen;
+  packet->pktData  = buf;
+  packet->linkType = dataLink();
+  if (autoParse) parse(packet);
+
+  SnoopNfQueueItem item;
+  item.qh      = qh;
+  item.id      = id;
+  item.packet  = packet;
+  item.orig    = payload;
+  item.origLen = len;
+  item.accept  = false;
+  items.push_back(item);
+  return 0;
+}
+
+int SnoopNfQueue::recvOne(int slot, bool wait)
+{
+  if (wait)
+  {
+    pollfd pfd;
+    pfd.fd      = m_fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    int n = poll(&pfd, 1, readTimeout);
+    if (n == 0) return 0;
+    if (n < 0)
+    {
+      if (errno == EINTR) return 0;
+      SET_DEBUG_ERROR(SnoopError, qformat("poll return -1(%s)", strerror(errno)), VERR_FAIL);
+      return VERR_FAIL;
+    }
+  }
+
+  BYTE* buf = m_rxBuf + (size_t)slot * RX_SLOT;
+  ssize_t len = ::recv(m_fd, buf, RX_SLOT, MSG_DONTWAIT);
+  if (len < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+    if (errno == ENOBUFS) // netlink overrun, packets were lost in kernel
+    {
+      m_enobufs++;
+      return 0;
+    }
+    SET_DEBUG_ERROR(SnoopError, qformat("recv return -1(%s)", strerror(errno)), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  int before = items.count();
+  nfq_handle_packet(m_h, (char*)buf, (int)len);
+  return items.count() - before;
+}
+
+int SnoopNfQueue::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  if (!items.isEmpty()) flushTx(); // receive buffer is about to be reused
+
+  packet->clear();
+  m_batch  = NULL;
+  m_packet = packet;
+  int res  = recvOne(0, true);
+  m_packet = NULL;
+  if (res <= 0) return res;
+  return (int)packet->pktHdr->caplen;
+}
+
+int SnoopNfQueue::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  if (!items.isEmpty()) flushTx();
+
+  batch.reserve(max, MAXBUF);
+  batch.clear();
+  reserveRx(max);
+  m_batch = &batch;
+
+  //
+  // Wait for the first packet only, then take what is already queued without blocking.
+  // Every datagram gets its own receive slot, so original payloads stay until verdict.
+  //
+  int res = recvOne(0, true);
+  for (int slot = 1; res > 0 && !batch.full() && slot < m_rxSlots; slot++)
+  {
+    if (recvOne(slot, false) <= 0) break;
+  }
+  m_batch = NULL;
+  if (res < 0) return res;
+  return batch.count;
+}
+
+int SnoopNfQueue::write(SnoopPacket* packet)
+{
+  return write(packet->pktData, packet->pktHdr->caplen);
+}
+
+int SnoopNfQueue::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  Q_UNUSED(divertAddr)
+  if (size < (int)(sizeof(ETH_HDR) + sizeof(IP_HDR)))
+  {
+    SET_ERROR(SnoopError, qformat("too small packet(%d)", size), VERR_FAIL);
+    return VERR_FAIL;
+  }
+  IP_HDR* ipHdr = (IP_HDR*)(buf + sizeof(ETH_HDR));
+  if (ipHdr->ip_v != 4)
+  {
+    SET_ERROR(SnoopError, "only ipv4 packet can be written", VERR_NOT_SUPPORTED);
+    return VERR_FAIL;
+  }
+
+  //
+  // Injected packet goes through netfilter hooks again, so queue rule should skip it(e.g. -m owner or a mark).
+  //
+  if (m_rawSock == -1)
+  {
+    m_rawSock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (m_rawSock == -1)
+    {
+      SET_ERROR(SnoopError, qformat("error in socket(%s)", strerror(errno)), VERR_IN_SOCKET);
+      return VERR_FAIL;
+    }
+  }
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = ipHdr->ip_dst;
+  int len = size - (int)sizeof(ETH_HDR);
+  ssize_t res = ::sendto(m_rawSock, ipHdr, (size_t)len, 0, (sockaddr*)&addr, sizeof(addr));
+  if (res != (ssize_t)len)
+  {
+    LOG_ERROR("sendto return %d(%s)", (int)res, strerror(errno));
+    return VERR_FAIL;
+  }
+  return size;
+}
+
+bool SnoopNfQueue::relay(SnoopPacket* packet)
+{
+  for (int i = items.count() - 1; i >= 0; i--)
+  {
+    if (items[i].packet == packet)
+    {
+      items[i].accept = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SnoopNfQueue::verdict(nfq_q_handle* qh, UINT32 id, UINT32 verdict, bool batch)
+{
+  int res = batch ? nfq_set_verdict_batch(qh, id, verdict) : nfq_set_verdict(qh, id, verdict, 0, NULL);
+  if (res < 0) LOG_ERROR("nfq_set_verdict(%u, %u) return %d(%s)", id, verdict, res, strerror(errno));
+}
+
+void SnoopNfQueue::flushTx()
+{
+  //
+  // Packet not relayed(packet->drop or not in path) is dropped.
+  // Consecutive same verdicts of a queue are merged into one batch verdict, which covers every id up to the last one.
+  //
+  nfq_q_handle* runQh      = NULL;
+  UINT32        runId      = 0;
+  UINT32        runVerdict = NF_ACCEPT;
+  for (int i = 0; i < items.count(); i++)
+  {
+    SnoopNfQueueItem& item = items[i];
+    UINT32 _verdict = item.accept ? NF_ACCEPT : NF_DROP;
+
+    if (item.accept)
+    {
+      int         len  = (int)item.packet->pktHdr->caplen - (int)sizeof(ETH_HDR);
+      const BYTE* data = item.packet->pktData + sizeof(ETH_HDR);
+      if (len != item.origLen || memcmp(data, item.orig, (size_t)len) != 0)
+      {
+        if (runQh != NULL) verdict(runQh, runId, runVerdict, true);
+        runQh = NULL;
+        int res = nfq_set_verdict(item.qh, item.id, NF_ACCEPT, (UINT32)len, data);
+        if (res < 0) LOG_ERROR("nfq_set_verdict(%u, changed) return %d(%s)", item.id, res, strerror(errno));
+        continue;
+      }
+    }
+
+    if (!batchVerdict)
+    {
+      verdict(item.qh, item.id, _verdict, false);
+      continue;
+    }
+    if (runQh == item.qh && runVerdict == _verdict)
+    {
+      runId = item.id;
+      continue;
+    }
+    if (runQh != NULL) verdict(runQh, runId, runVerdict, true);
+    runQh      = item.qh;
+    runId      = item.id;
+    runVerdict = _verdict;
+  }
+  if (runQh != NULL) verdict(runQh, runId, runVerdict, true);
+  items.clear();
+}
+
+bool SnoopNfQueue::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  //
+  // queue_number peer_portid queue_total copy_mode copy_range queue_dropped user_dropped id_sequence 1
+  //
+  QFile file("/proc/net/netfilter/nfnetlink_queue");
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  drops   = 0;
+  ifDrops = m_enobufs;
+  while (!file.atEnd())
+  {
+    QStringList fields = QString(file.readLine()).simplified().split(' ');
+    if (fields.count() < 7) continue;
+    int num = fields.at(0).toInt();
+    if (num < queueNum || num >= queueNum + queueCount) continue;
+    drops   += fields.at(5).toULongLong();
+    ifDrops += fields.at(6).toULongLong();
+  }
+  return true;
+}
+
+void SnoopNfQueue::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  queueNum     = xml.getInt("queueNum", queueNum);
+  queueCount   = xml.getInt("queueCount", queueCount);
+  queueLen     = xml.getInt("queueLen", queueLen);
+  rcvBufSize   = xml.getInt("rcvBufSize", rcvBufSize);
+  readTimeout  = xml.getInt("readTimeout", readTimeout);
+  batchVerdict = xml.getBool("batchVerdict", batchVerdict);
+  failOpen     = xml.getBool("failOpen", failOpen);
+  gso          = xml.getBool("gso", gso);
+}
+
+void SnoopNfQueue::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setInt("queueNum", queueNum);
+  xml.setInt("queueCount", queueCount);
+  xml.setInt("queueLen", queueLen);
+  xml.setInt("rcvBufSize", rcvBufSize);
+  xml.setInt("readTimeout", readTimeout);
+  xml.setBool("batchVerdict", batchVerdict);
+  xml.setBool("failOpen", failOpen);
+  xml.setBool("gso", gso);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopNfQueue::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leQueueNum",      "Queue Num",     QString::number(queueNum));
+  VOptionable::addLineEdit(layout, "leQueueCount",    "Queue Count",   QString::number(queueCount));
+  VOptionable::addLineEdit(layout, "leQueueLen",      "Queue Len",     QString::number(queueLen));
+  VOptionable::addLineEdit(layout, "leRcvBufSize",    "Rcv Buf Size",  QString::number(rcvBufSize));
+  VOptionable::addLineEdit(layout, "leReadTimeout",   "Read Timeout",  QString::number(readTimeout));
+  VOptionable::addCheckBox(layout, "chkBatchVerdict", "Batch Verdict", batchVerdict);
+  VOptionable::addCheckBox(layout, "chkFailOpen",     "Fail Open",     failOpen);
+  VOptionable::addCheckBox(layout, "chkGso",          "GSO",           gso);
+}
+
+void SnoopNfQueue::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  queueNum     = dialog->findChild<QLineEdit*>("leQueueNum")->text().toInt();
+  queueCount   = dialog->findChild<QLineEdit*>("leQueueCount")->text().toInt();
+  queueLen     = dialog->findChild<QLineEdit*>("leQueueLen")->text().toInt();
+  rcvBufSize   = dialog->findChild<QLineEdit*>("leRcvBufSize")->text().toInt();
+  readTimeout  = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+  batchVerdict = dialog->findChild<QCheckBox*>("chkBatchVerdict")->checkState() == Qt::Checked;
+  failOpen     = dialog->findChild<QCheckBox*>("chkFailOpen")->checkState() == Qt::Checked;
+  gso          = dialog->findChild<QCheckBox*>("chkGso")->checkState() == Qt::Checked;
+}
+#endif // QT_GUI_LIB
+
+#endif // linux && SNOOP_NFQUEUE
@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_NF_QUEUE_H__
+#define __SNOOP_NF_QUEUE_H__
+
+#include <SnoopCapture>
+
+#if defined(linux) && defined(SNOOP_NFQUEUE)
+
+struct nfq_handle;
+struct nfq_q_handle;
+struct nfgenmsg;
+struct nfq_data;
+
+// ----------------------------------------------------------------------------
+// SnoopNfQueueItem
+// ----------------------------------------------------------------------------
+class SnoopNfQueueItem
+{
+public:
+  nfq_q_handle* qh;
+  UINT32        id;
+  SnoopPacket*  packet;
+  const BYTE*   orig;    // payload in receive buffer, for change check
+  int           origLen;
+  bool          accept;  // relay was called
+};
+
+// ----------------------------------------------------------------------------
+// SnoopNfQueue
+// ----------------------------------------------------------------------------
+/// Linux netfilter queue in-path capture(iptables -j NFQUEUE --queue-balance queueNum:queueNum+queueCount-1).
+/// Verdicts of a read round are sent in flushTx : packet->drop is NF_DROP, changed payload goes back with NF_ACCEPT.
+class SnoopNfQueue : public SnoopCapture
+{
+public:
+  SnoopNfQueue(void* owner = NULL);
+  virtual ~SnoopNfQueue();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+  virtual int write(SnoopPacket* packet);
+  virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::InPath; }
+  virtual int              dataLink()    { return DLT_EN10MB; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual void             flushTx();
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  int  queueNum;
+  int  queueCount;   // queues queueNum .. queueNum + queueCount - 1 on one netlink socket
+  int  queueLen;     // kernel queue max length
+  int  rcvBufSize;   // netlink socket receive buffer
+  int  readTimeout;
+  bool batchVerdict; // consecutive same verdicts go out as one nfq_set_verdict_batch
+  bool failOpen;     // NFQA_CFG_F_FAIL_OPEN : kernel accepts packets when queue is full
+  bool gso;          // NFQA_CFG_F_GSO : receive GSO packets unsegmented
+
+protected:
+  static const int RX_SLOT = 0x10000 + 4096; // max payload and netlink headers
+  static const int MAXBUF  = 0x10000 + sizeof(ETH_HDR);
+
+  nfq_handle*             m_h;
+  QList<nfq_q_handle*>    m_qhs;
+  int                     m_fd;
+  int                     m_rawSock;  // write()
+  BYTE*                   m_rxBuf;    // RX_SLOT * m_rxSlots, slots live until verdict
+  int                     m_rxSlots;
+  BYTE*                   m_pktData;  // read()
+  PKT_HDR                 m_pktHdr;   // read()
+  QVector<SnoopNfQueueItem> items;    // read but no verdict yet
+  SnoopPacketBatch*       m_batch;    // target of callback in readBurst(NULL : read)
+  SnoopPacket*            m_packet;   // target of callback in read
+  UINT64                  m_enobufs;  // receive overruns
+
+protected:
+  static int callback(nfq_q_handle* qh, nfgenmsg* nfmsg, nfq_data* nfa, void* data);
+  int  onPacket(nfq_q_handle* qh, nfq_data* nfa);
+  int  recvOne(int slot, bool wait);
+  void reserveRx(int slots);
+  void verdict(nfq_q_handle* qh, UINT32 id, UINT32 verdict, bool batch);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux && SNOOP_NFQUEUE
+
+#endif // __SNOOP_NF_QUEUE_H__
@@ -0,0 +1,117 @@
+#include <SnoopPacer>
+#ifdef linux
+#include <time.h>
+#endif // linux
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// SnoopPacer
+// ----------------------------------------------------------------------------
+SnoopPacer::SnoopPacer()
+{
+  speed     = 1;
+  burstNsec = 10000;  // 10 usec
+#ifdef linux
+  spinNsec  = 50000;  // 50 usec
+#endif // linux
+#ifdef WIN32
+  spinNsec  = 2000000; // 2 msec, Sleep granularity
+#endif // WIN32
+  start();
+}
+
+void SnoopPacer::start()
+{
+  packets     = 0;
+  maxLateNsec = 0;
+  m_started   = false;
+  m_firstTs   = 0;
+  m_lastTs    = 0;
+  m_lastNow   = 0;
+}
+
+INT64 SnoopPacer::packetTs(SnoopPacket* packet)
+{
+  INT64 frac = packet->tsNsec != 0 ? (INT64)packet->tsNsec : (INT64)packet->pktHdr->ts.tv_usec * 1000;
+  return (INT64)packet->pktHdr->ts.tv_sec * 1000000000 + frac;
+}
+
+INT64 SnoopPacer::dueNsec(INT64 ts)
+{
+  if (ts < m_firstTs) return 0; // out of order timestamp is released at once
+  return (INT64)((double)(ts - m_firstTs) / speed);
+}
+
+void SnoopPacer::release(INT64 ts)
+{
+  INT64 now  = timer.nsecsElapsed();
+  INT64 late = now - dueNsec(ts);
+  if (late > maxLateNsec) maxLateNsec = late;
+  if (ts > m_lastTs) m_lastTs = ts;
+  m_lastNow = now;
+  packets++;
+}
+
+bool SnoopPacer::due(SnoopPacket* packet)
+{
+  if (!m_started) return true;
+  return dueNsec(packetTs(packet)) - timer.nsecsElapsed() <= burstNsec;
+}
+
+void SnoopPacer::wait(SnoopPacket* packet)
+{
+  INT64 ts = packetTs(packet);
+  if (!m_started)
+  {
+    timer.start();
+    m_started = true;
+    m_firstTs = ts;
+    m_lastTs  = ts;
+    release(ts);
+    return;
+  }
+
+  INT64 due    = dueNsec(ts);
+  INT64 remain = due - timer.nsecsElapsed();
+  if (remain > burstNsec)
+  {
+    //
+    // Sleep for the coarse part and spin for the rest, as sleep wakes up late by scheduler granularity.
+    //
+    if (remain > spinNsec)
+    {
+      INT64 sleepNsec = remain - spinNsec;
+#ifdef linux
+      struct timespec req;
+      req.tv_sec  = (time_t)(sleepNsec / 1000000000);
+      req.tv_nsec = (long)(sleepNsec % 1000000000);
+      nanosleep(&req, NULL);
+#endif // linux
+#ifdef WIN32
+      msleep((unsigned long)(sleepNsec / 1000000));
+#endif // WIN32
+    }
+    while (timer.nsecsElapsed() < due);
+  }
+  release(ts);
+}
+
+double SnoopPacer::targetRate()
+{
+  INT64 span = m_lastTs - m_firstTs;
+  if (packets < 2 || span <= 0) return 0;
+  return (double)(packets - 1) * 1000000000 * speed / (double)span;
+}
+
+double SnoopPacer::achievedRate()
+{
+  if (packets < 2 || m_lastNow <= 0) return 0;
+  return (double)(packets - 1) * 1000000000 / (double)m_lastNow;
+}
+
+void SnoopPacer::report(QString name)
+{
+  if (packets == 0) return;
+  LOG_INFO("%s packets=%llu target=%.1f pps achieved=%.1f pps maxLate=%lld usec", qPrintable(name),
+    (unsigned long long)packets, targetRate(), achievedRate(), (long long)(maxLateNsec / 1000));
+}
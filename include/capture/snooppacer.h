@@ -0,0 +1,59 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_PACER_H__
+#define __SNOOP_PACER_H__
+
+#include <SnoopPacket>
+#include <QElapsedTimer>
+
+// ----------------------------------------------------------------------------
+// SnoopPacer
+// ----------------------------------------------------------------------------
+/// Releases captured packets at their original timestamps scaled by speed(monotonic nanosecond clock)
+class SnoopPacer
+{
+public:
+  SnoopPacer();
+
+public:
+  double speed;     // 2 : twice as fast as captured
+  INT64  burstNsec; // packet due within burstNsec is released without waiting
+  INT64  spinNsec;  // last spinNsec before due time is busy waited instead of sleeping
+
+public:
+  void start();
+  void wait(SnoopPacket* packet); // blocks until packet is due
+  bool due(SnoopPacket* packet);  // packet can go out in current burst
+
+public:
+  //
+  // Statistics
+  //
+  UINT64 packets;
+  INT64  maxLateNsec;  // worst lateness of a released packet
+  double targetRate(); // packets per second asked by timestamps and speed
+  double achievedRate(); // packets per second actually released
+  void   report(QString name);
+
+protected:
+  QElapsedTimer timer;
+  bool          m_started;
+  INT64         m_firstTs; // timestamp of first packet(nsec)
+  INT64         m_lastTs;  // timestamp of last released packet(nsec)
+  INT64         m_lastNow; // clock when last packet was released(nsec)
+
+protected:
+  INT64 packetTs(SnoopPacket* packet);
+  INT64 dueNsec(INT64 ts);
+  void  release(INT64 ts);
+};
+
+#endif // __SNOOP_PACER_H__
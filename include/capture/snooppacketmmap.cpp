@@ -0,0 +1,575 @@
+#include <SnoopPacketMmap>
+#include <SnoopFilterPushdown>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef PCAP_OPENFLAG_PROMISCUOUS
+#define PCAP_OPENFLAG_PROMISCUOUS 1
+#endif // PCAP_OPENFLAG_PROMISCUOUS
+
+REGISTER_METACLASS(SnoopPacketMmap, SnoopCapture)
+
+static const int VLAN_TAG_LEN = 4;  // tpid + tci
+static const int VLAN_MAC_LEN = 12; // dst and src mac moved in front of the tag
+
+// ----------------------------------------------------------------------------
+// SnoopPacketMmap
+// ----------------------------------------------------------------------------
+SnoopPacketMmap::SnoopPacketMmap(void* owner) : SnoopCapture(owner)
+{
+  adapterIndex  = snoop::DEFAULT_ADAPTER_INDEX;
+  filter        = "";
+  filterPushdown = true;
+  snapLen       = snoop::DEFAULT_SNAPLEN;
+  flags         = PCAP_OPENFLAG_PROMISCUOUS;
+  readTimeout   = snoop::DEFAULT_READTIMEOUT;
+  blockSize     = 1 << 20; // 1 MB
+  blockCount    = 64;
+  frameSize     = 2048;
+  fanoutId      = 0;
+  workerCount   = 1;
+
+  m_fanoutId    = 0;
+  fanout        = NULL;
+
+  m_sock        = -1;
+  m_ring        = NULL;
+  m_ringSize    = 0;
+  m_source      = "";
+
+  m_blockIdx    = 0;
+  m_blockOpen   = false;
+  m_pktLeft     = 0;
+  m_pkt         = NULL;
+  m_releaseIdx  = 0;
+  m_heldCount   = 0;
+
+  kernelPackets = 0;
+  kernelDrops   = 0;
+  freezeCount   = 0;
+}
+
+SnoopPacketMmap::~SnoopPacketMmap()
+{
+  close();
+}
+
+bool SnoopPacketMmap::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (adapterIndex == snoop::INVALID_ADAPTER_INDEX)
+  {
+    SET_ERROR(SnoopError, "invalid adapter index(-1)", VERR_INVALID_INDEX);
+    return false;
+  }
+  const SnoopInterface& intf = SnoopInterfaces::instance().at(adapterIndex);
+  m_source = intf.name;
+  LOG_DEBUG("source=%s", qPrintable(m_source));
+
+  if (blockSize <= 0 || frameSize <= 0 || blockCount <= 0 || blockSize % frameSize != 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid ring size(blockSize=%d frameSize=%d blockCount=%d)", blockSize, frameSize, blockCount), VERR_INVALID_RING_SIZE);
+    return false;
+  }
+
+  m_sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (m_sock == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in socket(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  int version = TPACKET_V3;
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_VERSION)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+    return false;
+  }
+
+  QString pushed = filterPushdown ? SnoopFilterPushdown::downstreamFilter(this, DLT_EN10MB) : "";
+  bool attached = false;
+  if (pushed != "")
+  {
+    QString combined = SnoopFilterPushdown::combine(filter, pushed);
+    attached = attachFilter(combined);
+    if (attached)
+      LOG_DEBUG("filter pushed down(%s)", qPrintable(combined));
+    else
+    {
+      LOG_WARN("can not push down filter(%s) %s", qPrintable(combined), qPrintable(error.msg));
+      error.clear();
+    }
+  }
+  if (!attached && !attachFilter(filter)) return false;
+
+  //
+  // Room in front of each frame for the 802.1Q tag that the kernel strips into tp_vlan_tci.
+  //
+  unsigned int reserve = VLAN_TAG_LEN;
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof(reserve)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_RESERVE)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+    return false;
+  }
+
+  tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size       = (unsigned int)blockSize;
+  req.tp_block_nr         = (unsigned int)blockCount;
+  req.tp_frame_size       = (unsigned int)frameSize;
+  req.tp_frame_nr         = (unsigned int)(blockSize / frameSize * blockCount);
+  req.tp_retire_blk_tov   = (unsigned int)readTimeout;
+  req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_RX_RING)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+    return false;
+  }
+
+  m_ringSize = (size_t)blockSize * (size_t)blockCount;
+  void* ring = mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, m_sock, 0);
+  if (ring == MAP_FAILED && errno == EAGAIN)
+  {
+    //
+    // RLIMIT_MEMLOCK is usually small without root(CAP_NET_RAW only).
+    //
+    LOG_WARN("mmap(MAP_LOCKED) failed(%s), ring is not locked in memory", strerror(errno));
+    ring = mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_sock, 0);
+  }
+  if (ring == MAP_FAILED)
+  {
+    SET_ERROR(SnoopError, qformat("error in mmap(%s)", strerror(errno)), VERR_IN_MMAP);
+    return false;
+  }
+  m_ring = (BYTE*)ring;
+
+  sockaddr_ll addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sll_family   = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_ALL);
+  addr.sll_ifindex  = (int)if_nametoindex(qPrintable(m_source));
+  if (addr.sll_ifindex == 0)
+  {
+    SET_ERROR(SnoopError, qformat("can not find interface(%s)", qPrintable(m_source)), VERR_IN_BIND);
+    return false;
+  }
+  if (bind(m_sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in bind(%s)", strerror(errno)), VERR_IN_BIND);
+    return false;
+  }
+
+  if ((flags & PCAP_OPENFLAG_PROMISCUOUS) != 0)
+  {
+    packet_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = addr.sll_ifindex;
+    mreq.mr_type    = PACKET_MR_PROMISC;
+    if (setsockopt(m_sock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+    {
+      LOG_WARN("setsockopt(PACKET_MR_PROMISC) return -1(%s)", strerror(errno));
+    }
+  }
+
+  //
+  // Fanout : kernel hashes each flow(both directions) onto one socket of the group.
+  //
+  if (!replica) m_fanoutId = fanoutId; // replica joins only through prepareWorker
+  if (!replica && workerCount > 1 && m_fanoutId == 0) m_fanoutId = (int)(getpid() & 0xFFFF);
+  if (m_fanoutId != 0)
+  {
+    int fanoutArg = (m_fanoutId & 0xFFFF) | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+    if (setsockopt(m_sock, SOL_PACKET, PACKET_FANOUT, &fanoutArg, sizeof(fanoutArg)) == -1)
+    {
+      SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_FANOUT)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+      return false;
+    }
+  }
+
+  m_blockIdx    = 0;
+  m_blockOpen   = false;
+  m_pktLeft     = 0;
+  m_pkt         = NULL;
+  m_releaseIdx  = 0;
+  m_heldCount   = 0;
+  kernelPackets = 0;
+  kernelDrops   = 0;
+  freezeCount   = 0;
+
+  if (!SnoopCapture::doOpen()) return false;
+
+  if (!replica && workerCount > 1)
+  {
+    fanout = new SnoopFanout(this);
+    if (!fanout->open(workerCount, prepareWorker))
+    {
+      error = fanout->error;
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnoopPacketMmap::prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex)
+{
+  SnoopPacketMmap* primary = (SnoopPacketMmap*)capture;
+  SnoopPacketMmap* replica = (SnoopPacketMmap*)worker;
+  Q_UNUSED(workerIndex)
+  replica->m_fanoutId = primary->m_fanoutId;
+}
+
+bool SnoopPacketMmap::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  SAFE_DELETE(fanout);
+
+  //
+  // Ring memory is referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+
+  if (m_sock != -1)
+  {
+    updateStats();
+    LOG_DEBUG("source=%s packets=%llu drops=%llu freeze=%llu", qPrintable(m_source),
+      (unsigned long long)kernelPackets, (unsigned long long)kernelDrops, (unsigned long long)freezeCount);
+  }
+  if (m_ring != NULL)
+  {
+    munmap(m_ring, m_ringSize);
+    m_ring = NULL;
+  }
+  if (m_sock != -1)
+  {
+    ::close(m_sock);
+    m_sock = -1;
+  }
+  m_source = "";
+
+  return SnoopCapture::doClose();
+}
+
+bool SnoopPacketMmap::attachFilter(QString _filter)
+{
+  //
+  // Empty filter still compiles into "ret #snapLen", so snapLen is applied in kernel.
+  //
+  pcap_t* pcap = pcap_open_dead(DLT_EN10MB, snapLen);
+  if (pcap == NULL)
+  {
+    SET_ERROR(SnoopError, "error in pcap_open_dead return NULL", VERR_IN_PCAP_OPEN_DEAD);
+    return false;
+  }
+  bpf_program code;
+  if (pcap_compile(pcap, &code, qPrintable(_filter), 1, 0xFFFFFFFF) < 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_compile(%s)", pcap_geterr(pcap)), VERR_IN_PCAP_COMPILE);
+    pcap_close(pcap);
+    return false;
+  }
+  sock_fprog prog;
+  prog.len    = (unsigned short)code.bf_len;
+  prog.filter = (sock_filter*)code.bf_insns;
+  int res = setsockopt(m_sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+  pcap_freecode(&code);
+  pcap_close(pcap);
+  if (res == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(SO_ATTACH_FILTER)(%s)", strerror(errno)), VERR_IN_PCAP_SETFILTER);
+    return false;
+  }
+  return true;
+}
+
+bool SnoopPacketMmap::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  if (!updateStats()) return false;
+  drops   = kernelDrops;
+  ifDrops = 0;
+  return true;
+}
+
+bool SnoopPacketMmap::updateStats()
+{
+  if (m_sock == -1) return false;
+  tpacket_stats_v3 stats;
+  socklen_t len = sizeof(stats);
+  if (getsockopt(m_sock, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == -1)
+  {
+    LOG_ERROR("getsockopt(PACKET_STATISTICS) return -1(%s)", strerror(errno));
+    return false;
+  }
+  //
+  // Kernel resets counters on every read.
+  //
+  kernelPackets += stats.tp_packets;
+  kernelDrops   += stats.tp_drops;
+  freezeCount   += stats.tp_freeze_q_cnt;
+  return true;
+}
+
+bool SnoopPacketMmap::nextFrame(SnoopPacket* packet)
+{
+  while (m_pktLeft == 0)
+  {
+    if (m_blockOpen)
+    {
+      m_blockOpen = false;
+      m_heldCount++;
+      m_blockIdx = (m_blockIdx + 1) % blockCount;
+    }
+    if (m_heldCount >= blockCount) return false;
+    tpacket_block_desc* desc = blockDesc(m_blockIdx);
+    if ((desc->hdr.bh1.block_status & TP_STATUS_USER) == 0) return false;
+    __sync_synchronize();
+    m_blockOpen = true;
+    m_pktLeft   = (int)desc->hdr.bh1.num_pkts;
+    m_pkt       = (tpacket3_hdr*)((BYTE*)desc + desc->hdr.bh1.offset_to_first_pkt);
+  }
+
+  tpacket3_hdr* hdr = m_pkt;
+  PKT_HDR* pktHdr      = packet->pktHdr;
+  pktHdr->ts.tv_sec    = hdr->tp_sec;
+  pktHdr->ts.tv_usec   = hdr->tp_nsec / 1000;
+  pktHdr->caplen       = hdr->tp_snaplen;
+  pktHdr->len          = hdr->tp_len;
+  packet->tsNsec       = hdr->tp_nsec;
+  packet->pktData      = (BYTE*)hdr + hdr->tp_mac;
+  packet->linkType     = dataLink();
+
+  //
+  // Put back the 802.1Q tag in front of ether_type, using the room made by PACKET_RESERVE.
+  //
+  bool vlanValid = (hdr->tp_status & TP_STATUS_VLAN_VALID) != 0 || hdr->hv1.tp_vlan_tci != 0; // old kernel sets tci only
+  if (vlanValid && hdr->tp_snaplen >= (unsigned int)VLAN_MAC_LEN)
+  {
+    UINT16 tpid = (hdr->tp_status & TP_STATUS_VLAN_TPID_VALID) != 0 ? hdr->hv1.tp_vlan_tpid : ETH_P_8021Q;
+    BYTE* data = packet->pktData - VLAN_TAG_LEN;
+    memmove(data, packet->pktData, VLAN_MAC_LEN);
+    *(UINT16*)(data + VLAN_MAC_LEN)     = htons(tpid);
+    *(UINT16*)(data + VLAN_MAC_LEN + 2) = htons(hdr->hv1.tp_vlan_tci);
+    packet->pktData  = data;
+    pktHdr->caplen  += VLAN_TAG_LEN;
+    pktHdr->len     += VLAN_TAG_LEN;
+  }
+
+  m_pkt = (tpacket3_hdr*)((BYTE*)hdr + hdr->tp_next_offset);
+  m_pktLeft--;
+  return true;
+}
+
+void SnoopPacketMmap::releaseBlocks()
+{
+  if (m_heldCount == 0) return;
+  __sync_synchronize();
+  while (m_heldCount > 0)
+  {
+    blockDesc(m_releaseIdx)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    m_releaseIdx = (m_releaseIdx + 1) % blockCount;
+    m_heldCount--;
+  }
+}
+
+bool SnoopPacketMmap::waitBlock()
+{
+  pollfd pfd;
+  pfd.fd      = m_sock;
+  pfd.events  = POLLIN | POLLERR;
+  pfd.revents = 0;
+  int res = poll(&pfd, 1, readTimeout);
+  if (res < 0 && errno != EINTR)
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("poll return %d(%s)", res, strerror(errno)), VERR_IN_PCAP_NEXT_EX);
+    return false;
+  }
+  return true;
+}
+
+int SnoopPacketMmap::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  LOG_ASSERT(m_ring != NULL);
+
+  //
+  // Previous packet has been processed, so blocks consumed so far can be returned.
+  //
+  releaseBlocks();
+
+  packet->clear();
+  packet->pktHdr = &m_pktHdr;
+  if (!nextFrame(packet))
+  {
+    if (!waitBlock()) return VERR_FAIL;
+    if (!nextFrame(packet)) return 0;
+  }
+  if (autoParse) parse(packet);
+  return (int)packet->pktHdr->caplen;
+}
+
+int SnoopPacketMmap::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  LOG_ASSERT(m_ring != NULL);
+
+  //
+  // Previous burst has gone through the graph, so its blocks can be returned.
+  //
+  releaseBlocks();
+
+  batch.reserve(max, 0);
+  batch.clear();
+  for (int retry = 0; retry < 2 && batch.count == 0; retry++)
+  {
+    if (retry > 0 && !waitBlock()) return VERR_FAIL;
+    while (batch.count < max)
+    {
+      SnoopPacket* packet = batch.next();
+      if (!nextFrame(packet))
+      {
+        batch.count--; // give back unused descriptor
+        break;
+      }
+    }
+  }
+
+  if (autoParse)
+  {
+    for (int i = 0; i < batch.count; i++)
+      parse(batch.at(i));
+  }
+  return batch.count;
+}
+
+int SnoopPacketMmap::write(SnoopPacket* packet)
+{
+  return write(packet->pktData, packet->pktHdr->caplen);
+}
+
+int SnoopPacketMmap::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  Q_UNUSED(divertAddr)
+  ssize_t res = ::send(m_sock, buf, (size_t)size, 0);
+  if (res == (ssize_t)size) return size;
+  LOG_ERROR("send return %d(%s)", (int)res, strerror(errno));
+  return VERR_FAIL;
+}
+
+bool SnoopPacketMmap::relay(SnoopPacket* packet)
+{
+  Q_UNUSED(packet)
+  SET_ERROR(SnoopError, "relay not supported", VERR_NOT_SUPPORTED);
+  return false;
+}
+
+void SnoopPacketMmap::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  adapterIndex = xml.getInt("adapterIndex", adapterIndex);
+  filter       = xml.getStr("filter", filter);
+  filterPushdown = xml.getBool("filterPushdown", filterPushdown);
+  snapLen      = xml.getInt("snapLen", snapLen);
+  flags        = xml.getInt("flags", flags);
+  readTimeout  = xml.getInt("readTimeout", readTimeout);
+  blockSize    = xml.getInt("blockSize", blockSize);
+  blockCount   = xml.getInt("blockCount", blockCount);
+  frameSize    = xml.getInt("frameSize", frameSize);
+  fanoutId     = xml.getInt("fanoutId", fanoutId);
+  workerCount  = xml.getInt("workerCount", workerCount);
+}
+
+void SnoopPacketMmap::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setInt("adapterIndex", adapterIndex);
+  xml.setStr("filter", filter);
+  xml.setBool("filterPushdown", filterPushdown);
+  xml.setInt("snapLen", snapLen);
+  xml.setInt("flags", flags);
+  xml.setInt("readTimeout", readTimeout);
+  xml.setInt("blockSize", blockSize);
+  xml.setInt("blockCount", blockCount);
+  xml.setInt("frameSize", frameSize);
+  xml.setInt("fanoutId", fanoutId);
+  xml.setInt("workerCount", workerCount);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopPacketMmap::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  QStringList strList;
+  SnoopInterfaces& intfs = SnoopInterfaces::instance();
+  int _count = intfs.count();
+  for (int i = 0; i < _count; i++)
+  {
+    SnoopInterface& intf = (SnoopInterface&)intfs.at(i);
+    QString value = intf.description;
+    if (value == "") value = intf.name;
+    strList.push_back(value);
+  }
+  VOptionable::addComboBox(layout, "cbxAdapterIndex", "Adapter",      strList, adapterIndex);
+  VOptionable::addLineEdit(layout, "leFilter",        "Filter",       filter);
+  VOptionable::addCheckBox(layout, "chkFilterPushdown", "Filter Pushdown", filterPushdown);
+  VOptionable::addLineEdit(layout, "leSnapLen",       "Snap Len",     QString::number(snapLen));
+  VOptionable::addLineEdit(layout, "leFlags",         "Flags",        QString::number(flags));
+  VOptionable::addLineEdit(layout, "leReadTimeout",   "Read Timeout", QString::number(readTimeout));
+  VOptionable::addLineEdit(layout, "leBlockSize",     "Block Size",   QString::number(blockSize));
+  VOptionable::addLineEdit(layout, "leBlockCount",    "Block Count",  QString::number(blockCount));
+  VOptionable::addLineEdit(layout, "leFrameSize",     "Frame Size",   QString::number(frameSize));
+  VOptionable::addLineEdit(layout, "leFanoutId",      "Fanout Id",    QString::number(fanoutId));
+  VOptionable::addLineEdit(layout, "leWorkerCount",   "Worker Count", QString::number(workerCount));
+}
+
+void SnoopPacketMmap::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  adapterIndex = dialog->findChild<QComboBox*>("cbxAdapterIndex")->currentIndex();
+  filter       = dialog->findChild<QLineEdit*>("leFilter")->text();
+  filterPushdown = dialog->findChild<QCheckBox*>("chkFilterPushdown")->checkState() == Qt::Checked;
+  snapLen      = dialog->findChild<QLineEdit*>("leSnapLen")->text().toInt();
+  flags        = dialog->findChild<QLineEdit*>("leFlags")->text().toInt();
+  readTimeout  = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+  blockSize    = dialog->findChild<QLineEdit*>("leBlockSize")->text().toInt();
+  blockCount   = dialog->findChild<QLineEdit*>("leBlockCount")->text().toInt();
+  frameSize    = dialog->findChild<QLineEdit*>("leFrameSize")->text().toInt();
+  fanoutId     = dialog->findChild<QLineEdit*>("leFanoutId")->text().toInt();
+  workerCount  = dialog->findChild<QLineEdit*>("leWorkerCount")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
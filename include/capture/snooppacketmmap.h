@@ -0,0 +1,116 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_PACKET_MMAP_H__
+#define __SNOOP_PACKET_MMAP_H__
+
+#include <SnoopAdapter>
+#include <SnoopFanout>
+
+#ifdef linux
+
+#include <linux/if_packet.h>
+
+// ----------------------------------------------------------------------------
+// SnoopPacketMmap
+// ----------------------------------------------------------------------------
+/// AF_PACKET TPACKET_V3 ring capture(same properties as SnoopAdapter)
+class SnoopPacketMmap : public SnoopCapture
+{
+public:
+  SnoopPacketMmap(void* owner = NULL);
+  virtual ~SnoopPacketMmap();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+  virtual int write(SnoopPacket* packet);
+  virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::OutOfPath; }
+  virtual int              dataLink()    { return DLT_EN10MB; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  SnoopAdapterIndex adapterIndex;
+  QString           filter;
+  bool              filterPushdown; // also attaches SnoopBpFilter expressions of every downstream path
+  int               snapLen;
+  int               flags;
+  int               readTimeout;
+  int               blockSize;
+  int               blockCount;
+  int               frameSize;
+  int               fanoutId;    // PACKET_FANOUT group id(0 : not used)
+  int               workerCount; // sockets in fanout group, each with its own graph replica
+
+protected:
+  int               m_fanoutId;  // fanoutId actually joined
+  SnoopFanout*      fanout;
+  static void       prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex);
+
+public:
+  int               m_sock;
+protected:
+  BYTE*             m_ring;
+  size_t            m_ringSize;
+  QString           m_source;
+
+protected:
+  int               m_blockIdx;   // block being read
+  bool              m_blockOpen;  // m_blockIdx is owned by user
+  int               m_pktLeft;    // packets left in m_blockIdx
+  tpacket3_hdr*     m_pkt;        // next packet in m_blockIdx
+  int               m_releaseIdx; // first block not yet returned to kernel
+  int               m_heldCount;  // consumed blocks not yet returned to kernel
+  PKT_HDR           m_pktHdr;     // for read()
+
+public:
+  //
+  // Ring statistics(accumulated from PACKET_STATISTICS)
+  //
+  UINT64            kernelPackets;
+  UINT64            kernelDrops;
+  UINT64            freezeCount;
+  bool              updateStats();
+
+public:
+  QString source() { return m_source; }
+
+protected:
+  tpacket_block_desc* blockDesc(int idx) { return (tpacket_block_desc*)(m_ring + (size_t)idx * (size_t)blockSize); }
+  bool nextFrame(SnoopPacket* packet);
+  void releaseBlocks();
+  bool waitBlock();
+  bool attachFilter(QString _filter);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_PACKET_MMAP_H__
@@ -1,4 +1,5 @@
 #include <SnoopPcap>
+#include <SnoopFilterPushdown>
 //#include <VDebugNew>
 
 #ifndef PCAP_OPENFLAG_PROMISCUOUS
@@ -11,11 +12,26 @@
 SnoopPcap::SnoopPcap(void* owner) : SnoopCapture(owner)
 {
   filter       = "";
+  filterPushdown = true;
   snapLen      = snoop::DEFAULT_SNAPLEN;
   flags        = PCAP_OPENFLAG_PROMISCUOUS;
   readTimeout  = snoop::DEFAULT_READTIMEOUT;
+  bufferSize   = 32 * 1024 * 1024; // default 2 MB loses packets on burst
+  immediateMode = false;
+  tstampPrecision = 0;
+  nonblock     = false;
+  batchWrite   = false;
+  txFrameCount = 256;
+  txFlushCount = 32;
+  txQueueSize  = 0;
+  txQueuePolicy = (int)SnoopTxQueue::Block;
+  txQueue      = NULL;
   m_pcap       = NULL;
   m_dataLink   = DLT_NULL;
+  m_nsec       = false;
+#ifdef linux
+  txRing       = NULL;
+#endif // linux
   m_source     = "";
 }
 
@@ -42,12 +58,20 @@ bool SnoopPcap::doClose()
     runThread().wait();
   }
   // --------------------------------
+  if (driver != NULL) driver->detach(this); // same for external dispatcher(SnoopReactor)
+  if (txQueue != NULL) txQueue->close(); // sends queued frames
+  flushTx(); // last batched frames and tx statistics
+  SAFE_DELETE(txQueue);
+#ifdef linux
+  SAFE_DELETE(txRing);
+#endif // linux
   if (m_pcap != NULL)
   {
     pcap_close(m_pcap);
   }
   m_dataLink = DLT_NULL;
   m_source   = "";
+  m_nsec     = false;
 
   bool res = SnoopCapture::doClose();
 
@@ -84,6 +108,7 @@ int SnoopPcap::read(SnoopPacket* packet)
       break;
     default: // packet captured
       res = packet->pktHdr->caplen;
+      if (m_nsec) pcapFixTstamp(packet);
       packet->linkType = dataLink();
       if (autoParse) parse(packet);
       break;
@@ -91,14 +116,78 @@ int SnoopPcap::read(SnoopPacket* packet)
   return res;
 }
 
+static void _pcapBurstHandler(u_char* user, const struct pcap_pkthdr* pktHdr, const u_char* pktData)
+{
+  SnoopPacketBatch* batch = (SnoopPacketBatch*)user;
+  batch->copy(pktHdr, pktData);
+}
+
+int SnoopPcap::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  LOG_ASSERT(m_pcap != NULL);
+
+  //
+  // pcap buffer is reused on next call, so packet data is copied into batch.
+  //
+  batch.reserve(max, pcap_snapshot(m_pcap));
+  batch.clear();
+  int i = pcap_dispatch(m_pcap, max, _pcapBurstHandler, (u_char*)&batch);
+  switch (i) {
+    case -2: // if pcap_breakloop was called
+      return 0;
+    case -1: // if an error occurred
+      SET_DEBUG_ERROR(SnoopError, qformat("pcap_dispatch return -1(%s)", pcap_geterr(m_pcap)), VERR_IN_PCAP_NEXT_EX);
+      return VERR_FAIL;
+    case 0 : // if the timeout occurs(or EOF was reached reading from an offline capture)
+      if (pcap_file(m_pcap) != NULL)
+      {
+        SET_DEBUG_ERROR(SnoopError, "pcap_dispatch return 0(eof)", VERR_IN_PCAP_NEXT_EX);
+        return VERR_FAIL;
+      }
+      return 0;
+  }
+
+  int _dataLink = dataLink();
+  for (int j = 0; j < batch.count; j++)
+  {
+    SnoopPacket* packet = batch.at(j);
+    if (m_nsec) pcapFixTstamp(packet);
+    packet->linkType = _dataLink;
+    if (autoParse) parse(packet);
+  }
+  return batch.count;
+}
+
 int SnoopPcap::write(SnoopPacket* packet)
 {
   return write(packet->pktData, packet->pktHdr->caplen);
 }
 
 int SnoopPcap::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  if (txQueue != NULL) return txQueue->push((BYTE*)buf, size, divertAddr);
+  return doWrite(buf, size, divertAddr);
+}
+
+int SnoopPcap::doWrite(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
 {
   Q_UNUSED(divertAddr)
+#ifdef linux
+  if (txRing != NULL)
+  {
+    int res = txRing->write((BYTE*)buf, size);
+    //
+    // Nobody calls dispatch(and flushTx) on write only capture, so send at once.
+    //
+    if (!autoRead && driver == NULL) txRing->flush();
+    return res;
+  }
+#endif // linux
   int res = pcap_sendpacket(m_pcap, (const u_char*)buf, size);
   if (res == 0) return size;
   LOG_ERROR("pcap_sendpacket return %d", res); // may be -1? // gilgil temp 2013.11.29
@@ -112,6 +201,37 @@ bool SnoopPcap::relay(SnoopPacket* packet)
   return false;
 }
 
+bool SnoopPcap::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  if (m_pcap == NULL || pcap_file(m_pcap) != NULL) return false; // offline has no stats
+  pcap_stat stat;
+  if (pcap_stats(m_pcap, &stat) != 0) return false;
+  drops   = stat.ps_drop;
+  ifDrops = stat.ps_ifdrop;
+  return true;
+}
+
+void SnoopPcap::flushTx()
+{
+  //
+  // Called on capture thread only(after dispatch and on close), which is the only writer of stats.
+  // Sender thread of txQueue flushes txRing by itself.
+  //
+  if (txQueue != NULL)
+  {
+    stats.txPackets = SnoopTxQueue::load(txQueue->sent);
+    stats.txDrops   = SnoopTxQueue::load(txQueue->dropNewest) + SnoopTxQueue::load(txQueue->dropOldest) + SnoopTxQueue::load(txQueue->sendErrors);
+    stats.txBlocked = SnoopTxQueue::load(txQueue->blocked);
+  }
+#ifdef linux
+  if (txRing == NULL) return;
+  txRing->flush();
+  if (txQueue != NULL) return; // frames dropped by ring are counted as send errors of queue
+  stats.txPackets = txRing->sent;
+  stats.txDrops   = txRing->drops;
+#endif // linux
+}
+
 // ----- gilgil temp 2009.08.30 -----
 /*
 int SnoopPcap::write(u_char* buf, int size)
@@ -146,15 +266,53 @@ bool SnoopPcap::pcapOpen(char* source, pcap_rmtauth* auth, pcap_if_t* dev)
   char errBuf[PCAP_ERRBUF_SIZE];
 #ifdef WIN32
   m_pcap = pcap_open(source, snapLen, flags, readTimeout, auth, errBuf);
-#endif // WIN32
-#ifdef linux
-  m_pcap = pcap_open_live(source, snapLen, flags, readTimeout, errBuf);
-#endif // linux
   if (m_pcap == NULL)
   {
     SET_ERROR(SnoopError, qformat("error in pcap_open(%s)", errBuf), VERR_IN_PCAP_OPEN);
     return false;
   }
+  //
+  // winpcap has no pcap_create, so its own calls are used for buffer size and immediate mode.
+  //
+  if (pcap_file(m_pcap) == NULL)
+  {
+    if (bufferSize > 0 && pcap_setbuff(m_pcap, bufferSize) != 0)
+      LOG_WARN("error in pcap_setbuff(%d)", bufferSize);
+    if (immediateMode && pcap_setmintocopy(m_pcap, 0) != 0)
+      LOG_WARN("error in pcap_setmintocopy(0)");
+    if (nonblock && pcap_setnonblock(m_pcap, 1, errBuf) != 0)
+      LOG_WARN("error in pcap_setnonblock(%s)", errBuf);
+  }
+#endif // WIN32
+#ifdef linux
+  if (!pcapCreate(source)) return false;
+  if (batchWrite && pcap_file(m_pcap) == NULL)
+  {
+    txRing = new SnoopTxRing;
+    txRing->frameSize  = SnoopTxRing::frameSizeFor(snapLen > 2048 ? snapLen : 2048);
+    txRing->frameCount = txFrameCount;
+    txRing->flushCount = txFlushCount;
+    if (!txRing->open(source))
+    {
+      error = txRing->error;
+      SAFE_DELETE(txRing);
+      return false;
+    }
+  }
+#endif // linux
+  if (txQueueSize > 0 && pcap_file(m_pcap) == NULL)
+  {
+    txQueue = new SnoopTxQueue(this);
+    txQueue->capacity = txQueueSize;
+    txQueue->slotSize = snapLen > 2048 ? snapLen : 2048;
+    txQueue->policy   = (SnoopTxQueue::Policy)txQueuePolicy;
+    if (!txQueue->open())
+    {
+      error = txQueue->error;
+      SAFE_DELETE(txQueue);
+      return false;
+    }
+  }
   m_dataLink = pcap_datalink(m_pcap);
   if (m_dataLink != DLT_EN10MB)
   {
@@ -169,12 +327,93 @@ bool SnoopPcap::pcapOpen(char* source, pcap_rmtauth* auth, pcap_if_t* dev)
     case DLT_USB_LINUX_MMAPPED:
       filtering = false; break;
   }
-  if (filtering && filter != "") if (!pcapProcessFilter(dev)) return false;
+  if (!filtering) return true;
+
+  //
+  // Out of path capture does not have to deliver what no downstream path accepts.
+  // In path capture(ArpSpoof) relays every packet, so keeps its own filter only.
+  //
+  QString pushed = "";
+  if (filterPushdown && captureType() == SnoopCaptureType::OutOfPath)
+    pushed = SnoopFilterPushdown::downstreamFilter(this, m_dataLink);
+  if (pushed != "")
+  {
+    QString combined = SnoopFilterPushdown::combine(filter, pushed);
+    if (pcapProcessFilter(dev, combined))
+    {
+      LOG_DEBUG("filter pushed down(%s) source=%s", qPrintable(combined), source);
+      return true;
+    }
+    LOG_WARN("can not push down filter(%s) %s", qPrintable(combined), qPrintable(error.msg));
+    error.clear();
+  }
+  if (filter != "") if (!pcapProcessFilter(dev, filter)) return false;
 
   return true;
 }
 
-bool SnoopPcap::pcapProcessFilter(pcap_if_t* dev)
+#ifdef linux
+bool SnoopPcap::pcapCreate(char* source)
+{
+  char errBuf[PCAP_ERRBUF_SIZE];
+  int  precision = tstampPrecision == 1 ? PCAP_TSTAMP_PRECISION_NANO : PCAP_TSTAMP_PRECISION_MICRO;
+
+  if (strncmp(source, "file://", 7) == 0)
+  {
+    m_pcap = pcap_open_offline_with_tstamp_precision(source + 7, precision, errBuf);
+    if (m_pcap == NULL)
+    {
+      SET_ERROR(SnoopError, qformat("error in pcap_open_offline(%s)", errBuf), VERR_IN_PCAP_OPEN);
+      return false;
+    }
+    m_nsec = pcap_get_tstamp_precision(m_pcap) == PCAP_TSTAMP_PRECISION_NANO;
+    return true;
+  }
+
+  m_pcap = pcap_create(source, errBuf);
+  if (m_pcap == NULL)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_create(%s)", errBuf), VERR_IN_PCAP_OPEN);
+    return false;
+  }
+  pcap_set_snaplen(m_pcap, snapLen);
+  pcap_set_promisc(m_pcap, (flags & PCAP_OPENFLAG_PROMISCUOUS) ? 1 : 0);
+  pcap_set_timeout(m_pcap, readTimeout);
+  if (bufferSize > 0) pcap_set_buffer_size(m_pcap, bufferSize);
+  pcap_set_immediate_mode(m_pcap, immediateMode ? 1 : 0);
+  if (pcap_set_tstamp_precision(m_pcap, precision) != 0)
+    LOG_WARN("tstamp precision(%d) not supported(%s)", tstampPrecision, source);
+
+  int res = pcap_activate(m_pcap);
+  if (res < 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_activate(%s %s)", pcap_statustostr(res), pcap_geterr(m_pcap)), VERR_IN_PCAP_OPEN);
+    pcap_close(m_pcap);
+    m_pcap = NULL;
+    return false;
+  }
+  if (res > 0) LOG_WARN("pcap_activate return %d(%s %s)", res, pcap_statustostr(res), pcap_geterr(m_pcap));
+
+  if (nonblock && pcap_setnonblock(m_pcap, 1, errBuf) != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in pcap_setnonblock(%s)", errBuf), VERR_IN_PCAP_OPEN);
+    return false;
+  }
+  m_nsec = pcap_get_tstamp_precision(m_pcap) == PCAP_TSTAMP_PRECISION_NANO;
+  return true;
+}
+#endif // linux
+
+void SnoopPcap::pcapFixTstamp(SnoopPacket* packet)
+{
+  //
+  // Nano precision puts nanoseconds in tv_usec. Downstream expects microseconds there.
+  //
+  packet->tsNsec = (UINT32)packet->pktHdr->ts.tv_usec;
+  packet->pktHdr->ts.tv_usec /= 1000;
+}
+
+bool SnoopPcap::pcapProcessFilter(pcap_if_t* dev, QString _filter)
 {
   u_int uNetMask;
   bpf_program code;
@@ -183,12 +422,14 @@ bool SnoopPcap::pcapProcessFilter(pcap_if_t* dev)
     uNetMask = ((struct sockaddr_in*)(dev->addresses->netmask))->sin_addr.s_addr;
   else
     uNetMask = 0xFFFFFFFF;
-  if (pcap_compile(m_pcap, &code, qPrintable(filter), 1, uNetMask) < 0)
+  if (pcap_compile(m_pcap, &code, qPrintable(_filter), 1, uNetMask) < 0)
   {
     SET_ERROR(SnoopError, qformat("error in pcap_compile(%s)", pcap_geterr(m_pcap)), VERR_IN_PCAP_COMPILE);
     return false;
   }
-  if (pcap_setfilter(m_pcap, &code) < 0)
+  int res = pcap_setfilter(m_pcap, &code);
+  pcap_freecode(&code);
+  if (res < 0)
   {
     SET_ERROR(SnoopError, qformat("error in pcap_setfilter(%s)", pcap_geterr(m_pcap)), VERR_IN_PCAP_SETFILTER);
     return false;
@@ -201,9 +442,19 @@ void SnoopPcap::load(VXml xml)
   SnoopCapture::load(xml);
 
   filter      = xml.getStr("filter", filter);
+  filterPushdown = xml.getBool("filterPushdown", filterPushdown);
   snapLen     = xml.getInt("snapLen", snapLen);
   flags       = xml.getInt("flags", flags);
   readTimeout = xml.getInt("readTimeout", readTimeout);
+  bufferSize  = xml.getInt("bufferSize", bufferSize);
+  immediateMode = xml.getBool("immediateMode", immediateMode);
+  tstampPrecision = xml.getInt("tstampPrecision", tstampPrecision);
+  nonblock    = xml.getBool("nonblock", nonblock);
+  batchWrite  = xml.getBool("batchWrite", batchWrite);
+  txFrameCount = xml.getInt("txFrameCount", txFrameCount);
+  txFlushCount = xml.getInt("txFlushCount", txFlushCount);
+  txQueueSize = xml.getInt("txQueueSize", txQueueSize);
+  txQueuePolicy = xml.getInt("txQueuePolicy", txQueuePolicy);
 }
 
 void SnoopPcap::save(VXml xml)
@@ -211,9 +462,19 @@ void SnoopPcap::save(VXml xml)
   SnoopCapture::save(xml);
 
   xml.setStr("filter", filter);
+  xml.setBool("filterPushdown", filterPushdown);
   xml.setInt("snapLen", snapLen);
   xml.setInt("flags", flags);
   xml.setInt("readTimeout", readTimeout);
+  xml.setInt("bufferSize", bufferSize);
+  xml.setBool("immediateMode", immediateMode);
+  xml.setInt("tstampPrecision", tstampPrecision);
+  xml.setBool("nonblock", nonblock);
+  xml.setBool("batchWrite", batchWrite);
+  xml.setInt("txFrameCount", txFrameCount);
+  xml.setInt("txFlushCount", txFlushCount);
+  xml.setInt("txQueueSize", txQueueSize);
+  xml.setInt("txQueuePolicy", txQueuePolicy);
 }
 
 #ifdef QT_GUI_LIB
@@ -222,9 +483,19 @@ void SnoopPcap::optionAddWidget(QLayout* layout)
   SnoopCapture::optionAddWidget(layout);
 
   VOptionable::addLineEdit(layout, "leFilter",      "Filter",       filter);
+  VOptionable::addCheckBox(layout, "chkFilterPushdown", "Filter Pushdown", filterPushdown);
   VOptionable::addLineEdit(layout, "leSnapLen",     "Snap Len",     QString::number(snapLen));
   VOptionable::addLineEdit(layout, "leFlags",       "Flags",        QString::number(flags));
   VOptionable::addLineEdit(layout, "leReadTimeout", "Read Timeout", QString::number(readTimeout));
+  VOptionable::addLineEdit(layout, "leBufferSize",  "Buffer Size",  QString::number(bufferSize));
+  VOptionable::addCheckBox(layout, "chkImmediateMode", "Immediate Mode", immediateMode);
+  VOptionable::addLineEdit(layout, "leTstampPrecision", "Tstamp Precision", QString::number(tstampPrecision));
+  VOptionable::addCheckBox(layout, "chkNonblock",   "Nonblock",     nonblock);
+  VOptionable::addCheckBox(layout, "chkBatchWrite", "Batch Write",  batchWrite);
+  VOptionable::addLineEdit(layout, "leTxFrameCount", "Tx Frame Count", QString::number(txFrameCount));
+  VOptionable::addLineEdit(layout, "leTxFlushCount", "Tx Flush Count", QString::number(txFlushCount));
+  VOptionable::addLineEdit(layout, "leTxQueueSize", "Tx Queue Size", QString::number(txQueueSize));
+  VOptionable::addLineEdit(layout, "leTxQueuePolicy", "Tx Queue Policy", QString::number(txQueuePolicy));
 }
 
 void SnoopPcap::optionSaveDlg(QDialog* dialog)
@@ -232,8 +503,18 @@ void SnoopPcap::optionSaveDlg(QDialog* dialog)
   SnoopCapture::optionSaveDlg(dialog);
 
   filter      = dialog->findChild<QLineEdit*>("leFilter")->text();
+  filterPushdown = dialog->findChild<QCheckBox*>("chkFilterPushdown")->checkState() == Qt::Checked;
   snapLen     = dialog->findChild<QLineEdit*>("leSnapLen")->text().toInt();
   flags       = dialog->findChild<QLineEdit*>("leFlags")->text().toInt();
   readTimeout = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+  bufferSize  = dialog->findChild<QLineEdit*>("leBufferSize")->text().toInt();
+  immediateMode = dialog->findChild<QCheckBox*>("chkImmediateMode")->checkState() == Qt::Checked;
+  tstampPrecision = dialog->findChild<QLineEdit*>("leTstampPrecision")->text().toInt();
+  nonblock    = dialog->findChild<QCheckBox*>("chkNonblock")->checkState() == Qt::Checked;
+  batchWrite  = dialog->findChild<QCheckBox*>("chkBatchWrite")->checkState() == Qt::Checked;
+  txFrameCount = dialog->findChild<QLineEdit*>("leTxFrameCount")->text().toInt();
+  txFlushCount = dialog->findChild<QLineEdit*>("leTxFlushCount")->text().toInt();
+  txQueueSize = dialog->findChild<QLineEdit*>("leTxQueueSize")->text().toInt();
+  txQueuePolicy = dialog->findChild<QLineEdit*>("leTxQueuePolicy")->text().toInt();
 }
 #endif // QT_GUI_LIB
@@ -12,6 +12,8 @@
 #define __SNOOP_PCAPH_H__
 
 #include <SnoopCapture>
+#include <SnoopTxRing>
+#include <SnoopTxQueue>
 
 #ifdef linux
 typedef void pcap_rmtauth;
@@ -22,6 +24,8 @@ typedef void pcap_rmtauth;
 // ----------------------------------------------------------------------------
 class SnoopPcap : public SnoopCapture
 {
+  friend class SnoopTxQueue;
+
 public:
   SnoopPcap(void* owner = NULL);
   virtual ~SnoopPcap();
@@ -32,6 +36,7 @@ protected:
 
 public:
   virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
   virtual int write(SnoopPacket* packet);
   virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
 
@@ -39,20 +44,40 @@ public:
   virtual SnoopCaptureType captureType() { return SnoopCaptureType::OutOfPath; }
   virtual int              dataLink()    { return m_dataLink; }
   virtual bool             relay(SnoopPacket* packet);
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+  virtual void             flushTx();
 
   //
   // Properties
   //
 public:
   QString  filter;
+  bool     filterPushdown; // also installs SnoopBpFilter expressions of every downstream path as kernel filter
   int      snapLen;
   int      flags;
   int      readTimeout;
+  int      bufferSize;      // kernel buffer bytes(0 : libpcap default)
+  bool     immediateMode;   // deliver packets as soon as they arrive
+  int      tstampPrecision; // 0 : micro, 1 : nano(nanosecond part goes to tsNsec)
+  bool     nonblock;        // read returns 0 at once when no packet
+  bool     batchWrite;      // linux : write queues into PACKET_TX_RING and flushes after each dispatch
+  int      txFrameCount;
+  int      txFlushCount;    // queued frames that force flush
+  int      txQueueSize;     // frames queued for sender thread(0 : write on caller thread)
+  int      txQueuePolicy;   // SnoopTxQueue::Policy(0 : block, 1 : drop newest, 2 : drop oldest)
 
 public:
   pcap*    m_pcap;
 protected:
   int      m_dataLink;
+  bool     m_nsec; // pcap timestamp precision actually set is nano
+#ifdef linux
+  SnoopTxRing* txRing;
+#endif // linux
+public:
+  SnoopTxQueue* txQueue;
+protected:
+  int      doWrite(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr);
 private:
   QString  m_source;
 
@@ -63,7 +88,11 @@ public:
 
 protected:
   bool pcapOpen(char* source, pcap_rmtauth* auth, pcap_if_t* dev);
-  bool pcapProcessFilter(pcap_if_t* dev);
+  bool pcapProcessFilter(pcap_if_t* dev, QString _filter);
+  void pcapFixTstamp(SnoopPacket* packet);
+#ifdef linux
+  bool pcapCreate(char* source);
+#endif // linux
 
 public:
   virtual void load(VXml xml);
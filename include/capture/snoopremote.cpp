@@ -162,3 +162,415 @@ void SnoopRemote::optionSaveDlg(QDialog *dialog)
 #endif // QT_GUI_LIB
 
 #endif // WIN32
+
+#ifdef linux
+
+#include <errno.h>
+#include <endian.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+REGISTER_METACLASS(SnoopRemote, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopRemote
+// ----------------------------------------------------------------------------
+static const int SNOOP_REMOTE_WAIT_TIMEOUT = 5000; // msec, for handshake and the rest of a started batch
+
+SnoopRemote::SnoopRemote(void* owner) : SnoopCapture(owner)
+{
+  host          = "127.0.0.1";
+  port          = SnoopRemoteProto::DEFAULT_PORT;
+  filter        = "";
+  secret        = "";
+  snapLen       = snoop::DEFAULT_SNAPLEN;
+  compress      = false;
+  readTimeout   = snoop::DEFAULT_READTIMEOUT;
+
+  m_sock        = -1;
+  m_linkType    = DLT_EN10MB;
+  m_compress    = false;
+  m_frame       = NULL;
+  m_raw         = NULL;
+  m_rawLen      = 0;
+  m_rawOff      = 0;
+  m_left        = 0;
+  m_serverDrops = 0;
+}
+
+SnoopRemote::~SnoopRemote()
+{
+  close();
+}
+
+bool SnoopRemote::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (host == "")
+  {
+    SET_ERROR(SnoopError, "host is not specified", VERR_HOST_NOT_SPECIFIED);
+    return false;
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* ai = NULL;
+  int res = getaddrinfo(qPrintable(host), qPrintable(QString::number(port)), &hints, &ai);
+  if (res != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in getaddrinfo(%s)(%s)", qPrintable(host), gai_strerror(res)), VERR_CAN_NOT_FIND_HOST);
+    return false;
+  }
+  for (addrinfo* p = ai; p != NULL; p = p->ai_next)
+  {
+    m_sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+    if (m_sock == -1) continue;
+    if (connect(m_sock, p->ai_addr, p->ai_addrlen) == 0) break;
+    ::close(m_sock);
+    m_sock = -1;
+  }
+  freeaddrinfo(ai);
+  if (m_sock == -1)
+  {
+    SET_ERROR(SnoopError, qformat("can not connect to %s:%d(%s)", qPrintable(host), port, strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  int rcvBuf = SnoopRemoteProto::MAX_BATCH;
+  setsockopt(m_sock, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+
+  if (!handshake()) return false;
+
+  m_raw    = new BYTE[SnoopRemoteProto::MAX_BATCH];
+  if (m_compress)
+    m_frame = new BYTE[SnoopRemoteProto::MAX_BATCH];
+  m_rawLen      = 0;
+  m_rawOff      = 0;
+  m_left        = 0;
+  m_serverDrops = 0;
+
+  return SnoopCapture::doOpen();
+}
+
+bool SnoopRemote::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  //
+  // Buffer is referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+
+  if (m_sock != -1)
+  {
+    ::close(m_sock);
+    m_sock = -1;
+  }
+  if (m_raw != NULL)
+  {
+    delete[] m_raw;
+    m_raw = NULL;
+  }
+  if (m_frame != NULL)
+  {
+    delete[] m_frame;
+    m_frame = NULL;
+  }
+  m_left = 0;
+
+  return SnoopCapture::doClose();
+}
+
+bool SnoopRemote::handshake()
+{
+  QByteArray _filter = filter.toLatin1();
+  if (_filter.size() > SnoopRemoteProto::MAX_FILTER)
+  {
+    SET_ERROR(SnoopError, qformat("too long filter(%d)", _filter.size()), VERR_FAIL);
+    return false;
+  }
+  QByteArray _secret = secret.toUtf8();
+  if (_secret.size() > SnoopRemoteProto::MAX_SECRET)
+  {
+    SET_ERROR(SnoopError, qformat("too long secret(%d)", _secret.size()), VERR_FAIL);
+    return false;
+  }
+
+  SNOOP_REMOTE_HELLO hello;
+  hello.magic     = htonl(SnoopRemoteProto::MAGIC);
+  hello.version   = htons(SnoopRemoteProto::VERSION);
+  hello.flags     = htons(compress && SnoopRemoteProto::lz4Supported() ? SnoopRemoteProto::FLAG_LZ4 : 0);
+  hello.snapLen   = htonl((UINT32)snapLen);
+  hello.filterLen = htonl((UINT32)_filter.size());
+  hello.secretLen = htonl((UINT32)_secret.size());
+  if (!SnoopRemoteProto::sendAll(m_sock, &hello, sizeof(hello)) ||
+      !SnoopRemoteProto::sendAll(m_sock, _filter.constData(), _filter.size()) ||
+      !SnoopRemoteProto::sendAll(m_sock, _secret.constData(), _secret.size()))
+  {
+    SET_ERROR(SnoopError, qformat("error in send(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  SNOOP_REMOTE_REPLY reply;
+  if (!SnoopRemoteProto::recvAll(m_sock, &reply, sizeof(reply), SNOOP_REMOTE_WAIT_TIMEOUT) ||
+      ntohl(reply.magic) != SnoopRemoteProto::MAGIC || ntohs(reply.version) != SnoopRemoteProto::VERSION)
+  {
+    SET_ERROR(SnoopError, qformat("no valid reply from %s:%d", qPrintable(host), port), VERR_FAIL);
+    return false;
+  }
+  UINT32 msgLen = ntohl(reply.msgLen);
+  QByteArray msg;
+  if (msgLen > 0 && msgLen <= (UINT32)SnoopRemoteProto::MAX_FILTER)
+  {
+    msg.resize((int)msgLen);
+    if (!SnoopRemoteProto::recvAll(m_sock, msg.data(), (int)msgLen, SNOOP_REMOTE_WAIT_TIMEOUT)) msg.clear();
+  }
+  if (ntohl(reply.status) != 0)
+  {
+    SET_ERROR(SnoopError, qformat("rejected by server(%s)", msg.constData()), VERR_FAIL);
+    return false;
+  }
+
+  m_linkType = (int)ntohl(reply.linkType);
+  m_compress = (ntohs(reply.flags) & SnoopRemoteProto::FLAG_LZ4) != 0;
+  if (m_compress && !SnoopRemoteProto::lz4Supported())
+  {
+    SET_ERROR(SnoopError, "server granted compression not built in(SNOOP_LZ4)", VERR_NOT_SUPPORTED);
+    return false;
+  }
+  if (compress && !SnoopRemoteProto::lz4Supported()) LOG_WARN("compression is not built in(SNOOP_LZ4)");
+  else if (compress && !m_compress) LOG_WARN("server does not support compression");
+  LOG_DEBUG("connected to %s:%d linkType=%d compress=%d", qPrintable(host), port, m_linkType, m_compress);
+  return true;
+}
+
+int SnoopRemote::fetchBatch()
+{
+  pollfd pfd;
+  pfd.fd      = m_sock;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  int n = poll(&pfd, 1, readTimeout);
+  if (n == 0) return 0;
+  if (n < 0)
+  {
+    if (errno == EINTR) return 0;
+    SET_DEBUG_ERROR(SnoopError, qformat("poll return -1(%s)", strerror(errno)), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  SNOOP_REMOTE_BATCH_HDR hdr;
+  if (!SnoopRemoteProto::recvAll(m_sock, &hdr, sizeof(hdr), SNOOP_REMOTE_WAIT_TIMEOUT))
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("connection closed(%s:%d)", qPrintable(host), port), VERR_FAIL);
+    return VERR_FAIL;
+  }
+  int    len    = (int)ntohl(hdr.len);
+  int    rawLen = (int)ntohl(hdr.rawLen);
+  int    count  = (int)ntohl(hdr.count);
+  UINT32 flags  = ntohl(hdr.flags);
+  if (len < 0 || len > SnoopRemoteProto::MAX_BATCH || rawLen < 0 || rawLen > SnoopRemoteProto::MAX_BATCH)
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("invalid batch len=%d rawLen=%d", len, rawLen), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  bool ok;
+  if ((flags & SnoopRemoteProto::FLAG_LZ4) != 0)
+  {
+    ok = m_frame != NULL &&
+      SnoopRemoteProto::recvAll(m_sock, m_frame, len, SNOOP_REMOTE_WAIT_TIMEOUT) &&
+      SnoopRemoteProto::decompress(m_frame, len, m_raw, rawLen);
+  } else
+  {
+    ok = len == rawLen && SnoopRemoteProto::recvAll(m_sock, m_raw, len, SNOOP_REMOTE_WAIT_TIMEOUT);
+  }
+  if (!ok)
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("can not read batch(len=%d rawLen=%d flags=0x%x)", len, rawLen, flags), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  m_rawLen      = rawLen;
+  m_rawOff      = 0;
+  m_left        = count;
+  m_serverDrops = be64toh(hdr.drops);
+  return count > 0 ? 1 : 0; // empty batch only updates drops
+}
+
+bool SnoopRemote::nextPacket(SnoopPacket* packet, PKT_HDR* pktHdr)
+{
+  if (m_left <= 0) return false;
+  if (m_rawOff + (int)sizeof(SNOOP_REMOTE_PKT_HDR) > m_rawLen)
+  {
+    LOG_ERROR("truncated batch(off=%d rawLen=%d)", m_rawOff, m_rawLen);
+    m_left = 0;
+    return false;
+  }
+  SNOOP_REMOTE_PKT_HDR* hdr = (SNOOP_REMOTE_PKT_HDR*)(m_raw + m_rawOff);
+  int caplen = (int)ntohl(hdr->caplen);
+  BYTE* data = (BYTE*)(hdr + 1);
+  if (caplen < 0 || m_rawOff + (int)sizeof(SNOOP_REMOTE_PKT_HDR) + caplen > m_rawLen)
+  {
+    LOG_ERROR("invalid caplen(%d)", caplen);
+    m_left = 0;
+    return false;
+  }
+
+  pktHdr->ts.tv_sec  = (long)ntohl(hdr->tsSec);
+  pktHdr->ts.tv_usec = (long)ntohl(hdr->tsUsec);
+  pktHdr->caplen     = (UINT32)caplen;
+  pktHdr->len        = ntohl(hdr->len);
+  packet->pktHdr     = pktHdr;
+  packet->pktData    = data;
+  packet->linkType   = m_linkType;
+  packet->tsNsec     = ntohl(hdr->tsNsec);
+
+  m_rawOff += (int)sizeof(SNOOP_REMOTE_PKT_HDR) + caplen;
+  m_left--;
+  return true;
+}
+
+int SnoopRemote::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  if (m_left == 0)
+  {
+    int res = fetchBatch();
+    if (res <= 0) return res;
+  }
+
+  packet->clear();
+  if (!nextPacket(packet, &m_pktHdr)) return 0;
+  if (autoParse) parse(packet);
+  return (int)m_pktHdr.caplen;
+}
+
+int SnoopRemote::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  //
+  // Payload is refilled only when every packet of it has gone through the graph.
+  //
+  batch.reserve(max, 0);
+  batch.clear();
+  if (m_left == 0)
+  {
+    int res = fetchBatch();
+    if (res <= 0) return res;
+  }
+  while (batch.count < max && m_left > 0)
+  {
+    SnoopPacket* packet = batch.next();
+    if (!nextPacket(packet, packet->pktHdr))
+    {
+      batch.count--; // give back unused descriptor
+      break;
+    }
+  }
+
+  if (autoParse)
+  {
+    for (int i = 0; i < batch.count; i++)
+      parse(batch.at(i));
+  }
+  return batch.count;
+}
+
+bool SnoopRemote::relay(SnoopPacket* packet)
+{
+  Q_UNUSED(packet)
+  SET_ERROR(SnoopError, "relay not supported", VERR_NOT_SUPPORTED);
+  return false;
+}
+
+bool SnoopRemote::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  if (m_sock == -1) return false;
+  drops   = m_serverDrops; // dropped by server because this side or network lagged
+  ifDrops = 0;
+  return true;
+}
+
+void SnoopRemote::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  host        = xml.getStr("host", host);
+  port        = xml.getInt("port", port);
+  filter      = xml.getStr("filter", filter);
+  secret      = xml.getStr("secret", secret);
+  snapLen     = xml.getInt("snapLen", snapLen);
+  compress    = xml.getBool("compress", compress);
+  readTimeout = xml.getInt("readTimeout", readTimeout);
+}
+
+void SnoopRemote::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setStr("host", host);
+  xml.setInt("port", port);
+  xml.setStr("filter", filter);
+  xml.setStr("secret", secret);
+  xml.setInt("snapLen", snapLen);
+  xml.setBool("compress", compress);
+  xml.setInt("readTimeout", readTimeout);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopRemote::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leHost",        "Host",         host);
+  VOptionable::addLineEdit(layout, "lePort",        "Port",         QString::number(port));
+  VOptionable::addLineEdit(layout, "leFilter",      "Filter",       filter);
+  VOptionable::addLineEdit(layout, "leSecret",      "Secret",       secret);
+  VOptionable::addLineEdit(layout, "leSnapLen",     "Snap Len",     QString::number(snapLen));
+  VOptionable::addCheckBox(layout, "chkCompress",   "Compress",     compress);
+  VOptionable::addLineEdit(layout, "leReadTimeout", "Read Timeout", QString::number(readTimeout));
+}
+
+void SnoopRemote::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  host        = dialog->findChild<QLineEdit*>("leHost")->text();
+  port        = dialog->findChild<QLineEdit*>("lePort")->text().toInt();
+  filter      = dialog->findChild<QLineEdit*>("leFilter")->text();
+  secret      = dialog->findChild<QLineEdit*>("leSecret")->text();
+  snapLen     = dialog->findChild<QLineEdit*>("leSnapLen")->text().toInt();
+  compress    = dialog->findChild<QCheckBox*>("chkCompress")->checkState() == Qt::Checked;
+  readTimeout = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
@@ -13,6 +13,7 @@
 
 #include <SnoopPcap>
 #include <SnoopInterface>
+#include <SnoopRemoteProto>
 
 #ifdef WIN32
 
@@ -56,4 +57,74 @@ public: // for VOptionable
 
 #endif // WIN32
 
+#ifdef linux
+
+// ----------------------------------------------------------------------------
+// SnoopRemote
+// ----------------------------------------------------------------------------
+/// Reads packets from SnoopRemoteServer running on another host(sscon graph).
+/// Packets come in batches over one TCP stream, filtered by server and optionally LZ4 compressed.
+class SnoopRemote : public SnoopCapture
+{
+public:
+  SnoopRemote(void* owner = NULL);
+  virtual ~SnoopRemote();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::OutOfPath; }
+  virtual int              dataLink()    { return m_linkType; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  QString host;
+  int     port;
+  QString filter;   // BPF filter evaluated by server
+  QString secret;   // shared secret of server(SnoopRemoteServer::secret)
+  int     snapLen;
+  bool    compress; // LZ4(granted only if server is built with SNOOP_LZ4)
+  int     readTimeout;
+
+public:
+  int     m_sock;
+protected:
+  int     m_linkType;
+  bool    m_compress;    // granted by server
+  BYTE*   m_frame;       // compressed payload
+  BYTE*   m_raw;         // payload being read
+  int     m_rawLen;
+  int     m_rawOff;
+  int     m_left;        // packets left in m_raw
+  UINT64  m_serverDrops;
+  PKT_HDR m_pktHdr;      // for read()
+
+protected:
+  bool handshake();
+  int  fetchBatch();
+  bool nextPacket(SnoopPacket* packet, PKT_HDR* pktHdr);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
 #endif // __SNOOP_REMOTE_H__
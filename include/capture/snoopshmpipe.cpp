@@ -0,0 +1,227 @@
+#include <SnoopShmPipe>
+#include <VTick>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <unistd.h>
+
+REGISTER_METACLASS(SnoopShmPipe, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopShmPipe
+// ----------------------------------------------------------------------------
+SnoopShmPipe::SnoopShmPipe(void* owner) : SnoopCapture(owner)
+{
+  pipeName    = "snoop";
+  pipeSize    = 64 * 1024 * 1024; // 64 MB
+  spinCount   = 1000;
+  readTimeout = snoop::DEFAULT_READTIMEOUT;
+  unlinkOnClose = true;
+  m_linkType  = DLT_EN10MB;
+}
+
+SnoopShmPipe::~SnoopShmPipe()
+{
+  close();
+}
+
+bool SnoopShmPipe::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  m_ring.name = pipeName;
+  m_ring.size = pipeSize;
+  m_ring.unlinkOnClose = unlinkOnClose;
+  if (!m_ring.open(true))
+  {
+    error = m_ring.error;
+    return false;
+  }
+  m_linkType = DLT_EN10MB;
+
+  return SnoopCapture::doOpen();
+}
+
+bool SnoopShmPipe::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  //
+  // Ring memory is referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+  m_ring.close();
+
+  return SnoopCapture::doClose();
+}
+
+void SnoopShmPipe::fill(SnoopPacket* packet, PKT_HDR* pktHdr, SNOOP_SHM_REC_HDR* rec, BYTE* data)
+{
+  pktHdr->ts.tv_sec  = (long)rec->tsSec;
+  pktHdr->ts.tv_usec = (long)rec->tsUsec;
+  pktHdr->caplen     = rec->caplen;
+  pktHdr->len        = rec->origLen;
+  packet->pktHdr     = pktHdr;
+  packet->pktData    = data;
+  packet->linkType   = (int)rec->linkType;
+  packet->tsNsec     = rec->tsNsec;
+  m_linkType         = (int)rec->linkType;
+}
+
+bool SnoopShmPipe::waitRecord(SNOOP_SHM_REC_HDR** rec, BYTE** data)
+{
+  //
+  // Spin first so that a busy writer is followed without syscall, then sleep in 100 usec steps.
+  //
+  for (int i = 0; i < spinCount; i++)
+  {
+    if (m_ring.next(rec, data)) return true;
+  }
+  VTick end = tick() + (VTick)readTimeout;
+  while (tick() < end)
+  {
+    if (m_state != VState::Opened) return false;
+    if (m_ring.next(rec, data)) return true;
+    usleep(100);
+  }
+  return false;
+}
+
+int SnoopShmPipe::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  //
+  // Previous packet has gone through the graph, so its record can be given back to writer.
+  //
+  m_ring.release();
+
+  SNOOP_SHM_REC_HDR* rec;
+  BYTE*              data;
+  if (!waitRecord(&rec, &data))
+  {
+    if (!m_ring.corrupted()) return 0;
+    error = m_ring.error;
+    return VERR_FAIL;
+  }
+
+  packet->clear();
+  fill(packet, &m_pktHdr, rec, data);
+  if (autoParse) parse(packet);
+  return (int)m_pktHdr.caplen;
+}
+
+int SnoopShmPipe::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  m_ring.release();
+
+  batch.reserve(max, 0);
+  batch.clear();
+
+  SNOOP_SHM_REC_HDR* rec;
+  BYTE*              data;
+  if (!waitRecord(&rec, &data))
+  {
+    if (!m_ring.corrupted()) return 0;
+    error = m_ring.error;
+    return VERR_FAIL;
+  }
+  do
+  {
+    SnoopPacket* packet = batch.next();
+    fill(packet, packet->pktHdr, rec, data);
+  } while (batch.count < max && m_ring.next(&rec, &data));
+
+  if (autoParse)
+  {
+    for (int i = 0; i < batch.count; i++)
+      parse(batch.at(i));
+  }
+  return batch.count;
+}
+
+bool SnoopShmPipe::relay(SnoopPacket* packet)
+{
+  Q_UNUSED(packet)
+  SET_ERROR(SnoopError, "relay not supported", VERR_NOT_SUPPORTED);
+  return false;
+}
+
+bool SnoopShmPipe::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  if (!m_ring.active()) return false;
+  drops   = m_ring.drops(); // writer could not push because this side lagged
+  ifDrops = 0;
+  return true;
+}
+
+void SnoopShmPipe::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  pipeName    = xml.getStr("pipeName", pipeName);
+  pipeSize    = xml.getInt("pipeSize", pipeSize);
+  spinCount   = xml.getInt("spinCount", spinCount);
+  readTimeout = xml.getInt("readTimeout", readTimeout);
+  unlinkOnClose = xml.getBool("unlinkOnClose", unlinkOnClose);
+}
+
+void SnoopShmPipe::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setStr("pipeName", pipeName);
+  xml.setInt("pipeSize", pipeSize);
+  xml.setInt("spinCount", spinCount);
+  xml.setInt("readTimeout", readTimeout);
+  xml.setBool("unlinkOnClose", unlinkOnClose);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopShmPipe::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "lePipeName",    "Pipe Name",    pipeName);
+  VOptionable::addLineEdit(layout, "lePipeSize",    "Pipe Size",    QString::number(pipeSize));
+  VOptionable::addLineEdit(layout, "leSpinCount",   "Spin Count",   QString::number(spinCount));
+  VOptionable::addLineEdit(layout, "leReadTimeout", "Read Timeout", QString::number(readTimeout));
+  VOptionable::addCheckBox(layout, "chkUnlinkOnClose", "Unlink On Close", unlinkOnClose);
+}
+
+void SnoopShmPipe::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  pipeName    = dialog->findChild<QLineEdit*>("lePipeName")->text();
+  pipeSize    = dialog->findChild<QLineEdit*>("lePipeSize")->text().toInt();
+  spinCount   = dialog->findChild<QLineEdit*>("leSpinCount")->text().toInt();
+  readTimeout = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+  unlinkOnClose = dialog->findChild<QCheckBox*>("chkUnlinkOnClose")->checkState() == Qt::Checked;
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
@@ -0,0 +1,76 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_SHM_PIPE_H__
+#define __SNOOP_SHM_PIPE_H__
+
+#include <SnoopCapture>
+#include <SnoopShmRing>
+
+#ifdef linux
+
+// ----------------------------------------------------------------------------
+// SnoopShmPipe
+// ----------------------------------------------------------------------------
+/// Reads packets pushed by SnoopShmPipeWriter(possibly in another process) through shared memory ring.
+/// Packets are handed over without copy and without syscall while ring is not empty.
+class SnoopShmPipe : public SnoopCapture
+{
+public:
+  SnoopShmPipe(void* owner = NULL);
+  virtual ~SnoopShmPipe();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::OutOfPath; }
+  virtual int              dataLink()    { return m_linkType; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  QString pipeName;    // shared memory object name(/dev/shm/pipeName)
+  int     pipeSize;    // ring data bytes, must be the same as writer
+  int     spinCount;   // empty polls before sleeping
+  int     readTimeout;
+  bool    unlinkOnClose; // remove shared memory object on close(writer keeps its mapping until it closes)
+
+protected:
+  SnoopShmRing m_ring;
+  int          m_linkType;
+  PKT_HDR      m_pktHdr; // for read()
+
+protected:
+  void fill(SnoopPacket* packet, PKT_HDR* pktHdr, SNOOP_SHM_REC_HDR* rec, BYTE* data);
+  bool waitRecord(SNOOP_SHM_REC_HDR** rec, BYTE** data);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_SHM_PIPE_H__
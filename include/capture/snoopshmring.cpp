@@ -0,0 +1,203 @@
+#include <SnoopShmRing>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// SnoopShmRing
+// ----------------------------------------------------------------------------
+SnoopShmRing::SnoopShmRing()
+{
+  name      = "snoop";
+  size      = 64 * 1024 * 1024; // 64 MB
+  unlinkOnClose = false;
+  m_hdr     = NULL;
+  m_data    = NULL;
+  m_mapSize = 0;
+  m_mask    = 0;
+  m_pos     = 0;
+  m_corrupted = false;
+}
+
+SnoopShmRing::~SnoopShmRing()
+{
+  close();
+}
+
+bool SnoopShmRing::open(bool consumer)
+{
+  UINT64 capacity = 4096;
+  while (capacity < (UINT64)size) capacity <<= 1;
+
+  QString shmName = "/" + name;
+  int fd = shm_open(qPrintable(shmName), O_RDWR | O_CREAT, 0600);
+  if (fd == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in shm_open(%s)(%s)", qPrintable(shmName), strerror(errno)), VERR_FAIL);
+    return false;
+  }
+
+  //
+  // Whichever side comes first sizes the memory, the other side must ask for the same size.
+  //
+  size_t mapSize = sizeof(SNOOP_SHM_RING_HDR) + (size_t)capacity;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (st.st_size == 0 && ftruncate(fd, (off_t)mapSize) == -1))
+  {
+    SET_ERROR(SnoopError, qformat("error in ftruncate(%s)(%s)", qPrintable(shmName), strerror(errno)), VERR_FAIL);
+    ::close(fd);
+    return false;
+  }
+  if (st.st_size != 0 && (size_t)st.st_size != mapSize)
+  {
+    SET_ERROR(SnoopError, qformat("size mismatch(%s) %lu != %lu", qPrintable(shmName), (unsigned long)st.st_size, (unsigned long)mapSize), VERR_INVALID_RING_SIZE);
+    ::close(fd);
+    return false;
+  }
+
+  void* p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+  {
+    SET_ERROR(SnoopError, qformat("error in mmap(%s)", strerror(errno)), VERR_IN_MMAP);
+    return false;
+  }
+  m_hdr     = (SNOOP_SHM_RING_HDR*)p;
+  m_data    = (BYTE*)p + sizeof(SNOOP_SHM_RING_HDR);
+  m_mapSize = mapSize;
+  m_mask    = capacity - 1;
+  m_corrupted = false;
+
+  if (m_hdr->magic != MAGIC)
+  {
+    m_hdr->version  = VERSION;
+    m_hdr->capacity = capacity;
+    m_hdr->head     = 0;
+    m_hdr->tail     = 0;
+    m_hdr->written  = 0;
+    m_hdr->drops    = 0;
+    __sync_synchronize();
+    m_hdr->magic    = MAGIC;
+  }
+  if (m_hdr->version != VERSION || m_hdr->capacity != capacity)
+  {
+    SET_ERROR(SnoopError, qformat("incompatible ring(%s)", qPrintable(shmName)), VERR_INVALID_RING_SIZE);
+    close();
+    return false;
+  }
+
+  if (consumer)
+  {
+    //
+    // Records left by a previous consumer run are skipped.
+    //
+    m_pos = m_hdr->head;
+    __sync_synchronize();
+    m_hdr->tail = m_pos;
+  } else
+    m_pos = m_hdr->head;
+  return true;
+}
+
+void SnoopShmRing::close()
+{
+  if (m_hdr != NULL)
+  {
+    munmap(m_hdr, m_mapSize);
+    m_hdr = NULL;
+    if (unlinkOnClose && shm_unlink(qPrintable("/" + name)) == -1 && errno != ENOENT)
+      LOG_WARN("error in shm_unlink(%s)(%s)", qPrintable(name), strerror(errno));
+  }
+  m_data    = NULL;
+  m_mapSize = 0;
+}
+
+bool SnoopShmRing::push(SnoopPacket* packet)
+{
+  UINT32 caplen   = packet->pktHdr->caplen;
+  UINT64 capacity = m_mask + 1;
+  UINT64 need     = ((UINT64)sizeof(SNOOP_SHM_REC_HDR) + caplen + ALIGN - 1) / ALIGN * ALIGN;
+  UINT64 off      = m_pos & m_mask;
+  UINT64 pad      = need > capacity - off ? capacity - off : 0; // record never wraps
+
+  UINT64 tail = m_hdr->tail;
+  __sync_synchronize();
+  if (need > capacity / 2 || m_pos + pad + need - tail > capacity)
+  {
+    m_hdr->drops++;
+    return false;
+  }
+
+  if (pad != 0)
+  {
+    SNOOP_SHM_REC_HDR* padRec = (SNOOP_SHM_REC_HDR*)(m_data + off);
+    padRec->len    = (UINT32)pad;
+    padRec->caplen = PAD_REC;
+    m_pos += pad;
+    off    = 0;
+  }
+
+  SNOOP_SHM_REC_HDR* rec = (SNOOP_SHM_REC_HDR*)(m_data + off);
+  rec->len      = (UINT32)need;
+  rec->caplen   = caplen;
+  rec->origLen  = packet->pktHdr->len;
+  rec->linkType = (UINT32)packet->linkType;
+  rec->tsSec    = (INT64)packet->pktHdr->ts.tv_sec;
+  rec->tsUsec   = (UINT32)packet->pktHdr->ts.tv_usec;
+  rec->tsNsec   = packet->tsNsec;
+  memcpy((BYTE*)(rec + 1), packet->pktData, caplen);
+  m_pos += need;
+
+  __sync_synchronize(); // record must be visible before head
+  m_hdr->head = m_pos;
+  m_hdr->written++;
+  return true;
+}
+
+bool SnoopShmRing::next(SNOOP_SHM_REC_HDR** rec, BYTE** data)
+{
+  if (m_corrupted) return false;
+  while (true)
+  {
+    UINT64 head = m_hdr->head;
+    __sync_synchronize();
+    if (m_pos == head) return false;
+
+    //
+    // Memory is shared with another process, so a record is checked before it is used.
+    // A record never wraps and never goes past head.
+    //
+    UINT64 off  = m_pos & m_mask;
+    SNOOP_SHM_REC_HDR* _rec = (SNOOP_SHM_REC_HDR*)(m_data + off);
+    UINT32 len    = _rec->len;
+    UINT32 caplen = _rec->caplen;
+    bool   valid  = len >= ALIGN && len % ALIGN == 0 && (UINT64)len <= m_mask + 1 - off && (UINT64)len <= head - m_pos;
+    if (valid && caplen != PAD_REC) valid = caplen <= len - sizeof(SNOOP_SHM_REC_HDR);
+    if (!valid)
+    {
+      SET_ERROR(SnoopError, qformat("corrupted ring(%s) len=%u caplen=%u at %llu", qPrintable(name), len, caplen, (unsigned long long)m_pos), VERR_INVALID_RING_SIZE);
+      m_corrupted = true;
+      return false;
+    }
+    m_pos += len;
+    if (caplen == PAD_REC) continue;
+    *rec  = _rec;
+    *data = (BYTE*)(_rec + 1);
+    return true;
+  }
+}
+
+void SnoopShmRing::release()
+{
+  if (m_hdr->tail == m_pos) return;
+  __sync_synchronize(); // reads of records must complete before producer reuses them
+  m_hdr->tail = m_pos;
+}
+
+#endif // linux
@@ -0,0 +1,108 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_SHM_RING_H__
+#define __SNOOP_SHM_RING_H__
+
+#include <SnoopPacket>
+
+#ifdef linux
+
+// ----------------------------------------------------------------------------
+// SNOOP_SHM_RING_HDR
+// ----------------------------------------------------------------------------
+#pragma pack(push, 1)
+typedef struct
+{
+  UINT32          magic;
+  UINT32          version;
+  UINT64          capacity; // data bytes(power of 2)
+  UINT8           pad0[48];
+  volatile UINT64 head;     // written only by producer
+  UINT8           pad1[56];
+  volatile UINT64 tail;     // written only by consumer
+  UINT8           pad2[56];
+  volatile UINT64 written;  // packets pushed
+  volatile UINT64 drops;    // packets dropped because consumer lags
+  UINT8           pad3[48];
+} SNOOP_SHM_RING_HDR;
+
+// ----------------------------------------------------------------------------
+// SNOOP_SHM_REC_HDR
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  UINT32 len;      // record bytes including this header(multiple of sizeof(SNOOP_SHM_REC_HDR))
+  UINT32 caplen;   // PAD_REC : skip to ring start
+  UINT32 origLen;
+  UINT32 linkType;
+  INT64  tsSec;
+  UINT32 tsUsec;
+  UINT32 tsNsec;
+} SNOOP_SHM_REC_HDR;
+#pragma pack(pop)
+
+// ----------------------------------------------------------------------------
+// SnoopShmRing
+// ----------------------------------------------------------------------------
+/// Single producer single consumer packet ring in POSIX shared memory(/dev/shm/name).
+/// Fast path has no syscall : positions are published with memory barriers only.
+class SnoopShmRing
+{
+public:
+  static const UINT32 MAGIC   = 0x534E5352; // "SNSR"
+  static const UINT32 VERSION = 1;
+  static const UINT32 PAD_REC = 0xFFFFFFFF;
+  static const UINT32 ALIGN   = sizeof(SNOOP_SHM_REC_HDR); // record alignment
+
+public:
+  SnoopShmRing();
+  virtual ~SnoopShmRing();
+
+public:
+  QString name;
+  int     size;          // data bytes, rounded up to power of 2
+  bool    unlinkOnClose; // remove /dev/shm/name on close(a side still attached keeps its mapping)
+
+public:
+  VError  error;
+  bool    open(bool consumer);
+  void    close();
+  bool    active() { return m_hdr != NULL; }
+
+public:
+  //
+  // Producer
+  //
+  bool    push(SnoopPacket* packet);
+
+  //
+  // Consumer. Records taken by next() stay valid until release().
+  //
+  bool    next(SNOOP_SHM_REC_HDR** rec, BYTE** data); // false on empty ring or corruption
+  void    release();
+  bool    corrupted() { return m_corrupted; } // a record failed the checks of next(error is set)
+
+public:
+  UINT64  written() { return m_hdr == NULL ? 0 : m_hdr->written; }
+  UINT64  drops()   { return m_hdr == NULL ? 0 : m_hdr->drops;   }
+
+protected:
+  SNOOP_SHM_RING_HDR* m_hdr;
+  BYTE*               m_data;
+  size_t              m_mapSize;
+  UINT64              m_mask;
+  UINT64              m_pos; // producer : head, consumer : read position not yet released
+  bool                m_corrupted;
+};
+
+#endif // linux
+
+#endif // __SNOOP_SHM_RING_H__
@@ -0,0 +1,406 @@
+#include <SnoopTun>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/if_tun.h>
+
+REGISTER_METACLASS(SnoopTun, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopTun
+// ----------------------------------------------------------------------------
+SnoopTun::SnoopTun(void* owner) : SnoopCapture(owner)
+{
+  devName     = "snoop%d";
+  tap         = false;
+  queueCount  = 1;
+  vnetHdr     = true;
+  autoUp      = true;
+  readTimeout = snoop::DEFAULT_READTIMEOUT;
+
+  m_devName   = "";
+  fanout      = NULL;
+
+  m_fd        = -1;
+  m_pktData   = NULL;
+  m_lastData  = NULL;
+  memset(&m_vnet, 0, sizeof(m_vnet));
+}
+
+SnoopTun::~SnoopTun()
+{
+  close();
+}
+
+bool SnoopTun::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  m_fd = ::open("/dev/net/tun", O_RDWR);
+  if (m_fd == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in open(/dev/net/tun)(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  //
+  // Every queue of a multi queue device must be attached with the same flags.
+  //
+  ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = (tap ? IFF_TAP : IFF_TUN) | IFF_NO_PI;
+  if (queueCount > 1) ifr.ifr_flags |= IFF_MULTI_QUEUE;
+  if (vnetHdr)        ifr.ifr_flags |= IFF_VNET_HDR;
+  strncpy(ifr.ifr_name, qPrintable(devName), IFNAMSIZ - 1);
+  if (ioctl(m_fd, TUNSETIFF, &ifr) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in ioctl(TUNSETIFF)(%s)(%s)", qPrintable(devName), strerror(errno)), VERR_IN_BIND);
+    return false;
+  }
+  m_devName = ifr.ifr_name;
+  LOG_DEBUG("device=%s queue=%d", qPrintable(m_devName), workerIndex);
+
+  if (vnetHdr)
+  {
+    int size = (int)sizeof(virtio_net_hdr);
+    if (ioctl(m_fd, TUNSETVNETHDRSZ, &size) == -1)
+    {
+      SET_ERROR(SnoopError, qformat("error in ioctl(TUNSETVNETHDRSZ)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+      return false;
+    }
+    //
+    // Kernel may then hand over unsegmented TCP and frames whose checksum is left to the device.
+    //
+    unsigned int offload = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+    if (ioctl(m_fd, TUNSETOFFLOAD, offload) == -1)
+    {
+      LOG_WARN("ioctl(TUNSETOFFLOAD) return -1(%s)", strerror(errno));
+    }
+  }
+
+  if (!replica && autoUp && !bringUp()) return false;
+
+  m_pktData  = new BYTE[MAXBUF];
+  m_lastData = NULL;
+
+  if (!SnoopCapture::doOpen()) return false;
+
+  if (!replica && queueCount > 1)
+  {
+    fanout = new SnoopFanout(this);
+    if (!fanout->open(queueCount, prepareWorker))
+    {
+      error = fanout->error;
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnoopTun::prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex)
+{
+  SnoopTun* primary = (SnoopTun*)capture;
+  SnoopTun* replica = (SnoopTun*)worker;
+  Q_UNUSED(workerIndex)
+  replica->devName = primary->m_devName; // attach to the device primary got
+}
+
+bool SnoopTun::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  SAFE_DELETE(fanout);
+
+  //
+  // Buffer is referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+
+  if (m_fd != -1)
+  {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  if (m_pktData != NULL)
+  {
+    delete[] m_pktData;
+    m_pktData = NULL;
+  }
+  m_lastData = NULL;
+  m_devName  = "";
+
+  return SnoopCapture::doClose();
+}
+
+bool SnoopTun::bringUp()
+{
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in socket(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+  ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, qPrintable(m_devName), IFNAMSIZ - 1);
+  bool res = ioctl(sock, SIOCGIFFLAGS, &ifr) != -1;
+  if (res)
+  {
+    ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+    res = ioctl(sock, SIOCSIFFLAGS, &ifr) != -1;
+  }
+  if (!res)
+    SET_ERROR(SnoopError, qformat("can not bring up device(%s)(%s)", qPrintable(m_devName), strerror(errno)), VERR_IN_SETSOCKOPT);
+  ::close(sock);
+  return res;
+}
+
+int SnoopTun::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+
+  pollfd pfd;
+  pfd.fd      = m_fd;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  int n = poll(&pfd, 1, readTimeout);
+  if (n == 0) return 0;
+  if (n < 0)
+  {
+    if (errno == EINTR) return 0;
+    SET_DEBUG_ERROR(SnoopError, qformat("poll return -1(%s)", strerror(errno)), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  int _offset = offset();
+  iovec iov[2];
+  int   iovCnt = 0;
+  if (vnetHdr)
+  {
+    iov[iovCnt].iov_base = &m_vnet;
+    iov[iovCnt].iov_len  = sizeof(m_vnet);
+    iovCnt++;
+  }
+  iov[iovCnt].iov_base = m_pktData + _offset;
+  iov[iovCnt].iov_len  = (size_t)(MAXBUF - _offset);
+  iovCnt++;
+
+  ssize_t len = readv(m_fd, iov, iovCnt);
+  if (len < 0)
+  {
+    if (errno == EAGAIN || errno == EINTR) return 0;
+    SET_DEBUG_ERROR(SnoopError, qformat("readv return -1(%s)", strerror(errno)), VERR_FAIL);
+    return VERR_FAIL;
+  }
+  if (vnetHdr) len -= (ssize_t)sizeof(m_vnet); else memset(&m_vnet, 0, sizeof(m_vnet));
+  if (len <= 0) return 0;
+
+  if (!tap)
+  {
+    ETH_HDR* ethHdr     = (ETH_HDR*)m_pktData;
+    ethHdr->ether_dhost = Mac::cleanMac();
+    ethHdr->ether_shost = Mac::cleanMac();
+    ethHdr->ether_type  = htons((m_pktData[_offset] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP);
+  }
+
+  packet->clear();
+  m_pktHdr.caplen = (UINT32)(len + _offset);
+  m_pktHdr.len    = m_pktHdr.caplen;
+  gettimeofday(&m_pktHdr.ts, NULL);
+  packet->pktHdr   = &m_pktHdr;
+  packet->pktData  = m_pktData;
+  packet->linkType = dataLink();
+  m_lastData       = m_pktData;
+  if (autoParse) parse(packet);
+
+  return (int)m_pktHdr.caplen;
+}
+
+int SnoopTun::send(virtio_net_hdr* vnet, BYTE* buf, int size)
+{
+  int _offset = offset();
+  if (size <= _offset)
+  {
+    SET_ERROR(SnoopError, qformat("too small packet(%d)", size), VERR_FAIL);
+    return VERR_FAIL;
+  }
+
+  iovec iov[2];
+  int   iovCnt = 0;
+  if (vnetHdr)
+  {
+    iov[iovCnt].iov_base = vnet;
+    iov[iovCnt].iov_len  = sizeof(virtio_net_hdr);
+    iovCnt++;
+  }
+  iov[iovCnt].iov_base = buf + _offset;
+  iov[iovCnt].iov_len  = (size_t)(size - _offset);
+  iovCnt++;
+
+  ssize_t res = writev(m_fd, iov, iovCnt);
+  if (res < 0)
+  {
+    LOG_ERROR("writev return -1(%s)", strerror(errno));
+    return VERR_FAIL;
+  }
+  return size;
+}
+
+void SnoopTun::seedChecksum(SnoopPacket* packet)
+{
+  //
+  // Checksum partial frame carries only pseudo header sum in its checksum field and device(kernel) finishes it.
+  // A process may have recalculated full checksum, so pseudo header sum is put back here.
+  // Checksum field is found by csum_start and csum_offset of vnet header, so IPv6 needs no parsing of extension headers.
+  //
+  int    _offset = offset();
+  int    size    = (int)packet->pktHdr->caplen - _offset;
+  UINT32 start   = m_vnet.csum_start;
+  UINT32 field   = start + m_vnet.csum_offset;
+  if (size <= (int)sizeof(ETH_HDR) - _offset || field + 2 > (UINT32)size) return;
+
+  BYTE*  frame = packet->pktData + _offset;
+  BYTE*  ip    = packet->pktData + sizeof(ETH_HDR); // tun frame has a made up ethernet header
+  UINT16 type  = ntohs(((ETH_HDR*)packet->pktData)->ether_type);
+  BYTE*  addr;
+  int    addrLen;
+  UINT32 proto;
+  INT64  l4Len;
+  if (type == ETHERTYPE_IP && (ip[0] >> 4) == 4)
+  {
+    IP_HDR* ipHdr = (IP_HDR*)ip;
+    addr    = ip + 12; // ip_src, ip_dst
+    addrLen = 8;
+    proto   = ipHdr->ip_p;
+    l4Len   = (INT64)ntohs(ipHdr->ip_len) - (frame + start - ip);
+  } else
+  if (type == ETHERTYPE_IPV6 && (ip[0] >> 4) == 6)
+  {
+    UINT16 payloadLen;
+    memcpy(&payloadLen, ip + 4, 2);
+    addr    = ip + 8; // source, destination
+    addrLen = 32;
+    proto   = m_vnet.csum_offset == 16 ? IPPROTO_TCP : IPPROTO_UDP; // next header may be an extension header
+    l4Len   = (INT64)ntohs(payloadLen) + 40 - (frame + start - ip);
+  } else
+    return;
+  if (frame + start < ip || addr + addrLen > frame + size || l4Len < 0) return;
+
+  UINT32 sum = 0;
+  for (int i = 0; i < addrLen; i += 2)
+    sum += ((UINT32)addr[i] << 8) | addr[i + 1];
+  sum += proto;
+  sum += (UINT32)l4Len;
+  while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+
+  UINT16 value = htons((UINT16)sum);
+  memcpy(frame + field, &value, 2);
+}
+
+int SnoopTun::write(SnoopPacket* packet)
+{
+  return write(packet->pktData, packet->pktHdr->caplen);
+}
+
+int SnoopTun::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  Q_UNUSED(divertAddr)
+  virtio_net_hdr vnet;
+  memset(&vnet, 0, sizeof(vnet)); // complete frame(VIRTIO_NET_HDR_GSO_NONE)
+  return send(&vnet, buf, size);
+}
+
+bool SnoopTun::relay(SnoopPacket* packet)
+{
+  //
+  // The packet read last goes back with its own vnet header, so GSO packet is segmented by kernel on the way out.
+  //
+  virtio_net_hdr  vnet;
+  virtio_net_hdr* _vnet = &vnet;
+  memset(&vnet, 0, sizeof(vnet));
+  if (packet->pktData == m_lastData)
+  {
+    _vnet = &m_vnet;
+    if ((m_vnet.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) != 0) seedChecksum(packet);
+  }
+  return send(_vnet, packet->pktData, (int)packet->pktHdr->caplen) != VERR_FAIL;
+}
+
+void SnoopTun::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  devName     = xml.getStr("devName", devName);
+  tap         = xml.getBool("tap", tap);
+  queueCount  = xml.getInt("queueCount", queueCount);
+  vnetHdr     = xml.getBool("vnetHdr", vnetHdr);
+  autoUp      = xml.getBool("autoUp", autoUp);
+  readTimeout = xml.getInt("readTimeout", readTimeout);
+}
+
+void SnoopTun::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setStr("devName", devName);
+  xml.setBool("tap", tap);
+  xml.setInt("queueCount", queueCount);
+  xml.setBool("vnetHdr", vnetHdr);
+  xml.setBool("autoUp", autoUp);
+  xml.setInt("readTimeout", readTimeout);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopTun::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leDevName",     "Dev Name",     devName);
+  VOptionable::addCheckBox(layout, "chkTap",        "Tap",          tap);
+  VOptionable::addLineEdit(layout, "leQueueCount",  "Queue Count",  QString::number(queueCount));
+  VOptionable::addCheckBox(layout, "chkVnetHdr",    "Vnet Hdr",     vnetHdr);
+  VOptionable::addCheckBox(layout, "chkAutoUp",     "Auto Up",      autoUp);
+  VOptionable::addLineEdit(layout, "leReadTimeout", "Read Timeout", QString::number(readTimeout));
+}
+
+void SnoopTun::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  devName     = dialog->findChild<QLineEdit*>("leDevName")->text();
+  tap         = dialog->findChild<QCheckBox*>("chkTap")->checkState() == Qt::Checked;
+  queueCount  = dialog->findChild<QLineEdit*>("leQueueCount")->text().toInt();
+  vnetHdr     = dialog->findChild<QCheckBox*>("chkVnetHdr")->checkState() == Qt::Checked;
+  autoUp      = dialog->findChild<QCheckBox*>("chkAutoUp")->checkState() == Qt::Checked;
+  readTimeout = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_TUN_H__
+#define __SNOOP_TUN_H__
+
+#include <SnoopCapture>
+#include <SnoopFanout>
+
+#ifdef linux
+
+#include <linux/virtio_net.h>
+
+// ----------------------------------------------------------------------------
+// SnoopTun
+// ----------------------------------------------------------------------------
+/// Linux TUN/TAP in-path device. Traffic routed into the device is read, and relay or write puts it back.
+/// queueCount > 1 attaches IFF_MULTI_QUEUE queues, each read by its own graph replica(thread).
+/// With vnetHdr, GSO packets and checksum-partial frames come up whole(up to 64 KB).
+class SnoopTun : public SnoopCapture
+{
+public:
+  SnoopTun(void* owner = NULL);
+  virtual ~SnoopTun();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int write(SnoopPacket* packet);
+  virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::InPath; }
+  virtual int              dataLink()    { return DLT_EN10MB; }
+  virtual bool             relay(SnoopPacket* packet);
+
+  //
+  // Properties
+  //
+public:
+  QString devName;    // "snoop%d" lets kernel choose
+  bool    tap;        // false : TUN(layer 3, clean ethernet header is put in front)
+  int     queueCount; // IFF_MULTI_QUEUE queues, one graph replica per extra queue
+  bool    vnetHdr;    // IFF_VNET_HDR with checksum and TSO offload
+  bool    autoUp;     // bring the device up on open
+  int     readTimeout;
+
+protected:
+  QString      m_devName; // name given by kernel
+  SnoopFanout* fanout;
+  static void  prepareWorker(SnoopCapture* capture, SnoopCapture* worker, int workerIndex);
+
+public:
+  int     m_fd;
+protected:
+  static const int MAXBUF = 0x10000 + sizeof(ETH_HDR);
+  BYTE*           m_pktData;
+  PKT_HDR         m_pktHdr;
+  virtio_net_hdr  m_vnet;     // of the packet read last
+  BYTE*           m_lastData; // pktData of the packet read last
+
+protected:
+  int  offset() { return tap ? 0 : (int)sizeof(ETH_HDR); }
+  int  send(virtio_net_hdr* vnet, BYTE* buf, int size);
+  void seedChecksum(SnoopPacket* packet);
+  bool bringUp();
+
+public:
+  QString devNameOpened() { return m_devName; }
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_TUN_H__
@@ -0,0 +1,233 @@
+#include <SnoopTxQueue>
+#include <SnoopPcap>
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// SnoopTxQueue
+// ----------------------------------------------------------------------------
+SnoopTxQueue::SnoopTxQueue(SnoopPcap* pcap) : VThread(pcap)
+{
+  this->pcap = pcap;
+  capacity   = 1024;
+  slotSize   = 2048;
+  policy     = Block;
+  queued     = 0;
+  sent       = 0;
+  sendErrors = 0;
+  blocked    = 0;
+  dropNewest = 0;
+  dropOldest = 0;
+  cells      = NULL;
+  arena      = NULL;
+  m_mask     = 0;
+  m_tail     = 0;
+  m_head     = 0;
+  m_idle     = 0;
+  m_waiters  = 0;
+  m_stop     = false;
+}
+
+SnoopTxQueue::~SnoopTxQueue()
+{
+  close();
+}
+
+bool SnoopTxQueue::open()
+{
+  UINT32 _capacity = 2;
+  while (_capacity < (UINT32)capacity) _capacity <<= 1;
+  capacity = (int)_capacity;
+  m_mask   = _capacity - 1;
+
+  cells = new SnoopTxQueueCell[_capacity];
+  arena = new BYTE[(size_t)_capacity * (size_t)slotSize];
+  for (UINT32 i = 0; i < _capacity; i++)
+  {
+    cells[i].seq = i;
+    cells[i].buf = arena + (size_t)i * (size_t)slotSize;
+  }
+  m_tail    = 0;
+  m_head    = 0;
+  m_idle    = 0;
+  m_waiters = 0;
+  m_stop    = false;
+  queued = sent = sendErrors = blocked = dropNewest = dropOldest = 0;
+  return VThread::open();
+}
+
+bool SnoopTxQueue::close()
+{
+  mutex.lock();
+  m_stop = true;
+  dataCond.wakeAll();
+  spaceCond.wakeAll();
+  mutex.unlock();
+  bool res = VThread::close();
+
+  if (cells != NULL)
+  {
+    delete[] cells;
+    cells = NULL;
+  }
+  if (arena != NULL)
+  {
+    delete[] arena;
+    arena = NULL;
+  }
+  return res;
+}
+
+bool SnoopTxQueue::enqueue(BYTE* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  SnoopTxQueueCell* cell;
+  UINT32 pos = m_tail;
+  while (true)
+  {
+    cell = &cells[pos & m_mask];
+    INT32 dif = (INT32)(cell->seq - pos);
+    if (dif == 0)
+    {
+      if (__sync_bool_compare_and_swap(&m_tail, pos, pos + 1)) break;
+      pos = m_tail;
+    }
+    else if (dif < 0) return false; // full
+    else pos = m_tail;
+  }
+  memcpy(cell->buf, buf, (size_t)size);
+  cell->size          = size;
+  cell->hasDivertAddr = divertAddr != NULL;
+  if (divertAddr != NULL) cell->divertAddr = *divertAddr;
+  __sync_synchronize(); // frame must be visible before seq
+  cell->seq = pos + 1;
+  return true;
+}
+
+SnoopTxQueueCell* SnoopTxQueue::claim(UINT32& pos)
+{
+  pos = m_head;
+  while (true)
+  {
+    SnoopTxQueueCell* cell = &cells[pos & m_mask];
+    INT32 dif = (INT32)(cell->seq - (pos + 1));
+    if (dif == 0)
+    {
+      if (__sync_bool_compare_and_swap(&m_head, pos, pos + 1)) return cell;
+      pos = m_head;
+    }
+    else if (dif < 0) return NULL; // empty
+    else pos = m_head;
+  }
+}
+
+void SnoopTxQueue::release(SnoopTxQueueCell* cell, UINT32 pos)
+{
+  __sync_synchronize();
+  cell->seq = pos + m_mask + 1;
+}
+
+void SnoopTxQueue::wakeSender()
+{
+  __sync_synchronize(); // pairs with sender setting m_idle before its last empty check
+  if (m_idle == 0) return;
+  mutex.lock();
+  dataCond.wakeOne();
+  mutex.unlock();
+}
+
+int SnoopTxQueue::push(BYTE* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  if (size > slotSize)
+  {
+    __sync_fetch_and_add(&dropNewest, 1);
+    return VERR_FAIL;
+  }
+
+  bool waited = false;
+  while (!enqueue(buf, size, divertAddr))
+  {
+    switch (policy)
+    {
+      case DropNewest:
+        __sync_fetch_and_add(&dropNewest, 1);
+        wakeSender();
+        return VERR_FAIL;
+
+      case DropOldest:
+      {
+        UINT32 pos;
+        SnoopTxQueueCell* cell = claim(pos);
+        if (cell != NULL)
+        {
+          release(cell, pos);
+          __sync_fetch_and_add(&dropOldest, 1);
+        }
+        break;
+      }
+
+      case Block:
+        if (!waited)
+        {
+          __sync_fetch_and_add(&blocked, 1);
+          waited = true;
+        }
+        mutex.lock();
+        if (m_stop)
+        {
+          mutex.unlock();
+          return VERR_FAIL;
+        }
+        m_waiters++;
+        dataCond.wakeOne();
+        spaceCond.wait(&mutex, 1);
+        m_waiters--;
+        mutex.unlock();
+        break;
+    }
+  }
+  __sync_fetch_and_add(&queued, 1);
+  wakeSender();
+  return size;
+}
+
+void SnoopTxQueue::run()
+{
+  while (true)
+  {
+    UINT32 pos;
+    SnoopTxQueueCell* cell = claim(pos);
+    if (cell == NULL)
+    {
+      //
+      // Drained. Batched write(PACKET_TX_RING) goes out now, then sleep until a writer wakes us.
+      // Only the ring is flushed here, pcap->stats are copied by capture thread(SnoopPcap::flushTx).
+      //
+#ifdef linux
+      if (pcap->txRing != NULL) pcap->txRing->flush();
+#endif // linux
+      mutex.lock();
+      if (m_stop)
+      {
+        mutex.unlock();
+        break;
+      }
+      m_idle = 1;
+      __sync_synchronize();
+      if ((INT32)(cells[m_head & m_mask].seq - (m_head + 1)) < 0) // still empty
+        dataCond.wait(&mutex, 100);
+      m_idle = 0;
+      mutex.unlock();
+      continue;
+    }
+
+    int res = pcap->doWrite(cell->buf, cell->size, cell->hasDivertAddr ? &cell->divertAddr : NULL);
+    release(cell, pos);
+    if (res < 0) __sync_fetch_and_add(&sendErrors, 1); else __sync_fetch_and_add(&sent, 1);
+
+    if (m_waiters > 0)
+    {
+      mutex.lock();
+      spaceCond.wakeAll();
+      mutex.unlock();
+    }
+  }
+}
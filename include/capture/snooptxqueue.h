@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_TX_QUEUE_H__
+#define __SNOOP_TX_QUEUE_H__
+
+#include <SnoopPacket> // for WINDIVERT_ADDRESS
+#include <VThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+// ----------------------------------------------------------------------------
+// SnoopTxQueueCell
+// ----------------------------------------------------------------------------
+class SnoopTxQueueCell
+{
+public:
+  volatile UINT32   seq;  // position this cell waits for(bounded MPMC queue by Dmitry Vyukov)
+  int               size;
+  WINDIVERT_ADDRESS divertAddr;
+  bool              hasDivertAddr;
+  BYTE*             buf;  // slot in arena
+};
+
+// ----------------------------------------------------------------------------
+// SnoopTxQueue
+// ----------------------------------------------------------------------------
+/// Bounded lock free queue of frames to send and a thread sending them.
+/// Any thread may push. Only the full(Block policy) and idle paths take a lock.
+class SnoopPcap;
+class SnoopTxQueue : public VThread
+{
+public:
+  typedef enum
+  {
+    Block,      // writer waits until there is room
+    DropNewest, // frame being written is dropped
+    DropOldest  // oldest queued frame is dropped to make room
+  } Policy;
+
+public:
+  SnoopTxQueue(SnoopPcap* pcap);
+  virtual ~SnoopTxQueue();
+
+public:
+  int    capacity; // rounded up to power of 2
+  int    slotSize; // max frame size
+  Policy policy;
+
+public:
+  virtual bool open();
+  virtual bool close();
+
+public:
+  int    push(BYTE* buf, int size, WINDIVERT_ADDRESS* divertAddr); // return size, or VERR_FAIL when dropped
+
+public:
+  //
+  // Statistics(updated with atomic add, read from other threads with load)
+  //
+  static UINT64 load(const UINT64& counter) { return __atomic_load_n(&counter, __ATOMIC_RELAXED); }
+  UINT64 queued;
+  UINT64 sent;
+  UINT64 sendErrors;
+  UINT64 blocked;     // pushes that had to wait(Block)
+  UINT64 dropNewest;  // DropNewest and frames too big
+  UINT64 dropOldest;  // DropOldest
+
+protected:
+  SnoopPcap*        pcap; // reference
+  SnoopTxQueueCell* cells;
+  BYTE*             arena;
+  UINT32            m_mask;
+  volatile UINT32   m_tail; // producers
+  volatile UINT32   m_head; // consumer(and DropOldest producers)
+  volatile int      m_idle; // sender sleeps on cond
+  volatile int      m_waiters;
+  volatile bool     m_stop;
+  QMutex            mutex;
+  QWaitCondition    dataCond;
+  QWaitCondition    spaceCond;
+
+protected:
+  bool              enqueue(BYTE* buf, int size, WINDIVERT_ADDRESS* divertAddr);
+  SnoopTxQueueCell* claim(UINT32& pos); // NULL if empty
+  void              release(SnoopTxQueueCell* cell, UINT32 pos);
+  void              wakeSender();
+  virtual void      run();
+};
+
+#endif // __SNOOP_TX_QUEUE_H__
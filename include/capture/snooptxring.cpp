@@ -0,0 +1,254 @@
+#include <SnoopTxRing>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// SnoopTxRing
+// ----------------------------------------------------------------------------
+SnoopTxRing::SnoopTxRing()
+{
+  frameSize        = 2048;
+  frameCount       = 256;
+  flushCount       = 32;
+  sent             = 0;
+  drops            = 0;
+  m_sock           = -1;
+  m_ring           = NULL;
+  m_ringSize       = 0;
+  m_blockSize      = 0;
+  m_framesPerBlock = 0;
+  m_head           = 0;
+  m_tail           = 0;
+  m_inFlight       = 0;
+  m_pending        = 0;
+}
+
+SnoopTxRing::~SnoopTxRing()
+{
+  close();
+}
+
+int SnoopTxRing::frameSizeFor(int maxLen)
+{
+  return TPACKET_ALIGN(TPACKET_ALIGN(sizeof(tpacket2_hdr)) + maxLen);
+}
+
+bool SnoopTxRing::open(QString interfaceName)
+{
+  if (frameSize <= 0 || frameSize % TPACKET_ALIGNMENT != 0 || frameCount <= 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid ring size(frameSize=%d frameCount=%d)", frameSize, frameCount), VERR_INVALID_RING_SIZE);
+    return false;
+  }
+
+  //
+  // Protocol 0 : socket only sends, nothing is queued for receive.
+  //
+  m_sock = socket(AF_PACKET, SOCK_RAW, 0);
+  if (m_sock == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in socket(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+
+  int version = TPACKET_V2;
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_VERSION)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+    close();
+    return false;
+  }
+
+  //
+  // Malformed frame is skipped instead of stalling the ring.
+  //
+  int loss = 1;
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_LOSS, &loss, sizeof(loss)) == -1)
+  {
+    LOG_WARN("setsockopt(PACKET_LOSS) return -1(%s)", strerror(errno));
+  }
+
+  int pageSize     = getpagesize();
+  m_blockSize      = (frameSize + pageSize - 1) / pageSize * pageSize;
+  m_framesPerBlock = m_blockSize / frameSize;
+  int blockCount   = (frameCount + m_framesPerBlock - 1) / m_framesPerBlock;
+
+  tpacket_req req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = (unsigned int)m_blockSize;
+  req.tp_block_nr   = (unsigned int)blockCount;
+  req.tp_frame_size = (unsigned int)frameSize;
+  req.tp_frame_nr   = (unsigned int)(m_framesPerBlock * blockCount);
+  if (setsockopt(m_sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in setsockopt(PACKET_TX_RING)(%s)", strerror(errno)), VERR_IN_SETSOCKOPT);
+    close();
+    return false;
+  }
+  frameCount = (int)req.tp_frame_nr;
+
+  m_ringSize = (size_t)m_blockSize * (size_t)blockCount;
+  void* ring = mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_sock, 0);
+  if (ring == MAP_FAILED)
+  {
+    SET_ERROR(SnoopError, qformat("error in mmap(%s)", strerror(errno)), VERR_IN_MMAP);
+    close();
+    return false;
+  }
+  m_ring = (BYTE*)ring;
+
+  sockaddr_ll addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sll_family   = AF_PACKET;
+  addr.sll_protocol = 0;
+  addr.sll_ifindex  = (int)if_nametoindex(qPrintable(interfaceName));
+  if (addr.sll_ifindex == 0)
+  {
+    SET_ERROR(SnoopError, qformat("can not find interface(%s)", qPrintable(interfaceName)), VERR_IN_BIND);
+    close();
+    return false;
+  }
+  if (bind(m_sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in bind(%s)", strerror(errno)), VERR_IN_BIND);
+    close();
+    return false;
+  }
+
+  m_head     = 0;
+  m_tail     = 0;
+  m_inFlight = 0;
+  m_pending  = 0;
+  sent       = 0;
+  drops     = 0;
+  LOG_DEBUG("tx ring opened(%s) frameSize=%d frameCount=%d", qPrintable(interfaceName), frameSize, frameCount);
+  return true;
+}
+
+void SnoopTxRing::close()
+{
+  if (m_ring != NULL)
+  {
+    flush();
+    reclaim();
+    munmap(m_ring, m_ringSize);
+    m_ring = NULL;
+  }
+  if (m_sock != -1)
+  {
+    ::close(m_sock);
+    m_sock = -1;
+  }
+  m_inFlight = 0;
+  m_pending  = 0;
+}
+
+tpacket2_hdr* SnoopTxRing::frame(int idx)
+{
+  return (tpacket2_hdr*)(m_ring + (size_t)(idx / m_framesPerBlock) * (size_t)m_blockSize + (size_t)(idx % m_framesPerBlock) * (size_t)frameSize);
+}
+
+int SnoopTxRing::write(BYTE* buf, int size)
+{
+  static const int DATA_OFFSET = TPACKET_ALIGN(sizeof(tpacket2_hdr));
+
+  VLock lock(*this);
+  if (m_ring == NULL) return VERR_FAIL;
+  if (size > frameSize - DATA_OFFSET)
+  {
+    drops++;
+    return VERR_FAIL;
+  }
+
+  reclaim();
+  tpacket2_hdr* hdr = frame(m_head);
+  if (m_inFlight == frameCount)
+  {
+    //
+    // Ring is full. Kick what is queued and look once more, frames already sent may be back by then.
+    //
+    doFlush();
+    if (m_inFlight == frameCount)
+    {
+      drops++;
+      return VERR_FAIL;
+    }
+  }
+
+  memcpy((BYTE*)hdr + DATA_OFFSET, buf, (size_t)size);
+  hdr->tp_len     = (UINT32)size;
+  hdr->tp_snaplen = (UINT32)size;
+  __sync_synchronize(); // data must be visible before status
+  hdr->tp_status  = TP_STATUS_SEND_REQUEST;
+  m_head = (m_head + 1) % frameCount;
+  m_inFlight++;
+  m_pending++;
+
+  if (m_pending >= flushCount) doFlush();
+  return size;
+}
+
+int SnoopTxRing::flush()
+{
+  if (m_inFlight == 0) return 0;
+  VLock lock(*this);
+  return doFlush();
+}
+
+int SnoopTxRing::doFlush()
+{
+  if (m_pending == 0)
+  {
+    reclaim();
+    return 0;
+  }
+  ssize_t res = ::send(m_sock, NULL, 0, MSG_DONTWAIT);
+  if (res == -1)
+  {
+    //
+    // Frames stay in SEND_REQUEST state, so they go out on next flush.
+    //
+    if (errno != EAGAIN && errno != ENOBUFS)
+      LOG_ERROR("send return -1(%s)", strerror(errno));
+    return 0;
+  }
+  int n = m_pending;
+  m_pending = 0;
+  reclaim();
+  return n;
+}
+
+//
+// Walk slots handed to kernel from the oldest one and count those it gave back.
+// A slot still in SEND_REQUEST or SENDING stops the walk, as kernel uses slots in order.
+// TP_STATUS_WRONG_FORMAT shows up only when PACKET_LOSS could not be set.
+//
+void SnoopTxRing::reclaim()
+{
+  while (m_inFlight > 0)
+  {
+    tpacket2_hdr* hdr = frame(m_tail);
+    UINT32 status = *(volatile UINT32*)&hdr->tp_status;
+    if (status == TP_STATUS_AVAILABLE)
+    {
+      sent++;
+    } else
+    if (status == TP_STATUS_WRONG_FORMAT)
+    {
+      drops++;
+      hdr->tp_status = TP_STATUS_AVAILABLE;
+    } else
+      break;
+    m_tail = (m_tail + 1) % frameCount;
+    m_inFlight--;
+  }
+}
+
+#endif // linux
@@ -0,0 +1,78 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_TX_RING_H__
+#define __SNOOP_TX_RING_H__
+
+#include <Snoop>
+#include <VLock>
+
+#ifdef linux
+
+#include <linux/if_packet.h>
+
+// ----------------------------------------------------------------------------
+// SnoopTxRing
+// ----------------------------------------------------------------------------
+/// AF_PACKET PACKET_TX_RING(TPACKET_V2). write() only queues a frame, flush() sends every queued frame with one syscall.
+/// Frames leave in the order they were queued, so per flow order is kept.
+/// A frame is counted as sent only when kernel gives its slot back as TP_STATUS_AVAILABLE.
+class SnoopTxRing : public VLockable
+{
+public:
+  SnoopTxRing();
+  virtual ~SnoopTxRing();
+
+public:
+  int    frameSize;  // multiple of TPACKET_ALIGNMENT
+  int    frameCount;
+  int    flushCount; // write() flushes by itself when this many frames are queued
+
+public:
+  static int frameSizeFor(int maxLen); // frameSize holding tpacket2_hdr and maxLen bytes
+
+public:
+  VError error;
+  bool   open(QString interfaceName);
+  void   close();
+  bool   active() { return m_sock != -1; }
+
+public:
+  int    write(BYTE* buf, int size); // return size, or VERR_FAIL when dropped
+  int    flush();                    // return frames handed to kernel
+  int    pending() { return m_pending; }
+
+public:
+  //
+  // Statistics
+  //
+  UINT64 sent;  // slots given back by kernel
+  UINT64 drops; // ring full, frame too big or TP_STATUS_WRONG_FORMAT
+
+protected:
+  int    m_sock;
+  BYTE*  m_ring;
+  size_t m_ringSize;
+  int    m_blockSize;
+  int    m_framesPerBlock;
+  int    m_head;    // next frame to fill
+  int    m_tail;    // oldest frame not yet given back by kernel
+  int    m_inFlight; // frames between m_tail and m_head
+  int    m_pending; // filled but not yet flushed
+
+protected:
+  tpacket2_hdr* frame(int idx);
+  int           doFlush();
+  void          reclaim();
+};
+
+#endif // linux
+
+#endif // __SNOOP_TX_RING_H__
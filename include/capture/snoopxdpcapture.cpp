@@ -0,0 +1,591 @@
+#include <SnoopXdpCapture>
+#include <VDebugNew>
+
+#if defined(linux) && defined(SNOOP_XDP)
+
+#include <errno.h>
+#include <linux/if_link.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+REGISTER_METACLASS(SnoopXdpCapture, SnoopCapture)
+
+// ----------------------------------------------------------------------------
+// SnoopXdpCapture
+// ----------------------------------------------------------------------------
+SnoopXdpCapture::SnoopXdpCapture(void* owner) : SnoopCapture(owner)
+{
+  adapterIndex  = snoop::DEFAULT_ADAPTER_INDEX;
+  queueId       = 0;
+  frameCount    = 4096;
+  frameSize     = XSK_UMEM__DEFAULT_FRAME_SIZE;
+  txFrameCount  = 1024;
+  ringSize      = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+  skbMode       = false;
+  readTimeout   = snoop::DEFAULT_READTIMEOUT;
+
+  m_umemArea    = NULL;
+  m_umem        = NULL;
+  m_xsk         = NULL;
+  memset(&m_fill, 0, sizeof(m_fill));
+  memset(&m_comp, 0, sizeof(m_comp));
+  memset(&m_rx,   0, sizeof(m_rx));
+  memset(&m_tx,   0, sizeof(m_tx));
+  m_source      = "";
+  m_skbMode     = false;
+  m_txPending   = 0;
+
+  rxDropped     = 0;
+  rxRingFull    = 0;
+  fillRingEmpty = 0;
+  txRingEmpty   = 0;
+  txDropped     = 0;
+  rxPeak        = 0;
+  fillLow       = 0;
+  compPeak      = 0;
+}
+
+SnoopXdpCapture::~SnoopXdpCapture()
+{
+  close();
+}
+
+bool SnoopXdpCapture::doOpen()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  if (adapterIndex == snoop::INVALID_ADAPTER_INDEX)
+  {
+    SET_ERROR(SnoopError, "invalid adapter index(-1)", VERR_INVALID_INDEX);
+    return false;
+  }
+  const SnoopInterface& intf = SnoopInterfaces::instance().at(adapterIndex);
+  m_source = intf.name;
+  LOG_DEBUG("source=%s queueId=%d", qPrintable(m_source), queueId);
+
+  if (txFrameCount <= 0 || rxFrameCount() <= 0 || rxFrameCount() > ringSize)
+  {
+    SET_ERROR(SnoopError, qformat("invalid ring size(frameCount=%d txFrameCount=%d ringSize=%d)", frameCount, txFrameCount, ringSize), VERR_INVALID_RING_SIZE);
+    return false;
+  }
+
+  //
+  // UMEM
+  //
+  size_t umemSize = (size_t)frameCount * (size_t)frameSize;
+  void* area = NULL;
+  if (posix_memalign(&area, (size_t)getpagesize(), umemSize) != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in posix_memalign(%u)", (unsigned)umemSize), VERR_IN_MMAP);
+    return false;
+  }
+  m_umemArea = (BYTE*)area;
+
+  xsk_umem_config umemConfig;
+  memset(&umemConfig, 0, sizeof(umemConfig));
+  umemConfig.fill_size      = (__u32)ringSize;
+  umemConfig.comp_size      = (__u32)ringSize;
+  umemConfig.frame_size     = (__u32)frameSize;
+  umemConfig.frame_headroom = 0;
+  int res = xsk_umem__create(&m_umem, m_umemArea, umemSize, &m_fill, &m_comp, &umemConfig);
+  if (res != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in xsk_umem__create(%s)", strerror(-res)), VERR_IN_MMAP);
+    return false;
+  }
+
+  //
+  // Socket(native mode first, then generic mode)
+  //
+  xsk_socket_config xskConfig;
+  memset(&xskConfig, 0, sizeof(xskConfig));
+  xskConfig.rx_size    = (__u32)ringSize;
+  xskConfig.tx_size    = (__u32)ringSize;
+  xskConfig.bind_flags = XDP_USE_NEED_WAKEUP;
+  res = -1;
+  if (!skbMode)
+  {
+    xskConfig.xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST | XDP_FLAGS_DRV_MODE;
+    res = xsk_socket__create(&m_xsk, qPrintable(m_source), (__u32)queueId, m_umem, &m_rx, &m_tx, &xskConfig);
+    if (res != 0) LOG_WARN("native mode not available(%s), fall back to generic mode", strerror(-res));
+  }
+  if (res != 0)
+  {
+    xskConfig.xdp_flags   = XDP_FLAGS_UPDATE_IF_NOEXIST | XDP_FLAGS_SKB_MODE;
+    xskConfig.bind_flags |= XDP_COPY;
+    res = xsk_socket__create(&m_xsk, qPrintable(m_source), (__u32)queueId, m_umem, &m_rx, &m_tx, &xskConfig);
+    m_skbMode = true;
+  } else
+    m_skbMode = false;
+  if (res != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in xsk_socket__create(%s)", strerror(-res)), VERR_IN_SOCKET);
+    return false;
+  }
+  LOG_DEBUG("source=%s mode=%s", qPrintable(m_source), m_skbMode ? "skb" : "native");
+
+  //
+  // Frame state : [0, rxFrameCount) goes to fill ring, the rest is for write()
+  //
+  m_frameState.fill(FRAME_FREE, frameCount);
+  m_userAddrs.clear();
+  m_userAddrs.reserve(ringSize);
+  m_txFree.clear();
+  m_txFree.reserve(txFrameCount);
+  for (int i = rxFrameCount(); i < frameCount; i++)
+    m_txFree.push_back((UINT64)i * (UINT64)frameSize);
+
+  __u32 idx;
+  int _rxFrameCount = rxFrameCount();
+  if (xsk_ring_prod__reserve(&m_fill, (__u32)_rxFrameCount, &idx) != (__u32)_rxFrameCount)
+  {
+    SET_ERROR(SnoopError, "can not populate fill ring", VERR_INVALID_RING_SIZE);
+    return false;
+  }
+  for (int i = 0; i < _rxFrameCount; i++)
+  {
+    *xsk_ring_prod__fill_addr(&m_fill, idx++) = (UINT64)i * (UINT64)frameSize;
+    m_frameState[i] = FRAME_FILL;
+  }
+  xsk_ring_prod__submit(&m_fill, (__u32)_rxFrameCount);
+
+  m_txPending   = 0;
+  rxDropped     = 0;
+  rxRingFull    = 0;
+  fillRingEmpty = 0;
+  txRingEmpty   = 0;
+  txDropped     = 0;
+  rxPeak        = 0;
+  fillLow       = (UINT32)ringSize;
+  compPeak      = 0;
+
+  return SnoopCapture::doOpen();
+}
+
+bool SnoopXdpCapture::doClose()
+{
+  if (!enabled)
+  {
+    LOG_DEBUG("enabled is false");
+    return true;
+  }
+
+  //
+  // UMEM is referenced by capture thread, so waits until thread is terminated.
+  //
+  if (runThread().active())
+  {
+    runThread().close(false);
+    runThread().wait();
+  }
+
+  if (m_xsk != NULL)
+  {
+    kickTx();
+    updateStats();
+    LOG_DEBUG("source=%s rxDropped=%llu rxRingFull=%llu fillRingEmpty=%llu txDropped=%llu rxPeak=%u fillLow=%u compPeak=%u",
+      qPrintable(m_source), (unsigned long long)rxDropped, (unsigned long long)rxRingFull,
+      (unsigned long long)fillRingEmpty, (unsigned long long)txDropped, rxPeak, fillLow, compPeak);
+    xsk_socket__delete(m_xsk);
+    m_xsk = NULL;
+  }
+  if (m_umem != NULL)
+  {
+    xsk_umem__delete(m_umem);
+    m_umem = NULL;
+  }
+  if (m_umemArea != NULL)
+  {
+    free(m_umemArea);
+    m_umemArea = NULL;
+  }
+  m_frameState.clear();
+  m_userAddrs.clear();
+  m_txFree.clear();
+  m_source = "";
+
+  return SnoopCapture::doClose();
+}
+
+bool SnoopXdpCapture::kernelStats(UINT64& drops, UINT64& ifDrops)
+{
+  if (!updateStats()) return false;
+  drops   = rxDropped + rxRingFull;
+  ifDrops = 0;
+  return true;
+}
+
+bool SnoopXdpCapture::updateStats()
+{
+  if (m_xsk == NULL) return false;
+  xdp_statistics stats;
+  memset(&stats, 0, sizeof(stats));
+  socklen_t len = sizeof(stats);
+  if (getsockopt(xsk_socket__fd(m_xsk), SOL_XDP, XDP_STATISTICS, &stats, &len) == -1)
+  {
+    LOG_ERROR("getsockopt(XDP_STATISTICS) return -1(%s)", strerror(errno));
+    return false;
+  }
+  //
+  // XDP_STATISTICS counters are cumulative.
+  //
+  rxDropped     = stats.rx_dropped;
+  rxRingFull    = stats.rx_ring_full;
+  fillRingEmpty = stats.rx_fill_ring_empty_descs;
+  txRingEmpty   = stats.tx_ring_empty_descs;
+  return true;
+}
+
+UINT32 SnoopXdpCapture::rxOccupancy()
+{
+  return xsk_cons_nb_avail(&m_rx, (__u32)ringSize);
+}
+
+UINT32 SnoopXdpCapture::fillOccupancy()
+{
+  return (UINT32)ringSize - xsk_prod_nb_free(&m_fill, (__u32)ringSize);
+}
+
+UINT32 SnoopXdpCapture::compOccupancy()
+{
+  return xsk_cons_nb_avail(&m_comp, (__u32)ringSize);
+}
+
+//
+// Called before each read. Frames of previous read have gone through the graph by now.
+//
+void SnoopXdpCapture::flush()
+{
+  recycle();
+  reapCompletion();
+  kickTx();
+
+  UINT32 rx   = rxOccupancy();
+  UINT32 fill = fillOccupancy();
+  if (rx   > rxPeak)  rxPeak  = rx;
+  if (fill < fillLow) fillLow = fill;
+}
+
+void SnoopXdpCapture::recycle()
+{
+  int count = 0;
+  foreach (UINT64 addr, m_userAddrs)
+    if (m_frameState[frameIndex(addr)] == FRAME_USER) count++;
+
+  if (count > 0)
+  {
+    __u32 idx;
+    if (xsk_ring_prod__reserve(&m_fill, (__u32)count, &idx) != (__u32)count)
+    {
+      LOG_FATAL("can not reserve fill ring(%d)", count); // can not happen: fill ring can hold every rx frame
+    } else
+    {
+      foreach (UINT64 addr, m_userAddrs)
+      {
+        int i = frameIndex(addr);
+        if (m_frameState[i] != FRAME_USER) continue;
+        *xsk_ring_prod__fill_addr(&m_fill, idx++) = (UINT64)i * (UINT64)frameSize;
+        m_frameState[i] = FRAME_FILL;
+      }
+      xsk_ring_prod__submit(&m_fill, (__u32)count);
+    }
+  }
+  m_userAddrs.clear();
+}
+
+void SnoopXdpCapture::reapCompletion()
+{
+  __u32 idx;
+  __u32 count = xsk_ring_cons__peek(&m_comp, (__u32)ringSize, &idx);
+  if (count == 0) return;
+  if (count > compPeak) compPeak = count;
+
+  __u32 fillIdx;
+  __u32 rxCount = 0;
+  for (__u32 i = 0; i < count; i++)
+  {
+    UINT64 addr = *xsk_ring_cons__comp_addr(&m_comp, idx + i);
+    if (frameIndex(addr) < rxFrameCount()) rxCount++;
+  }
+  if (rxCount > 0 && xsk_ring_prod__reserve(&m_fill, rxCount, &fillIdx) != rxCount)
+  {
+    LOG_FATAL("can not reserve fill ring(%u)", rxCount); // can not happen: fill ring can hold every rx frame
+    rxCount = 0;
+  }
+  for (__u32 i = 0; i < count; i++)
+  {
+    UINT64 addr = *xsk_ring_cons__comp_addr(&m_comp, idx + i);
+    int frame = frameIndex(addr);
+    UINT64 base = (UINT64)frame * (UINT64)frameSize;
+    if (frame < rxFrameCount())
+    {
+      if (rxCount == 0) continue;
+      *xsk_ring_prod__fill_addr(&m_fill, fillIdx++) = base;
+      m_frameState[frame] = FRAME_FILL;
+    } else
+    {
+      m_txFree.push_back(base);
+      m_frameState[frame] = FRAME_FREE;
+    }
+  }
+  if (rxCount > 0) xsk_ring_prod__submit(&m_fill, rxCount);
+  xsk_ring_cons__release(&m_comp, count);
+}
+
+void SnoopXdpCapture::kickTx()
+{
+  if (m_txPending == 0) return;
+  if (xsk_ring_prod__needs_wakeup(&m_tx))
+  {
+    if (sendto(xsk_socket__fd(m_xsk), NULL, 0, MSG_DONTWAIT, NULL, 0) < 0)
+    {
+      if (errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+        LOG_ERROR("sendto return -1(%s)", strerror(errno));
+    }
+  }
+  m_txPending = 0;
+}
+
+bool SnoopXdpCapture::nextFrame(SnoopPacket* packet, struct timespec& ts)
+{
+  __u32 idx;
+  if (xsk_ring_cons__peek(&m_rx, 1, &idx) != 1) return false;
+  const xdp_desc* desc = xsk_ring_cons__rx_desc(&m_rx, idx);
+  UINT64 addr = desc->addr;
+  UINT32 len  = desc->len;
+  xsk_ring_cons__release(&m_rx, 1);
+
+  m_frameState[frameIndex(addr)] = FRAME_USER;
+  m_userAddrs.push_back(addr);
+
+  PKT_HDR* pktHdr    = packet->pktHdr;
+  pktHdr->ts.tv_sec  = ts.tv_sec;
+  pktHdr->ts.tv_usec = ts.tv_nsec / 1000;
+  pktHdr->caplen     = len;
+  pktHdr->len        = len;
+  packet->tsNsec     = (UINT32)ts.tv_nsec;
+  packet->pktData    = (BYTE*)xsk_umem__get_data(m_umemArea, addr);
+  packet->linkType   = dataLink();
+  return true;
+}
+
+bool SnoopXdpCapture::waitFrame()
+{
+  pollfd pfd;
+  pfd.fd      = xsk_socket__fd(m_xsk);
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  int res = poll(&pfd, 1, readTimeout);
+  if (res < 0 && errno != EINTR)
+  {
+    SET_DEBUG_ERROR(SnoopError, qformat("poll return %d(%s)", res, strerror(errno)), VERR_IN_PCAP_NEXT_EX);
+    return false;
+  }
+  return true;
+}
+
+bool SnoopXdpCapture::transmit(UINT64 addr, UINT32 len)
+{
+  __u32 idx;
+  if (xsk_ring_prod__reserve(&m_tx, 1, &idx) != 1)
+  {
+    reapCompletion();
+    kickTx();
+    if (xsk_ring_prod__reserve(&m_tx, 1, &idx) != 1)
+    {
+      txDropped++;
+      return false;
+    }
+  }
+  xdp_desc* desc = xsk_ring_prod__tx_desc(&m_tx, idx);
+  desc->addr = addr;
+  desc->len  = len;
+  xsk_ring_prod__submit(&m_tx, 1);
+  m_frameState[frameIndex(addr)] = FRAME_TX;
+  m_txPending++;
+  return true;
+}
+
+int SnoopXdpCapture::read(SnoopPacket* packet)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  LOG_ASSERT(m_xsk != NULL);
+
+  flush();
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  packet->clear();
+  packet->pktHdr = &m_pktHdr;
+  if (!nextFrame(packet, ts))
+  {
+    if (!waitFrame()) return VERR_FAIL;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (!nextFrame(packet, ts)) return 0;
+  }
+  if (autoParse) parse(packet);
+  return (int)packet->pktHdr->caplen;
+}
+
+int SnoopXdpCapture::readBurst(SnoopPacketBatch& batch, int max)
+{
+  if (m_state != VState::Opened)
+  {
+    SET_DEBUG_ERROR(VError, qformat("not opened state(%s)", qPrintable(className())), VERR_NOT_OPENED_STATE);
+    return VERR_FAIL;
+  }
+  LOG_ASSERT(m_xsk != NULL);
+
+  flush();
+
+  batch.reserve(max, 0);
+  batch.clear();
+  for (int retry = 0; retry < 2 && batch.count == 0; retry++)
+  {
+    if (retry > 0 && !waitFrame()) return VERR_FAIL;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    while (batch.count < max)
+    {
+      SnoopPacket* packet = batch.next();
+      if (!nextFrame(packet, ts))
+      {
+        batch.count--; // give back unused descriptor
+        break;
+      }
+    }
+  }
+
+  if (autoParse)
+  {
+    for (int i = 0; i < batch.count; i++)
+      parse(batch.at(i));
+  }
+  return batch.count;
+}
+
+int SnoopXdpCapture::write(SnoopPacket* packet)
+{
+  return write(packet->pktData, packet->pktHdr->caplen);
+}
+
+int SnoopXdpCapture::write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr)
+{
+  Q_UNUSED(divertAddr)
+  if (size > frameSize)
+  {
+    LOG_ERROR("too big size(%d) frameSize=%d", size, frameSize);
+    return VERR_FAIL;
+  }
+  if (m_txFree.isEmpty()) reapCompletion();
+  if (m_txFree.isEmpty())
+  {
+    txDropped++;
+    return VERR_FAIL;
+  }
+  UINT64 addr = m_txFree.last();
+  m_txFree.pop_back();
+  memcpy(xsk_umem__get_data(m_umemArea, addr), buf, (size_t)size);
+  if (!transmit(addr, (UINT32)size))
+  {
+    m_txFree.push_back(addr);
+    return VERR_FAIL;
+  }
+  kickTx(); // injected packet is sent immediately
+  return size;
+}
+
+bool SnoopXdpCapture::relay(SnoopPacket* packet)
+{
+  //
+  // Frame is already in UMEM, so its descriptor is handed to TX ring without copy.
+  // TX ring is kicked once per read in flush().
+  //
+  BYTE* pktData = packet->pktData;
+  if (pktData < m_umemArea || pktData >= m_umemArea + (size_t)frameCount * (size_t)frameSize)
+    return write(packet) != VERR_FAIL;
+  UINT64 addr = (UINT64)(pktData - m_umemArea);
+  if (m_frameState[frameIndex(addr)] != FRAME_USER)
+    return write(packet) != VERR_FAIL;
+  return transmit(addr, packet->pktHdr->caplen);
+}
+
+void SnoopXdpCapture::load(VXml xml)
+{
+  SnoopCapture::load(xml);
+
+  adapterIndex = xml.getInt("adapterIndex", adapterIndex);
+  queueId      = xml.getInt("queueId", queueId);
+  frameCount   = xml.getInt("frameCount", frameCount);
+  frameSize    = xml.getInt("frameSize", frameSize);
+  txFrameCount = xml.getInt("txFrameCount", txFrameCount);
+  ringSize     = xml.getInt("ringSize", ringSize);
+  skbMode      = xml.getBool("skbMode", skbMode);
+  readTimeout  = xml.getInt("readTimeout", readTimeout);
+}
+
+void SnoopXdpCapture::save(VXml xml)
+{
+  SnoopCapture::save(xml);
+
+  xml.setInt("adapterIndex", adapterIndex);
+  xml.setInt("queueId", queueId);
+  xml.setInt("frameCount", frameCount);
+  xml.setInt("frameSize", frameSize);
+  xml.setInt("txFrameCount", txFrameCount);
+  xml.setInt("ringSize", ringSize);
+  xml.setBool("skbMode", skbMode);
+  xml.setInt("readTimeout", readTimeout);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopXdpCapture::optionAddWidget(QLayout* layout)
+{
+  SnoopCapture::optionAddWidget(layout);
+
+  QStringList strList;
+  SnoopInterfaces& intfs = SnoopInterfaces::instance();
+  int _count = intfs.count();
+  for (int i = 0; i < _count; i++)
+  {
+    SnoopInterface& intf = (SnoopInterface&)intfs.at(i);
+    QString value = intf.description;
+    if (value == "") value = intf.name;
+    strList.push_back(value);
+  }
+  VOptionable::addComboBox(layout, "cbxAdapterIndex", "Adapter",        strList, adapterIndex);
+  VOptionable::addLineEdit(layout, "leQueueId",       "Queue Id",       QString::number(queueId));
+  VOptionable::addLineEdit(layout, "leFrameCount",    "Frame Count",    QString::number(frameCount));
+  VOptionable::addLineEdit(layout, "leFrameSize",     "Frame Size",     QString::number(frameSize));
+  VOptionable::addLineEdit(layout, "leTxFrameCount",  "TX Frame Count", QString::number(txFrameCount));
+  VOptionable::addLineEdit(layout, "leRingSize",      "Ring Size",      QString::number(ringSize));
+  VOptionable::addCheckBox(layout, "chkSkbMode",      "SKB Mode",       skbMode);
+  VOptionable::addLineEdit(layout, "leReadTimeout",   "Read Timeout",   QString::number(readTimeout));
+}
+
+void SnoopXdpCapture::optionSaveDlg(QDialog* dialog)
+{
+  SnoopCapture::optionSaveDlg(dialog);
+
+  adapterIndex = dialog->findChild<QComboBox*>("cbxAdapterIndex")->currentIndex();
+  queueId      = dialog->findChild<QLineEdit*>("leQueueId")->text().toInt();
+  frameCount   = dialog->findChild<QLineEdit*>("leFrameCount")->text().toInt();
+  frameSize    = dialog->findChild<QLineEdit*>("leFrameSize")->text().toInt();
+  txFrameCount = dialog->findChild<QLineEdit*>("leTxFrameCount")->text().toInt();
+  ringSize     = dialog->findChild<QLineEdit*>("leRingSize")->text().toInt();
+  skbMode      = dialog->findChild<QCheckBox*>("chkSkbMode")->checkState() == Qt::Checked;
+  readTimeout  = dialog->findChild<QLineEdit*>("leReadTimeout")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux && SNOOP_XDP
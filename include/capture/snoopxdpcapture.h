@@ -0,0 +1,121 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_XDP_CAPTURE_H__
+#define __SNOOP_XDP_CAPTURE_H__
+
+#include <SnoopAdapter>
+
+#if defined(linux) && defined(SNOOP_XDP)
+
+#include <xdp/xsk.h>
+
+// ----------------------------------------------------------------------------
+// SnoopXdpCapture
+// ----------------------------------------------------------------------------
+/// AF_XDP in-path capture. RX and TX share one UMEM, so relay() forwards a frame without copy.
+class SnoopXdpCapture : public SnoopCapture
+{
+public:
+  SnoopXdpCapture(void* owner = NULL);
+  virtual ~SnoopXdpCapture();
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual int read(SnoopPacket* packet);
+  virtual int readBurst(SnoopPacketBatch& batch, int max);
+  virtual int write(SnoopPacket* packet);
+  virtual int write(u_char* buf, int size, WINDIVERT_ADDRESS* divertAddr = NULL);
+
+public:
+  virtual SnoopCaptureType captureType() { return SnoopCaptureType::InPath; }
+  virtual int              dataLink()    { return DLT_EN10MB; }
+  virtual bool             relay(SnoopPacket* packet);
+  virtual bool             kernelStats(UINT64& drops, UINT64& ifDrops);
+
+  //
+  // Properties
+  //
+public:
+  SnoopAdapterIndex adapterIndex;
+  int               queueId;
+  int               frameCount;   // UMEM frames
+  int               frameSize;    // UMEM frame size
+  int               txFrameCount; // UMEM frames reserved for write()
+  int               ringSize;     // RX, TX, fill and completion ring size
+  bool              skbMode;      // force generic(SKB) mode
+  int               readTimeout;
+
+protected:
+  BYTE*             m_umemArea;
+  xsk_umem*         m_umem;
+  xsk_socket*       m_xsk;
+  xsk_ring_prod     m_fill;
+  xsk_ring_cons     m_comp;
+  xsk_ring_cons     m_rx;
+  xsk_ring_prod     m_tx;
+  QString           m_source;
+  bool              m_skbMode;    // mode actually attached
+
+protected:
+  enum { FRAME_FREE, FRAME_FILL, FRAME_USER, FRAME_TX };
+  QVector<UINT8>    m_frameState;
+  QVector<UINT64>   m_userAddrs;  // frames handed to graph in last read
+  QVector<UINT64>   m_txFree;     // free frames for write()
+  int               m_txPending;  // submitted but not kicked
+  PKT_HDR           m_pktHdr;     // for read()
+
+public:
+  //
+  // Ring statistics
+  //
+  UINT64            rxDropped;
+  UINT64            rxRingFull;
+  UINT64            fillRingEmpty;
+  UINT64            txRingEmpty;
+  UINT64            txDropped;
+  UINT32            rxPeak;       // max RX ring occupancy seen
+  UINT32            fillLow;      // min fill ring occupancy seen
+  UINT32            compPeak;     // max completion ring occupancy seen
+  bool              updateStats();
+
+public:
+  UINT32            rxOccupancy();
+  UINT32            fillOccupancy();
+  UINT32            compOccupancy();
+
+protected:
+  int  frameIndex(UINT64 addr) { return (int)(addr / (UINT64)frameSize); }
+  int  rxFrameCount()          { return frameCount - txFrameCount;         }
+  void flush();
+  void recycle();
+  void reapCompletion();
+  void kickTx();
+  bool nextFrame(SnoopPacket* packet, struct timespec& ts);
+  bool waitFrame();
+  bool transmit(UINT64 addr, UINT32 len);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux && SNOOP_XDP
+
+#endif // __SNOOP_XDP_CAPTURE_H__
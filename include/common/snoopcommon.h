@@ -121,6 +121,13 @@ static const int VERR_THE_SAME_REAL_AND_TARGET_MAC  = VERR_CATEGORY_SNOOP + 13;
 static const int VERR_CAN_NOT_OPEN_INFECT_THREAD    = VERR_CATEGORY_SNOOP + 14;
 static const int VERR_IN_PCAP_DUMP_OPEN             = VERR_CATEGORY_SNOOP + 15;
 static const int VERR_CAN_NOT_SPOOF_MYSELF          = VERR_CATEGORY_SNOOP + 16;
+static const int VERR_IN_SOCKET                     = VERR_CATEGORY_SNOOP + 17;
+static const int VERR_IN_SETSOCKOPT                 = VERR_CATEGORY_SNOOP + 18;
+static const int VERR_IN_MMAP                       = VERR_CATEGORY_SNOOP + 19;
+static const int VERR_IN_BIND                       = VERR_CATEGORY_SNOOP + 20;
+static const int VERR_INVALID_RING_SIZE             = VERR_CATEGORY_SNOOP + 21;
+static const int VERR_INVALID_PCAP_FILE             = VERR_CATEGORY_SNOOP + 22;
+static const int VERR_TOO_MANY_OPEN_FILES           = VERR_CATEGORY_SNOOP + 23;
 
 #endif // __SNOOP_COMMON_H__
 
@@ -15,3 +15,72 @@ int SnoopPacket::write(QByteArray& ba)
   memcpy(ba.data(), pktData, (size_t)capLen);
   return capLen;
 }
+
+// ----------------------------------------------------------------------------
+// SnoopPacketBatch
+// ----------------------------------------------------------------------------
+SnoopPacketBatch::SnoopPacketBatch()
+{
+  count      = 0;
+  packets    = NULL;
+  m_maxCount = 0;
+  m_snapLen  = 0;
+  m_pktHdrs  = NULL;
+  m_buf      = NULL;
+}
+
+SnoopPacketBatch::~SnoopPacketBatch()
+{
+  delete[] packets;
+  delete[] m_pktHdrs;
+  delete[] m_buf;
+}
+
+void SnoopPacketBatch::reserve(int maxCount, int snapLen)
+{
+  if (maxCount <= m_maxCount && snapLen <= m_snapLen) return;
+  if (maxCount < m_maxCount) maxCount = m_maxCount;
+  if (snapLen  < m_snapLen)  snapLen  = m_snapLen;
+
+  delete[] packets;
+  delete[] m_pktHdrs;
+  delete[] m_buf;
+
+  packets    = new SnoopPacket[maxCount];
+  m_pktHdrs  = new PKT_HDR[maxCount];
+  m_buf      = new BYTE[(size_t)maxCount * (size_t)snapLen];
+  m_maxCount = maxCount;
+  m_snapLen  = snapLen;
+  count      = 0;
+}
+
+void SnoopPacketBatch::clear()
+{
+  count = 0;
+}
+
+SnoopPacket* SnoopPacketBatch::next()
+{
+  if (count >= m_maxCount) return NULL;
+  int i = count++;
+  SnoopPacket* packet = &packets[i];
+  packet->clear();
+  packet->pktHdr = &m_pktHdrs[i];
+  return packet;
+}
+
+SnoopPacket* SnoopPacketBatch::copy(const PKT_HDR* pktHdr, const BYTE* pktData)
+{
+  if (count >= m_maxCount) return NULL;
+  int i = count;
+  SnoopPacket* packet = next();
+
+  PKT_HDR* hdr = packet->pktHdr;
+  BYTE*    buf = m_buf + (size_t)i * (size_t)m_snapLen;
+  *hdr = *pktHdr;
+  if ((int)hdr->caplen > m_snapLen) hdr->caplen = (bpf_u_int32)m_snapLen;
+  memcpy(buf, pktData, hdr->caplen);
+
+  packet->pktData = buf;
+  return packet;
+}
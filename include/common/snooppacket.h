@@ -39,11 +39,13 @@ public:
   ///
   PKT_HDR*  pktHdr;
   BYTE*     pktData;
+  UINT32    tsNsec;   // nanosecond part of timestamp(0 if capture does not support)
 
   ///
   /// datalink layer
   ///
   int       linkType; // DLT_EN10MB, ...
+  int       interfaceId; // pcapng interface id(0 if capture does not support)
   ETH_HDR*  ethHdr;
 
   ///
@@ -92,4 +94,41 @@ public:
   int  write(QByteArray& ba);
 };
 
+// ----------------------------------------------------------------------------
+// SnoopPacketBatch
+// ----------------------------------------------------------------------------
+/// Packet descriptors filled by one SnoopCapture::readBurst call
+class SnoopPacketBatch
+{
+public:
+  SnoopPacketBatch();
+  virtual ~SnoopPacketBatch();
+
+private: // owns packets, m_pktHdrs and m_buf
+  SnoopPacketBatch(const SnoopPacketBatch&);
+  SnoopPacketBatch& operator =(const SnoopPacketBatch&);
+
+public:
+  int          count;
+  SnoopPacket* packets;
+
+protected:
+  int          m_maxCount;
+  int          m_snapLen;
+  PKT_HDR*     m_pktHdrs;
+  BYTE*        m_buf;
+
+public:
+  int          maxCount() { return m_maxCount;    }
+  SnoopPacket* at(int i)  { return &packets[i];   }
+  bool         full()     { return count >= m_maxCount; }
+  BYTE*        buffer(int i) { return m_buf + (size_t)i * (size_t)m_snapLen; } // arena slot of copy()
+
+public:
+  void         reserve(int maxCount, int snapLen = snoop::DEFAULT_SNAPLEN);
+  void         clear();
+  SnoopPacket* next(); // zero copy(caller fills *pktHdr and sets pktData)
+  SnoopPacket* copy(const PKT_HDR* pktHdr, const BYTE* pktData);
+};
+
 #endif // __SNOOP_PACKET_H__
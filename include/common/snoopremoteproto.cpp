@@ -0,0 +1,111 @@
+#include <SnoopRemoteProto>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#ifdef SNOOP_LZ4
+#include <lz4.h>
+#endif // SNOOP_LZ4
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteProto
+// ----------------------------------------------------------------------------
+bool SnoopRemoteProto::lz4Supported()
+{
+#ifdef SNOOP_LZ4
+  return true;
+#else // SNOOP_LZ4
+  return false;
+#endif // SNOOP_LZ4
+}
+
+int SnoopRemoteProto::compressBound(int srcLen)
+{
+#ifdef SNOOP_LZ4
+  return LZ4_compressBound(srcLen);
+#else // SNOOP_LZ4
+  return srcLen;
+#endif // SNOOP_LZ4
+}
+
+int SnoopRemoteProto::compress(const BYTE* src, int srcLen, BYTE* dst, int dstCap)
+{
+#ifdef SNOOP_LZ4
+  int res = LZ4_compress_default((const char*)src, (char*)dst, srcLen, dstCap);
+  if (res <= 0 || res >= srcLen) return 0; // sent raw
+  return res;
+#else // SNOOP_LZ4
+  Q_UNUSED(src) Q_UNUSED(srcLen) Q_UNUSED(dst) Q_UNUSED(dstCap)
+  return 0;
+#endif // SNOOP_LZ4
+}
+
+bool SnoopRemoteProto::decompress(const BYTE* src, int srcLen, BYTE* dst, int rawLen)
+{
+#ifdef SNOOP_LZ4
+  return LZ4_decompress_safe((const char*)src, (char*)dst, srcLen, rawLen) == rawLen;
+#else // SNOOP_LZ4
+  Q_UNUSED(src) Q_UNUSED(srcLen) Q_UNUSED(dst) Q_UNUSED(rawLen)
+  return false;
+#endif // SNOOP_LZ4
+}
+
+bool SnoopRemoteProto::sendAll(int sock, const void* buf, int len)
+{
+  const char* p = (const char*)buf;
+  while (len > 0)
+  {
+    ssize_t res = send(sock, p, (size_t)len, MSG_NOSIGNAL);
+    if (res < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p   += res;
+    len -= (int)res;
+  }
+  return true;
+}
+
+bool SnoopRemoteProto::recvAll(int sock, void* buf, int len, int timeout)
+{
+  char* p = (char*)buf;
+  while (len > 0)
+  {
+    pollfd pfd;
+    pfd.fd      = sock;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    int n = poll(&pfd, 1, timeout);
+    if (n == 0) return false;
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    ssize_t res = recv(sock, p, (size_t)len, 0);
+    if (res == 0) return false; // closed by peer
+    if (res < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return false;
+    }
+    p   += res;
+    len -= (int)res;
+  }
+  return true;
+}
+
+bool SnoopRemoteProto::sameSecret(const QByteArray& a, const QByteArray& b)
+{
+  if (a.size() != b.size()) return false;
+  BYTE dif = 0;
+  for (int i = 0; i < a.size(); i++)
+    dif |= (BYTE)(a.at(i) ^ b.at(i));
+  return dif == 0;
+}
+
+#endif // linux
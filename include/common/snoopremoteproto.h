@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_REMOTE_PROTO_H__
+#define __SNOOP_REMOTE_PROTO_H__
+
+#include <SnoopCommon>
+
+#ifdef linux
+
+//
+// Stream between SnoopRemoteServer and SnoopRemote over TCP(every field in network byte order)
+//
+// client -> server : SNOOP_REMOTE_HELLO + filter + secret
+// server -> client : SNOOP_REMOTE_REPLY + message
+// server -> client : { SNOOP_REMOTE_BATCH_HDR + payload }*
+//
+// payload(after LZ4 decompression if SNOOP_REMOTE_FLAG_LZ4) : { SNOOP_REMOTE_PKT_HDR + data(caplen) }*
+//
+#pragma pack(push, 1)
+typedef struct
+{
+  UINT32 magic;
+  UINT16 version;
+  UINT16 flags;     // requested
+  UINT32 snapLen;
+  UINT32 filterLen; // BPF filter text evaluated by server
+  UINT32 secretLen; // shared secret server checks
+} SNOOP_REMOTE_HELLO;
+
+typedef struct
+{
+  UINT32 magic;
+  UINT16 version;
+  UINT16 flags;     // granted
+  UINT32 linkType;
+  UINT32 status;    // 0 : ok, otherwise message tells why
+  UINT32 msgLen;
+} SNOOP_REMOTE_REPLY;
+
+typedef struct
+{
+  UINT32 len;       // payload bytes on the wire
+  UINT32 rawLen;    // payload bytes after decompression
+  UINT32 count;     // packets
+  UINT32 flags;
+  UINT64 drops;     // packets server dropped for this client so far
+} SNOOP_REMOTE_BATCH_HDR;
+
+typedef struct
+{
+  UINT32 tsSec;
+  UINT32 tsUsec;
+  UINT32 tsNsec;
+  UINT32 caplen;
+  UINT32 len;
+} SNOOP_REMOTE_PKT_HDR;
+#pragma pack(pop)
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteProto
+// ----------------------------------------------------------------------------
+class SnoopRemoteProto
+{
+public:
+  static const UINT32 MAGIC        = 0x534E524D; // "SNRM"
+  static const UINT16 VERSION      = 2;
+  static const UINT16 FLAG_LZ4     = 0x0001;
+  static const int    DEFAULT_PORT = 8908;
+  static const int    MAX_BATCH    = 4 * 1024 * 1024;
+  static const int    MAX_FILTER   = 4096;
+  static const int    MAX_SECRET   = 256;
+
+public:
+  static bool lz4Supported();
+  static int  compressBound(int srcLen);
+  static int  compress(const BYTE* src, int srcLen, BYTE* dst, int dstCap); // 0 : not compressed
+  static bool decompress(const BYTE* src, int srcLen, BYTE* dst, int rawLen);
+
+public:
+  static bool sendAll(int sock, const void* buf, int len);
+  static bool recvAll(int sock, void* buf, int len, int timeout); // msec per wait
+  static bool sameSecret(const QByteArray& a, const QByteArray& b); // takes the same time wherever they differ
+};
+
+#endif // linux
+
+#endif // __SNOOP_REMOTE_PROTO_H__
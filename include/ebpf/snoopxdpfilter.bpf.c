@@ -0,0 +1,148 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+//
+// XDP program loaded by SnoopXdpOffload(clang -O2 -target bpf).
+// Untagged IPv4 packet matching no rule is dropped, every other packet is passed.
+// Every IPv4 packet is counted per 5-tuple.
+//
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+#include "snoopxdpfilter.h"
+
+struct
+{
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, SNOOP_XDP_MAX_RULES);
+  __type(key, __u32);
+  __type(value, struct snoop_xdp_rule);
+} snoop_rules SEC(".maps");
+
+struct
+{
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, __u32);
+  __type(value, struct snoop_xdp_config);
+} snoop_config SEC(".maps");
+
+struct
+{
+  __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+  __uint(max_entries, 65536); // resized by loader(flowCount)
+  __type(key, struct snoop_xdp_flow_key);
+  __type(value, struct snoop_xdp_flow_value);
+} snoop_flows SEC(".maps");
+
+struct
+{
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, SNOOP_XDP_STAT_MAX);
+  __type(key, __u32);
+  __type(value, __u64);
+} snoop_stats SEC(".maps");
+
+static __always_inline void count_stat(__u32 idx)
+{
+  __u64* value = bpf_map_lookup_elem(&snoop_stats, &idx);
+  if (value) (*value)++;
+}
+
+static __always_inline int match(struct snoop_xdp_flow_key* key, int hasPorts, __u32 ruleCount)
+{
+  for (__u32 i = 0; i < SNOOP_XDP_MAX_RULES; i++)
+  {
+    if (i >= ruleCount) break;
+    __u32 idx = i;
+    struct snoop_xdp_rule* rule = bpf_map_lookup_elem(&snoop_rules, &idx);
+    if (!rule) break;
+    if (rule->proto && rule->proto != key->proto) continue;
+    if ((key->saddr & rule->smask) != rule->saddr) continue;
+    if ((key->daddr & rule->dmask) != rule->daddr) continue;
+    if (rule->sport && (!hasPorts || rule->sport != key->sport)) continue;
+    if (rule->dport && (!hasPorts || rule->dport != key->dport)) continue;
+    return 1;
+  }
+  return 0;
+}
+
+SEC("xdp")
+int snoop_xdp_filter(struct xdp_md* ctx)
+{
+  void* data    = (void*)(long)ctx->data;
+  void* dataEnd = (void*)(long)ctx->data_end;
+
+  //
+  // VLAN tagged frame is not seen by a filter without "vlan", so it is left alone like non IPv4.
+  //
+  struct ethhdr* eth = data;
+  if ((void*)(eth + 1) > dataEnd || eth->h_proto != bpf_htons(ETH_P_IP))
+  {
+    count_stat(SNOOP_XDP_STAT_OTHER);
+    return XDP_PASS;
+  }
+  struct iphdr* ip = (void*)(eth + 1);
+  if ((void*)(ip + 1) > dataEnd || ip->ihl < 5)
+  {
+    count_stat(SNOOP_XDP_STAT_OTHER);
+    return XDP_PASS;
+  }
+
+  struct snoop_xdp_flow_key key;
+  __builtin_memset(&key, 0, sizeof(key));
+  key.saddr = ip->saddr;
+  key.daddr = ip->daddr;
+  key.proto = ip->protocol;
+
+  //
+  // TCP, UDP and SCTP start with source and destination port. Non first fragment has no ports.
+  //
+  int hasPorts = 0;
+  if ((ip->frag_off & bpf_htons(0x1FFF)) == 0 &&
+      (key.proto == IPPROTO_TCP || key.proto == IPPROTO_UDP || key.proto == IPPROTO_SCTP))
+  {
+    struct udphdr* l4 = (void*)ip + ip->ihl * 4;
+    if ((void*)(l4 + 1) <= dataEnd)
+    {
+      key.sport = l4->source;
+      key.dport = l4->dest;
+      hasPorts  = 1;
+    }
+  }
+
+  __u32 zero = 0;
+  struct snoop_xdp_config* config = bpf_map_lookup_elem(&snoop_config, &zero);
+  int drop = config && config->ruleCount != 0 && !match(&key, hasPorts, config->ruleCount);
+
+  struct snoop_xdp_flow_value* value = bpf_map_lookup_elem(&snoop_flows, &key);
+  if (!value)
+  {
+    struct snoop_xdp_flow_value init;
+    __builtin_memset(&init, 0, sizeof(init));
+    bpf_map_update_elem(&snoop_flows, &key, &init, BPF_NOEXIST);
+    value = bpf_map_lookup_elem(&snoop_flows, &key);
+  }
+  if (value)
+  {
+    value->packets++;
+    value->bytes += (__u64)(dataEnd - data);
+    if (drop) value->drops++;
+  }
+
+  count_stat(drop ? SNOOP_XDP_STAT_DROP : SNOOP_XDP_STAT_PASS);
+  return drop ? XDP_DROP : XDP_PASS;
+}
+
+char _license[] SEC("license") = "GPL";
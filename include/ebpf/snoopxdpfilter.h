@@ -0,0 +1,64 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_XDP_FILTER_H__
+#define __SNOOP_XDP_FILTER_H__
+
+//
+// Shared by snoopxdpfilter.bpf.c(kernel) and SnoopXdpOffload(user). Addresses and ports in network byte order.
+//
+#include <linux/types.h>
+
+#define SNOOP_XDP_MAX_RULES 64
+
+struct snoop_xdp_rule
+{
+  __u32 saddr;
+  __u32 smask;
+  __u32 daddr;
+  __u32 dmask;
+  __u16 sport; // 0 : any
+  __u16 dport; // 0 : any
+  __u8  proto; // 0 : any
+  __u8  pad[3];
+};
+
+struct snoop_xdp_config
+{
+  __u32 ruleCount; // 0 : nothing dropped, flows are counted only
+  __u32 pad;
+};
+
+struct snoop_xdp_flow_key
+{
+  __u32 saddr;
+  __u32 daddr;
+  __u16 sport;
+  __u16 dport;
+  __u8  proto;
+  __u8  pad[3];
+};
+
+struct snoop_xdp_flow_value
+{
+  __u64 packets;
+  __u64 bytes;
+  __u64 drops;
+};
+
+enum
+{
+  SNOOP_XDP_STAT_PASS,
+  SNOOP_XDP_STAT_DROP,
+  SNOOP_XDP_STAT_OTHER, // not untagged IPv4, always passed
+  SNOOP_XDP_STAT_MAX
+};
+
+#endif // __SNOOP_XDP_FILTER_H__
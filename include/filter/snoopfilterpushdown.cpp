@@ -0,0 +1,49 @@
+#include <SnoopFilterPushdown>
+#include <SnoopBpFilter>
+#include <VGraph>
+#include <VDebugNew>
+
+// ----------------------------------------------------------------------------
+// SnoopFilterPushdown
+// ----------------------------------------------------------------------------
+QString SnoopFilterPushdown::downstreamFilter(SnoopCapture* capture, int dataLink)
+{
+  VGraph* graph = (VGraph*)capture->owner;
+  if (graph == NULL) return "";
+
+  QStringList filterList;
+  int _count = graph->connectList.count();
+  for (int i = 0; i < _count; i++)
+  {
+    VGraphConnect connect = (VGraphConnect&)graph->connectList.at(i);
+    if (connect.sender != capture->name) continue;
+
+    //
+    // Any other outgoing connection(capturedBurst included) may need packets the filter would drop.
+    //
+    if (connect.signal != "captured(SnoopPacket*)") return "";
+    SnoopBpFilter* bpFilter = dynamic_cast<SnoopBpFilter*>(graph->objectList.findByName(connect.receiver));
+    if (bpFilter == NULL || connect.slot != "check(SnoopPacket*)") return "";
+    if (bpFilter->filter == "" || bpFilter->linkType != dataLink) return "";
+
+    //
+    // Packets rejected by the filter are still wanted when its nak goes somewhere.
+    //
+    for (int j = 0; j < _count; j++)
+    {
+      VGraphConnect other = (VGraphConnect&)graph->connectList.at(j);
+      if (other.sender == bpFilter->name && other.signal == "nak(SnoopPacket*)") return "";
+    }
+
+    QString expr = "(" + bpFilter->filter + ")";
+    if (!filterList.contains(expr)) filterList.push_back(expr);
+  }
+  return filterList.join(" or ");
+}
+
+QString SnoopFilterPushdown::combine(QString own, QString pushed)
+{
+  if (pushed == "") return own;
+  if (own == "") return pushed;
+  return "(" + own + ") and (" + pushed + ")";
+}
@@ -0,0 +1,36 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_FILTER_PUSHDOWN_H__
+#define __SNOOP_FILTER_PUSHDOWN_H__
+
+#include <SnoopCapture>
+
+// ----------------------------------------------------------------------------
+// SnoopFilterPushdown
+// ----------------------------------------------------------------------------
+/// Moves SnoopBpFilter expressions of a graph into the kernel filter of the capture feeding them
+class SnoopFilterPushdown
+{
+public:
+  //
+  // Returns "(f1) or (f2) ..." when every outgoing connection of capture is captured(SnoopPacket*)
+  // to check(SnoopPacket*) of a SnoopBpFilter whose nak is not used, otherwise "".
+  // Filters compiled for another link type than dataLink are not pushed down.
+  //
+  static QString downstreamFilter(SnoopCapture* capture, int dataLink);
+
+  //
+  // Own filter of capture and pushed down filter joined with "and"(either may be empty).
+  //
+  static QString combine(QString own, QString pushed);
+};
+
+#endif // __SNOOP_FILTER_PUSHDOWN_H__
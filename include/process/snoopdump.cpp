@@ -77,7 +77,10 @@ bool SnoopDump::doClose()
 void SnoopDump::dump(SnoopPacket* packet)
 {
   LOG_ASSERT(m_pcap_dumper != NULL);
-  pcap_dump((u_char*)m_pcap_dumper, packet->pktHdr, (const u_char*)packet->pktData);
+  {
+    VLock lock(*this);
+    pcap_dump((u_char*)m_pcap_dumper, packet->pktHdr, (const u_char*)packet->pktData);
+  }
   emit dumped(packet);
 }
 
@@ -12,13 +12,15 @@
 #define __SNOOP_DUMP_H__
 
 #include <SnoopProcess>
+#include <VLock>
 
 // ----------------------------------------------------------------------------
 // SnoopDump
 // ----------------------------------------------------------------------------
-class SnoopDump : public SnoopProcess
+class SnoopDump : public SnoopProcess, public VLockable
 {
   Q_OBJECT
+  Q_CLASSINFO("fanout", "shared") // fanout workers write into one file
 
 public:
   static const char* DEFAULT_DUMP_FILE_NAME;
@@ -11,11 +11,15 @@
 #include <SnoopFlowMgr>
 #include <SnoopFlowMgrTest>
 #include <SnoopDump>
+#include <SnoopReactor>
+#include <SnoopRemoteServer>
+#include <SnoopShmPipeWriter>
 #include <SnoopTcpBlock>
 #include <SnoopUdpReceiver>
 #include <SnoopUdpSender>
 #include <SnoopWriteAdapter>
 #include <SnoopWriteWinDivert>
+#include <SnoopXdpOffload>
 #include <VDebugNew>
 
 // ----------------------------------------------------------------------------
@@ -34,11 +38,19 @@ void SnoopProcessFactory::explicitLink()
   SnoopFlowChange     flowChange;
   SnoopFlowMgr        flowMgr;
   SnoopFlowMgrTest    flowMgrTest;
+#ifdef linux
+  SnoopReactor        reactor;
+  SnoopRemoteServer   remoteServer;
+  SnoopShmPipeWriter  shmPipeWriter;
+#endif // linux
   SnoopTcpBlock       tcpBlock;
   SnoopUdpReceiver    udpReceiver;
   SnoopUdpSender      udpSender;
   SnoopWriteAdapter   writeAdapter;
   SnoopWriteWinDivert writeWinDivert;
+#if defined(linux) && defined(SNOOP_XDP)
+  SnoopXdpOffload     xdpOffload;
+#endif // linux && SNOOP_XDP
 }
 
 SnoopProcess* SnoopProcessFactory::createDefaultProcess()
@@ -0,0 +1,346 @@
+#include <SnoopReactor>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+REGISTER_METACLASS(SnoopReactor, SnoopProcess)
+
+static const UINT32 WAKE_INDEX = 0xFFFFFFFF; // epoll data of m_wakeFd
+static const int    MAX_EVENTS = 64;
+
+// ----------------------------------------------------------------------------
+// SnoopReactorThread
+// ----------------------------------------------------------------------------
+SnoopReactorThread::SnoopReactorThread(SnoopReactor* reactor) : VThread(reactor)
+{
+  this->reactor = reactor;
+}
+
+SnoopReactorThread::~SnoopReactorThread()
+{
+  close();
+}
+
+int SnoopReactorThread::serve(SnoopReactorItem& item)
+{
+  int res = 0;
+  item.pending = false;
+  for (int i = 0; i < reactor->maxDispatch; i++)
+  {
+    int n = item.capture->dispatch();
+    if (n == 0) return res;
+    if (n < 0)
+    {
+      reactor->remove(item);
+      return res;
+    }
+    res++;
+  }
+  item.pending = true;
+  return res;
+}
+
+void SnoopReactorThread::run()
+{
+  QList<SnoopReactorItem>& items = reactor->items;
+  epoll_event events[MAX_EVENTS];
+  int idle = 0;
+  while (active())
+  {
+    int pending = 0;
+    {
+      VLock lock(*reactor);
+      for (int i = 0; i < items.count(); i++)
+        if (items[i].live && items[i].pending) pending++;
+    }
+
+    //
+    // Busy-poll(timeout 0) while traffic keeps coming, otherwise block in kernel.
+    // Captures attached meanwhile wake the blocking wait through m_wakeFd.
+    //
+    int timeout = (pending > 0 || idle < reactor->spinCount) ? 0 : reactor->waitTimeout;
+    int n = epoll_wait(reactor->m_epfd, events, MAX_EVENTS, timeout);
+    if (n == -1)
+    {
+      if (errno == EINTR) continue;
+      LOG_ERROR("epoll_wait return -1 errno=%d", errno);
+      break;
+    }
+
+    //
+    // Captures are attached and detached by their own open and close under the same lock,
+    // so one round never serves a capture being closed.
+    //
+    VLock lock(*reactor);
+    int served = 0;
+    for (int i = 0; i < n; i++)
+    {
+      UINT32 index = events[i].data.u32;
+      if (index == WAKE_INDEX)
+      {
+        eventfd_t value;
+        eventfd_read(reactor->m_wakeFd, &value);
+        continue;
+      }
+      if ((int)index < items.count()) items[index].pending = true;
+    }
+    for (int i = 0; i < items.count(); i++)
+    {
+      SnoopReactorItem& item = items[i];
+      if (item.live && item.pending) served += serve(item);
+    }
+    if (served > 0) idle = 0; else if (idle < reactor->spinCount) idle++;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// SnoopReactor
+// ----------------------------------------------------------------------------
+SnoopReactor::SnoopReactor(void* owner) : SnoopProcess(owner)
+{
+  captureNames = "";
+  spinCount    = 1000;
+  waitTimeout  = 100; // 100 msec
+  maxDispatch  = 64;
+  thread       = NULL;
+  m_epfd       = -1;
+  m_wakeFd     = -1;
+}
+
+SnoopReactor::~SnoopReactor()
+{
+  close();
+}
+
+int SnoopReactor::indexOf(SnoopCapture* capture)
+{
+  for (int i = 0; i < items.count(); i++)
+    if (items[i].capture == capture) return i;
+  return -1;
+}
+
+void SnoopReactor::remove(SnoopReactorItem& item)
+{
+  if (!item.live) return;
+  epoll_ctl(m_epfd, EPOLL_CTL_DEL, item.fd, NULL);
+  item.live    = false;
+  item.pending = false;
+  item.capture->dispatchEnd();
+}
+
+void SnoopReactor::attach(SnoopCapture* capture)
+{
+  VLock lock(*this);
+  int i = indexOf(capture);
+  if (i == -1)
+  {
+    LOG_ERROR("capture(%s) is not served by reactor(%s)", qPrintable(capture->name), qPrintable(name));
+    return;
+  }
+  SnoopReactorItem& item = items[i];
+  if (item.live) return;
+
+  pcap* _pcap = item.capture->m_pcap;
+  if (_pcap == NULL)
+  {
+    LOG_ERROR("capture(%s) has no pcap handle", qPrintable(capture->name));
+    return;
+  }
+  char errBuf[PCAP_ERRBUF_SIZE];
+  if (pcap_setnonblock(_pcap, 1, errBuf) == -1)
+  {
+    LOG_ERROR("pcap_setnonblock(%s) return -1(%s)", qPrintable(capture->name), errBuf);
+    return;
+  }
+  item.fd = pcap_get_selectable_fd(_pcap);
+  if (item.fd == -1)
+  {
+    LOG_ERROR("pcap_get_selectable_fd(%s) return -1", qPrintable(capture->name));
+    return;
+  }
+  epoll_event event;
+  event.events   = EPOLLIN;
+  event.data.u32 = (UINT32)i;
+  if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, item.fd, &event) == -1)
+  {
+    LOG_ERROR("epoll_ctl(%s) return -1 errno=%d", qPrintable(capture->name), errno);
+    return;
+  }
+  item.live    = true;
+  item.pending = true; // libpcap may already hold packets
+  item.capture->dispatchBegin();
+  eventfd_write(m_wakeFd, 1);
+}
+
+void SnoopReactor::detach(SnoopCapture* capture)
+{
+  VLock lock(*this);
+  int i = indexOf(capture);
+  if (i != -1) remove(items[i]);
+}
+
+bool SnoopReactor::doOpen()
+{
+  VGraph* graph = (VGraph*)owner;
+  if (graph == NULL)
+  {
+    SET_ERROR(SnoopError, "reactor is not owned by graph", VERR_OBJECT_IS_NULL);
+    return false;
+  }
+
+  items.clear();
+  QStringList names = captureNames.split(';', QString::SkipEmptyParts);
+  int _count = graph->objectList.count();
+  for (int i = 0; i < _count; i++)
+  {
+    SnoopPcap* capture = dynamic_cast<SnoopPcap*>(graph->objectList.at(i));
+    if (capture == NULL || !capture->enabled) continue;
+    if (names.isEmpty())
+    {
+      if (capture->autoRead) continue;
+    } else
+    {
+      if (!names.contains(capture->name)) continue;
+      //
+      // Reactor overrides autoRead through capture->driver, the property itself is kept.
+      //
+      if (capture->autoRead && capture->active())
+      {
+        SET_ERROR(SnoopError, qformat("capture(%s) is already reading by itself, set autoRead false", qPrintable(capture->name)), VERR_FAIL);
+        return false;
+      }
+    }
+    if (capture->driver != NULL)
+    {
+      SET_ERROR(SnoopError, qformat("capture(%s) is already driven by another thread", qPrintable(capture->name)), VERR_FAIL);
+      return false;
+    }
+    SnoopReactorItem item;
+    item.capture = capture;
+    item.fd      = -1;
+    item.live    = false;
+    item.pending = false;
+    items.push_back(item);
+  }
+  if (items.isEmpty())
+  {
+    SET_ERROR(SnoopError, "no capture to serve", VERR_CAN_NOT_FIND_OBJECT);
+    return false;
+  }
+
+  m_epfd = epoll_create1(0);
+  if (m_epfd == -1)
+  {
+    SET_ERROR(SnoopError, qformat("epoll_create1 return -1 errno=%d", errno), VERR_FAIL);
+    return false;
+  }
+  m_wakeFd = eventfd(0, EFD_NONBLOCK);
+  if (m_wakeFd == -1)
+  {
+    SET_ERROR(SnoopError, qformat("eventfd return -1 errno=%d", errno), VERR_FAIL);
+    return false;
+  }
+  epoll_event event;
+  event.events   = EPOLLIN;
+  event.data.u32 = WAKE_INDEX;
+  if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_wakeFd, &event) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("epoll_ctl return -1 errno=%d", errno), VERR_FAIL);
+    return false;
+  }
+
+  thread = new SnoopReactorThread(this);
+  thread->open();
+
+  //
+  // Captures opened later in graph attach themselves in their doOpen,
+  // the ones already opened(autoRead false) are attached here.
+  //
+  for (int i = 0; i < items.count(); i++)
+  {
+    SnoopPcap* capture = items[i].capture;
+    capture->driver = this;
+    if (capture->active()) attach(capture);
+  }
+
+  return SnoopProcess::doOpen();
+}
+
+bool SnoopReactor::doClose()
+{
+  if (thread != NULL)
+  {
+    thread->close(false);
+    if (m_wakeFd != -1) eventfd_write(m_wakeFd, 1);
+    SAFE_DELETE(thread);
+  }
+  {
+    VLock lock(*this);
+    for (int i = 0; i < items.count(); i++)
+    {
+      remove(items[i]);
+      items[i].capture->driver = NULL;
+    }
+    items.clear();
+  }
+  if (m_wakeFd != -1)
+  {
+    ::close(m_wakeFd);
+    m_wakeFd = -1;
+  }
+  if (m_epfd != -1)
+  {
+    ::close(m_epfd);
+    m_epfd = -1;
+  }
+
+  return SnoopProcess::doClose();
+}
+
+void SnoopReactor::load(VXml xml)
+{
+  SnoopProcess::load(xml);
+
+  captureNames = xml.getStr("captureNames", captureNames);
+  spinCount    = xml.getInt("spinCount", spinCount);
+  waitTimeout  = xml.getInt("waitTimeout", waitTimeout);
+  maxDispatch  = xml.getInt("maxDispatch", maxDispatch);
+}
+
+void SnoopReactor::save(VXml xml)
+{
+  SnoopProcess::save(xml);
+
+  xml.setStr("captureNames", captureNames);
+  xml.setInt("spinCount", spinCount);
+  xml.setInt("waitTimeout", waitTimeout);
+  xml.setInt("maxDispatch", maxDispatch);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopReactor::optionAddWidget(QLayout* layout)
+{
+  SnoopProcess::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leCaptureNames", "Capture Names", captureNames);
+  VOptionable::addLineEdit(layout, "leSpinCount",    "Spin Count",    QString::number(spinCount));
+  VOptionable::addLineEdit(layout, "leWaitTimeout",  "Wait Timeout",  QString::number(waitTimeout));
+  VOptionable::addLineEdit(layout, "leMaxDispatch",  "Max Dispatch",  QString::number(maxDispatch));
+}
+
+void SnoopReactor::optionSaveDlg(QDialog* dialog)
+{
+  SnoopProcess::optionSaveDlg(dialog);
+
+  captureNames = dialog->findChild<QLineEdit*>("leCaptureNames")->text();
+  spinCount    = dialog->findChild<QLineEdit*>("leSpinCount")->text().toInt();
+  waitTimeout  = dialog->findChild<QLineEdit*>("leWaitTimeout")->text().toInt();
+  maxDispatch  = dialog->findChild<QLineEdit*>("leMaxDispatch")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
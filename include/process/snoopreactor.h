@@ -0,0 +1,110 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_REACTOR_H__
+#define __SNOOP_REACTOR_H__
+
+#include <SnoopProcess>
+#include <SnoopPcap>
+#include <VThread>
+#include <VLock>
+
+#ifdef linux
+
+// ----------------------------------------------------------------------------
+// SnoopReactorItem
+// ----------------------------------------------------------------------------
+class SnoopReactorItem
+{
+public:
+  SnoopPcap* capture; // reference
+  int        fd;      // pcap_get_selectable_fd
+  bool       live;    // still in epoll set(attached)
+  bool       pending; // left packets in last round(libpcap may buffer them out of fd readiness)
+};
+
+// ----------------------------------------------------------------------------
+// SnoopReactorThread
+// ----------------------------------------------------------------------------
+class SnoopReactor;
+class SnoopReactorThread : public VThread
+{
+public:
+  SnoopReactorThread(SnoopReactor* reactor);
+  virtual ~SnoopReactorThread();
+
+protected:
+  SnoopReactor* reactor; // reference
+
+protected:
+  int serve(SnoopReactorItem& item);
+
+protected:
+  virtual void run();
+};
+
+// ----------------------------------------------------------------------------
+// SnoopReactor
+// ----------------------------------------------------------------------------
+/// Serves many pcap captures(autoRead false) from one epoll thread.
+/// Busy-polls while traffic keeps coming and blocks in epoll_wait when idle.
+/// Each capture is added to epoll set when it opens and removed when it closes,
+/// so captures can be opened and closed in any order while the others keep being served.
+class SnoopReactor : public SnoopProcess, public SnoopCaptureDriver, public VLockable
+{
+  Q_OBJECT
+
+  friend class SnoopReactorThread;
+
+public:
+  SnoopReactor(void* owner = NULL);
+  virtual ~SnoopReactor();
+
+  //
+  // Properties
+  //
+public:
+  QString captureNames; // ';' separated(empty : every pcap capture whose autoRead is false)
+  int     spinCount;    // empty polls before blocking wait
+  int     waitTimeout;  // msec, blocking wait
+  int     maxDispatch;  // reads per capture in one round
+
+protected:
+  QList<SnoopReactorItem> items; // guarded by lock, index is epoll data
+  SnoopReactorThread*     thread;
+  int                     m_epfd;
+  int                     m_wakeFd; // eventfd waking epoll_wait when a capture is attached
+
+protected:
+  int  indexOf(SnoopCapture* capture);
+  void remove(SnoopReactorItem& item);
+
+public:
+  virtual void attach(SnoopCapture* capture);
+  virtual void detach(SnoopCapture* capture);
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_REACTOR_H__
@@ -0,0 +1,558 @@
+#include <SnoopRemoteServer>
+#include <QVector>
+#include <VDebugNew>
+
+#ifdef linux
+
+#include <errno.h>
+#include <endian.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+REGISTER_METACLASS(SnoopRemoteServer, SnoopProcess)
+
+static const int SNOOP_REMOTE_WAIT_TIMEOUT = 5000; // msec, for handshake
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteSession
+// ----------------------------------------------------------------------------
+SnoopRemoteSession::SnoopRemoteSession()
+{
+  sock       = -1;
+  peer       = "";
+  snapLen    = snoop::DEFAULT_SNAPLEN;
+  compress   = false;
+  m_pcap     = NULL;
+  filtered   = false;
+  dead       = false;
+  acceptTick = 0;
+  count      = 0;
+  firstTick  = 0;
+  packets    = 0;
+  drops      = 0;
+  batch.resize(sizeof(SNOOP_REMOTE_BATCH_HDR));
+}
+
+SnoopRemoteSession::~SnoopRemoteSession()
+{
+  if (filtered)
+  {
+    pcap_freecode(&code);
+    filtered = false;
+  }
+  if (m_pcap != NULL)
+  {
+    pcap_close(m_pcap);
+    m_pcap = NULL;
+  }
+  if (sock != -1)
+  {
+    ::close(sock);
+    sock = -1;
+  }
+}
+
+bool SnoopRemoteSession::match(SnoopPacket* packet)
+{
+  if (!filtered) return true;
+  return pcap_offline_filter(&code, packet->pktHdr, packet->pktData) != 0;
+}
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteServerThread
+// ----------------------------------------------------------------------------
+SnoopRemoteServerThread::SnoopRemoteServerThread(SnoopRemoteServer* server) : VThread(server)
+{
+  this->server = server;
+}
+
+SnoopRemoteServerThread::~SnoopRemoteServerThread()
+{
+  close();
+}
+
+void SnoopRemoteServerThread::accept()
+{
+  sockaddr_in addr;
+  socklen_t   addrLen = sizeof(addr);
+  int sock = ::accept(server->m_acceptSock, (sockaddr*)&addr, &addrLen);
+  if (sock == -1)
+  {
+    if (errno != EINTR && errno != EAGAIN) LOG_ERROR("accept return -1(%s)", strerror(errno));
+    return;
+  }
+  QString address = inet_ntoa(addr.sin_addr);
+  QString peer    = qformat("%s:%d", qPrintable(address), ntohs(addr.sin_port));
+
+  if (!server->allowed(address))
+  {
+    LOG_WARN("%s is not in allowedPeers, refused", qPrintable(peer));
+    ::close(sock);
+    return;
+  }
+
+  int _count;
+  {
+    VLock lock(*server);
+    _count = server->sessions.count() + pending.count();
+  }
+  if (_count >= server->maxClients)
+  {
+    LOG_WARN("too many clients(%d), %s refused", _count, qPrintable(peer));
+    ::close(sock);
+    return;
+  }
+
+  SnoopRemoteSession* session = new SnoopRemoteSession;
+  session->sock       = sock;
+  session->peer       = peer;
+  session->acceptTick = tick();
+  pending.push_back(session);
+}
+
+void SnoopRemoteServerThread::handshakes(pollfd* fds, bool polled)
+{
+  VTick now = tick();
+  for (int i = pending.count() - 1; i >= 0; i--)
+  {
+    SnoopRemoteSession* session = pending.at(i);
+    int res = 0;
+    if (polled && fds[i].revents != 0) res = server->handshake(session);
+    if (res == 0 && now - session->acceptTick >= (VTick)SNOOP_REMOTE_WAIT_TIMEOUT)
+    {
+      LOG_WARN("handshake timeout(%s)", qPrintable(session->peer));
+      res = -1;
+    }
+    if (res == 0) continue;
+
+    pending.removeAt(i);
+    if (res < 0)
+    {
+      delete session;
+      continue;
+    }
+    VLock lock(*server);
+    server->sessions.push_back(session);
+  }
+}
+
+void SnoopRemoteServerThread::run()
+{
+  int timeout = server->flushInterval > 0 ? server->flushInterval : 1;
+  QVector<pollfd> fds;
+  while (active())
+  {
+    //
+    // fds[0] is listening socket, the rest are sockets of pending in the same order.
+    //
+    fds.resize(1 + pending.count());
+    fds[0].fd      = server->m_acceptSock;
+    fds[0].events  = POLLIN;
+    fds[0].revents = 0;
+    for (int i = 0; i < pending.count(); i++)
+    {
+      fds[1 + i].fd      = pending.at(i)->sock;
+      fds[1 + i].events  = POLLIN;
+      fds[1 + i].revents = 0;
+    }
+    int n = poll(fds.data(), (nfds_t)fds.count(), timeout);
+    if (n < 0 && errno != EINTR)
+    {
+      LOG_ERROR("poll return -1(%s)", strerror(errno));
+      break;
+    }
+    handshakes(fds.data() + 1, n > 0);
+    if (n > 0 && fds[0].revents != 0) accept();
+    server->flushIdle();
+    server->removeDead();
+  }
+
+  foreach (SnoopRemoteSession* session, pending)
+    delete session;
+  pending.clear();
+}
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteServer
+// ----------------------------------------------------------------------------
+SnoopRemoteServer::SnoopRemoteServer(void* owner) : SnoopProcess(owner)
+{
+  bindAddress   = "127.0.0.1";
+  secret        = "";
+  allowedPeers  = "";
+  port          = SnoopRemoteProto::DEFAULT_PORT;
+  linkType      = DLT_EN10MB;
+  batchCount    = 256;
+  batchBytes    = 64 * 1024; // 64 KB
+  flushInterval = 10; // 10 msec
+  maxClients    = 8;
+
+  m_acceptSock  = -1;
+  thread        = NULL;
+}
+
+SnoopRemoteServer::~SnoopRemoteServer()
+{
+  close();
+}
+
+bool SnoopRemoteServer::doOpen()
+{
+  if (batchBytes <= 0 || batchBytes > SnoopRemoteProto::MAX_BATCH / 2)
+  {
+    SET_ERROR(SnoopError, qformat("invalid batchBytes(%d)", batchBytes), VERR_FAIL);
+    return false;
+  }
+
+  m_acceptSock = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_acceptSock == -1)
+  {
+    SET_ERROR(SnoopError, qformat("error in socket(%s)", strerror(errno)), VERR_IN_SOCKET);
+    return false;
+  }
+  int on = 1;
+  setsockopt(m_acceptSock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons((UINT16)port);
+  if (bindAddress != "" && inet_aton(qPrintable(bindAddress), &addr.sin_addr) == 0)
+  {
+    SET_ERROR(SnoopError, qformat("invalid bindAddress(%s)", qPrintable(bindAddress)), VERR_FAIL);
+    return false;
+  }
+  if (bind(m_acceptSock, (sockaddr*)&addr, sizeof(addr)) == -1 || listen(m_acceptSock, 8) == -1)
+  {
+    SET_ERROR(SnoopError, qformat("can not listen on %s:%d(%s)", inet_ntoa(addr.sin_addr), port, strerror(errno)), VERR_IN_BIND);
+    return false;
+  }
+  if (secret == "" && addr.sin_addr.s_addr != htonl(INADDR_LOOPBACK))
+    LOG_WARN("listening on %s:%d without secret", inet_ntoa(addr.sin_addr), port);
+
+  thread = new SnoopRemoteServerThread(this);
+  thread->open();
+
+  return SnoopProcess::doOpen();
+}
+
+bool SnoopRemoteServer::doClose()
+{
+  SAFE_DELETE(thread);
+  if (m_acceptSock != -1)
+  {
+    ::close(m_acceptSock);
+    m_acceptSock = -1;
+  }
+
+  VLock lock(*this);
+  foreach (SnoopRemoteSession* session, sessions)
+  {
+    if (!session->dead) flush(session);
+    LOG_INFO("%s packets=%llu drops=%llu", qPrintable(session->peer), session->packets, session->drops);
+    delete session;
+  }
+  sessions.clear();
+
+  return SnoopProcess::doClose();
+}
+
+bool SnoopRemoteServer::allowed(QString address)
+{
+  if (allowedPeers == "") return true;
+  QStringList peers = allowedPeers.split(';', QString::SkipEmptyParts);
+  foreach (QString peer, peers)
+    if (peer.trimmed() == address) return true;
+  return false;
+}
+
+int SnoopRemoteServer::handshake(SnoopRemoteSession* session)
+{
+  //
+  // Takes only what has arrived(hello first, then filter and secret), never waits for the rest.
+  //
+  int hdrLen = (int)sizeof(SNOOP_REMOTE_HELLO);
+  int filterLen = 0, secretLen = 0;
+  while (true)
+  {
+    int need = hdrLen;
+    if (session->in.size() >= hdrLen)
+    {
+      SNOOP_REMOTE_HELLO* hello = (SNOOP_REMOTE_HELLO*)session->in.constData();
+      if (ntohl(hello->magic) != SnoopRemoteProto::MAGIC || ntohs(hello->version) != SnoopRemoteProto::VERSION)
+      {
+        LOG_WARN("invalid hello from %s", qPrintable(session->peer));
+        return -1;
+      }
+      filterLen = (int)ntohl(hello->filterLen);
+      secretLen = (int)ntohl(hello->secretLen);
+      if (filterLen < 0 || filterLen > SnoopRemoteProto::MAX_FILTER || secretLen < 0 || secretLen > SnoopRemoteProto::MAX_SECRET)
+      {
+        LOG_WARN("invalid hello(filterLen=%d secretLen=%d) from %s", filterLen, secretLen, qPrintable(session->peer));
+        return -1;
+      }
+      need = hdrLen + filterLen + secretLen;
+    }
+    if (session->in.size() >= need) break;
+
+    int old = session->in.size();
+    session->in.resize(need);
+    ssize_t res = recv(session->sock, session->in.data() + old, (size_t)(need - old), MSG_DONTWAIT);
+    if (res <= 0)
+    {
+      session->in.resize(old);
+      if (res < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+      LOG_WARN("%s closed in handshake", qPrintable(session->peer));
+      return -1;
+    }
+    session->in.resize(old + (int)res);
+  }
+
+  SNOOP_REMOTE_HELLO hello;
+  memcpy(&hello, session->in.constData(), sizeof(hello));
+  QByteArray filter  = session->in.mid(hdrLen, filterLen);
+  QByteArray _secret = session->in.mid(hdrLen + filterLen, secretLen);
+  session->in.clear();
+
+  int snapLen = (int)ntohl(hello.snapLen);
+  if (snapLen > 0 && snapLen < session->snapLen) session->snapLen = snapLen;
+  session->compress = (ntohs(hello.flags) & SnoopRemoteProto::FLAG_LZ4) != 0 && SnoopRemoteProto::lz4Supported();
+
+  //
+  // Filter runs here, so that only what client needs goes on the wire.
+  //
+  QByteArray msg;
+  UINT32     status = 0;
+  if (!SnoopRemoteProto::sameSecret(secret.toUtf8(), _secret))
+  {
+    msg    = "authentication failed";
+    status = 1;
+  } else if (!filter.isEmpty())
+  {
+    session->m_pcap = pcap_open_dead(linkType, session->snapLen);
+    if (session->m_pcap == NULL)
+    {
+      msg    = "error in pcap_open_dead";
+      status = 1;
+    } else if (pcap_compile(session->m_pcap, &session->code, filter.constData(), 1, 0xFFFFFFFF) < 0)
+    {
+      msg    = QByteArray("error in pcap_compile(") + pcap_geterr(session->m_pcap) + ")";
+      status = 1;
+    } else
+      session->filtered = true;
+  }
+
+  //
+  // Reply is small enough for empty send buffer of new socket, so sendAll does not wait here.
+  //
+  int sock = session->sock;
+  SNOOP_REMOTE_REPLY reply;
+  reply.magic    = htonl(SnoopRemoteProto::MAGIC);
+  reply.version  = htons(SnoopRemoteProto::VERSION);
+  reply.flags    = htons(session->compress ? SnoopRemoteProto::FLAG_LZ4 : 0);
+  reply.linkType = htonl((UINT32)linkType);
+  reply.status   = htonl(status);
+  reply.msgLen   = htonl((UINT32)msg.size());
+  bool sent = SnoopRemoteProto::sendAll(sock, &reply, sizeof(reply)) && SnoopRemoteProto::sendAll(sock, msg.constData(), msg.size());
+  if (!sent || status != 0)
+  {
+    LOG_WARN("client %s refused(%s)", qPrintable(session->peer), msg.constData());
+    return -1;
+  }
+
+  int sndBuf = SnoopRemoteProto::MAX_BATCH;
+  setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sndBuf, sizeof(sndBuf));
+  int on = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  session->batch.reserve((int)sizeof(SNOOP_REMOTE_BATCH_HDR) + batchBytes + (int)sizeof(SNOOP_REMOTE_PKT_HDR) + session->snapLen);
+  LOG_INFO("client %s connected(filter=\"%s\" snapLen=%d compress=%d)", qPrintable(session->peer), filter.constData(), session->snapLen, session->compress);
+  return 1;
+}
+
+void SnoopRemoteServer::flush(SnoopRemoteSession* session)
+{
+  //
+  // Bytes of a frame partly taken by kernel go first, otherwise stream would be broken.
+  //
+  if (!session->out.isEmpty())
+  {
+    ssize_t res = send(session->sock, session->out.constData(), (size_t)session->out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res < 0 && errno != EAGAIN && errno != EINTR)
+    {
+      session->dead = true;
+      return;
+    }
+    if (res > 0) session->out.remove(0, (int)res);
+  }
+  if (session->count == 0) return;
+
+  if (!session->out.isEmpty())
+  {
+    session->drops += session->count; // client lags
+  } else
+  {
+    int   rawLen = session->batch.size() - (int)sizeof(SNOOP_REMOTE_BATCH_HDR);
+    BYTE* raw    = (BYTE*)session->batch.data() + sizeof(SNOOP_REMOTE_BATCH_HDR);
+    QByteArray* frame = &session->batch;
+    int   len    = rawLen;
+    UINT32 flags = 0;
+    if (session->compress)
+    {
+      int bound = SnoopRemoteProto::compressBound(rawLen);
+      session->frame.resize((int)sizeof(SNOOP_REMOTE_BATCH_HDR) + bound);
+      int res = SnoopRemoteProto::compress(raw, rawLen, (BYTE*)session->frame.data() + sizeof(SNOOP_REMOTE_BATCH_HDR), bound);
+      if (res > 0)
+      {
+        frame = &session->frame;
+        len   = res;
+        flags = SnoopRemoteProto::FLAG_LZ4;
+      }
+    }
+
+    SNOOP_REMOTE_BATCH_HDR* hdr = (SNOOP_REMOTE_BATCH_HDR*)frame->data();
+    hdr->len    = htonl((UINT32)len);
+    hdr->rawLen = htonl((UINT32)rawLen);
+    hdr->count  = htonl((UINT32)session->count);
+    hdr->flags  = htonl(flags);
+    hdr->drops  = htobe64(session->drops);
+
+    int total = (int)sizeof(SNOOP_REMOTE_BATCH_HDR) + len;
+    ssize_t res = send(session->sock, frame->constData(), (size_t)total, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res < 0)
+    {
+      if (errno == EAGAIN || errno == EINTR)
+        session->drops += session->count; // nothing of frame went, so stream is intact
+      else
+        session->dead = true;
+    } else if (res < total)
+    {
+      session->out.append(frame->constData() + res, total - (int)res);
+    }
+  }
+
+  session->batch.resize(sizeof(SNOOP_REMOTE_BATCH_HDR));
+  session->count = 0;
+}
+
+void SnoopRemoteServer::flushIdle()
+{
+  VLock lock(*this);
+  VTick now = tick();
+  foreach (SnoopRemoteSession* session, sessions)
+  {
+    if (session->dead) continue;
+    if (session->count > 0 && now - session->firstTick < (VTick)flushInterval && session->out.isEmpty()) continue;
+    if (session->count > 0 || !session->out.isEmpty()) flush(session);
+  }
+}
+
+void SnoopRemoteServer::removeDead()
+{
+  VLock lock(*this);
+  for (int i = sessions.count() - 1; i >= 0; i--)
+  {
+    SnoopRemoteSession* session = sessions.at(i);
+    if (!session->dead) continue;
+    LOG_INFO("client %s disconnected(packets=%llu drops=%llu)", qPrintable(session->peer), session->packets, session->drops);
+    sessions.removeAt(i);
+    delete session;
+  }
+}
+
+void SnoopRemoteServer::write(SnoopPacket* packet)
+{
+  VLock lock(*this);
+  foreach (SnoopRemoteSession* session, sessions)
+  {
+    if (session->dead || !session->match(packet)) continue;
+
+    int caplen = (int)packet->pktHdr->caplen;
+    if (caplen > session->snapLen) caplen = session->snapLen;
+    if (session->count == 0) session->firstTick = tick();
+
+    SNOOP_REMOTE_PKT_HDR hdr;
+    hdr.tsSec  = htonl((UINT32)packet->pktHdr->ts.tv_sec);
+    hdr.tsUsec = htonl((UINT32)packet->pktHdr->ts.tv_usec);
+    hdr.tsNsec = htonl(packet->tsNsec);
+    hdr.caplen = htonl((UINT32)caplen);
+    hdr.len    = htonl(packet->pktHdr->len);
+    session->batch.append((const char*)&hdr, sizeof(hdr));
+    session->batch.append((const char*)packet->pktData, caplen);
+    session->count++;
+    session->packets++;
+
+    int payload = session->batch.size() - (int)sizeof(SNOOP_REMOTE_BATCH_HDR);
+    if (session->count >= batchCount || payload >= batchBytes || tick() - session->firstTick >= (VTick)flushInterval)
+      flush(session);
+  }
+}
+
+void SnoopRemoteServer::load(VXml xml)
+{
+  SnoopProcess::load(xml);
+
+  bindAddress   = xml.getStr("bindAddress", bindAddress);
+  secret        = xml.getStr("secret", secret);
+  allowedPeers  = xml.getStr("allowedPeers", allowedPeers);
+  port          = xml.getInt("port", port);
+  linkType      = xml.getInt("linkType", linkType);
+  batchCount    = xml.getInt("batchCount", batchCount);
+  batchBytes    = xml.getInt("batchBytes", batchBytes);
+  flushInterval = xml.getInt("flushInterval", flushInterval);
+  maxClients    = xml.getInt("maxClients", maxClients);
+}
+
+void SnoopRemoteServer::save(VXml xml)
+{
+  SnoopProcess::save(xml);
+
+  xml.setStr("bindAddress", bindAddress);
+  xml.setStr("secret", secret);
+  xml.setStr("allowedPeers", allowedPeers);
+  xml.setInt("port", port);
+  xml.setInt("linkType", linkType);
+  xml.setInt("batchCount", batchCount);
+  xml.setInt("batchBytes", batchBytes);
+  xml.setInt("flushInterval", flushInterval);
+  xml.setInt("maxClients", maxClients);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopRemoteServer::optionAddWidget(QLayout* layout)
+{
+  SnoopProcess::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "leBindAddress",   "Bind Address",   bindAddress);
+  VOptionable::addLineEdit(layout, "leSecret",        "Secret",         secret);
+  VOptionable::addLineEdit(layout, "leAllowedPeers",  "Allowed Peers",  allowedPeers);
+  VOptionable::addLineEdit(layout, "lePort",          "Port",           QString::number(port));
+  VOptionable::addLineEdit(layout, "leLinkType",      "Link Type",      QString::number(linkType));
+  VOptionable::addLineEdit(layout, "leBatchCount",    "Batch Count",    QString::number(batchCount));
+  VOptionable::addLineEdit(layout, "leBatchBytes",    "Batch Bytes",    QString::number(batchBytes));
+  VOptionable::addLineEdit(layout, "leFlushInterval", "Flush Interval", QString::number(flushInterval));
+  VOptionable::addLineEdit(layout, "leMaxClients",    "Max Clients",    QString::number(maxClients));
+}
+
+void SnoopRemoteServer::optionSaveDlg(QDialog* dialog)
+{
+  SnoopProcess::optionSaveDlg(dialog);
+
+  bindAddress   = dialog->findChild<QLineEdit*>("leBindAddress")->text();
+  secret        = dialog->findChild<QLineEdit*>("leSecret")->text();
+  allowedPeers  = dialog->findChild<QLineEdit*>("leAllowedPeers")->text();
+  port          = dialog->findChild<QLineEdit*>("lePort")->text().toInt();
+  linkType      = dialog->findChild<QLineEdit*>("leLinkType")->text().toInt();
+  batchCount    = dialog->findChild<QLineEdit*>("leBatchCount")->text().toInt();
+  batchBytes    = dialog->findChild<QLineEdit*>("leBatchBytes")->text().toInt();
+  flushInterval = dialog->findChild<QLineEdit*>("leFlushInterval")->text().toInt();
+  maxClients    = dialog->findChild<QLineEdit*>("leMaxClients")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
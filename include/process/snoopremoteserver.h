@@ -0,0 +1,144 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_REMOTE_SERVER_H__
+#define __SNOOP_REMOTE_SERVER_H__
+
+#include <SnoopProcess>
+#include <SnoopRemoteProto>
+#include <VThread>
+#include <VTick>
+
+#ifdef linux
+
+#include <poll.h>
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteSession
+// ----------------------------------------------------------------------------
+class SnoopRemoteSession
+{
+public:
+  SnoopRemoteSession();
+  virtual ~SnoopRemoteSession();
+
+public:
+  int         sock;
+  QString     peer;
+  int         snapLen;
+  bool        compress;
+  pcap*       m_pcap;   // for filter compile
+  bpf_program code;
+  bool        filtered;
+  bool        dead;
+
+public:
+  QByteArray  in;         // hello, filter and secret being received
+  VTick       acceptTick; // handshake must end in SNOOP_REMOTE_WAIT_TIMEOUT
+
+public:
+  QByteArray  batch;    // SNOOP_REMOTE_BATCH_HDR + payload being built
+  int         count;
+  VTick       firstTick;
+  QByteArray  frame;    // compressed payload
+  QByteArray  out;      // rest of frame send could not take
+  UINT64      packets;
+  UINT64      drops;
+
+public:
+  bool match(SnoopPacket* packet);
+};
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteServerThread
+// ----------------------------------------------------------------------------
+class SnoopRemoteServer;
+class SnoopRemoteServerThread : public VThread
+{
+public:
+  SnoopRemoteServerThread(SnoopRemoteServer* server);
+  virtual ~SnoopRemoteServerThread();
+
+protected:
+  SnoopRemoteServer*         server;  // reference
+  QList<SnoopRemoteSession*> pending; // handshaking, touched by this thread only
+
+protected:
+  void accept();
+  void handshakes(pollfd* fds, bool polled);
+
+protected:
+  virtual void run();
+};
+
+// ----------------------------------------------------------------------------
+// SnoopRemoteServer
+// ----------------------------------------------------------------------------
+/// Serves packets of write() slot to SnoopRemote clients over TCP.
+/// Each client gets its own BPF filter and batch, a client that can not keep up loses whole batches(drops).
+/// Handshake is read as it arrives, so a slow or silent client never holds up flush of the others.
+class SnoopRemoteServer : public SnoopProcess, public VLockable
+{
+  Q_OBJECT
+  Q_CLASSINFO("fanout", "shared") // one listening port for every fanout worker
+
+  friend class SnoopRemoteServerThread;
+
+public:
+  SnoopRemoteServer(void* owner = NULL);
+  virtual ~SnoopRemoteServer();
+
+  //
+  // Properties
+  //
+public:
+  QString bindAddress;  // listening address(empty : any)
+  QString secret;       // client must send the same(empty : not checked)
+  QString allowedPeers; // ';' separated client addresses(empty : any)
+  int port;
+  int linkType;      // of packets coming into write()
+  int batchCount;    // packets in one batch
+  int batchBytes;    // payload bytes in one batch
+  int flushInterval; // msec, batch is sent at the latest after this
+  int maxClients;
+
+protected:
+  int                         m_acceptSock;
+  QList<SnoopRemoteSession*>  sessions;
+  SnoopRemoteServerThread*    thread;
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+protected:
+  bool                allowed(QString address);
+  int                 handshake(SnoopRemoteSession* session); // 1 : done, 0 : wait more, -1 : refused
+  void                flush(SnoopRemoteSession* session);
+  void                flushIdle();
+  void                removeDead();
+
+public slots:
+  void write(SnoopPacket* packet);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_REMOTE_SERVER_H__
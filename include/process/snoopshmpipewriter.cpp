@@ -0,0 +1,92 @@
+#include <SnoopShmPipeWriter>
+#include <VDebugNew>
+
+#ifdef linux
+
+REGISTER_METACLASS(SnoopShmPipeWriter, SnoopProcess)
+
+// ----------------------------------------------------------------------------
+// SnoopShmPipeWriter
+// ----------------------------------------------------------------------------
+SnoopShmPipeWriter::SnoopShmPipeWriter(void* owner) : SnoopProcess(owner)
+{
+  pipeName = "snoop";
+  pipeSize = 64 * 1024 * 1024; // 64 MB
+}
+
+SnoopShmPipeWriter::~SnoopShmPipeWriter()
+{
+  close();
+}
+
+bool SnoopShmPipeWriter::doOpen()
+{
+  m_ring.name = pipeName;
+  m_ring.size = pipeSize;
+  if (!m_ring.open(false))
+  {
+    error = m_ring.error;
+    return false;
+  }
+  return true;
+}
+
+bool SnoopShmPipeWriter::doClose()
+{
+  if (m_ring.active())
+  {
+    LOG_INFO("%s written=%llu drops=%llu", qPrintable(pipeName), m_ring.written(), m_ring.drops());
+    m_ring.close();
+  }
+  return true;
+}
+
+void SnoopShmPipeWriter::write(SnoopPacket* packet)
+{
+  if (!m_ring.active()) return;
+  bool res;
+  {
+    VLock lock(*this);
+    res = m_ring.push(packet);
+  }
+  if (res)
+    emit written(packet);
+  else
+    emit dropped(packet);
+}
+
+void SnoopShmPipeWriter::load(VXml xml)
+{
+  SnoopProcess::load(xml);
+
+  pipeName = xml.getStr("pipeName", pipeName);
+  pipeSize = xml.getInt("pipeSize", pipeSize);
+}
+
+void SnoopShmPipeWriter::save(VXml xml)
+{
+  SnoopProcess::save(xml);
+
+  xml.setStr("pipeName", pipeName);
+  xml.setInt("pipeSize", pipeSize);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopShmPipeWriter::optionAddWidget(QLayout* layout)
+{
+  SnoopProcess::optionAddWidget(layout);
+
+  VOptionable::addLineEdit(layout, "lePipeName", "Pipe Name", pipeName);
+  VOptionable::addLineEdit(layout, "lePipeSize", "Pipe Size", QString::number(pipeSize));
+}
+
+void SnoopShmPipeWriter::optionSaveDlg(QDialog* dialog)
+{
+  SnoopProcess::optionSaveDlg(dialog);
+
+  pipeName = dialog->findChild<QLineEdit*>("lePipeName")->text();
+  pipeSize = dialog->findChild<QLineEdit*>("lePipeSize")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#endif // linux
@@ -0,0 +1,69 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_SHM_PIPE_WRITER_H__
+#define __SNOOP_SHM_PIPE_WRITER_H__
+
+#include <SnoopProcess>
+#include <VLock>
+#include <SnoopShmRing>
+
+#ifdef linux
+
+// ----------------------------------------------------------------------------
+// SnoopShmPipeWriter
+// ----------------------------------------------------------------------------
+/// Pushes packets into shared memory ring read by SnoopShmPipe.
+/// Ring has one writer : write() from several capture threads(fanout workers) is serialized.
+class SnoopShmPipeWriter : public SnoopProcess, public VLockable
+{
+  Q_OBJECT
+  Q_CLASSINFO("fanout", "shared")
+
+public:
+  SnoopShmPipeWriter(void* owner = NULL);
+  virtual ~SnoopShmPipeWriter();
+
+public:
+  QString pipeName;
+  int     pipeSize;
+
+protected:
+  SnoopShmRing m_ring;
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+public:
+  UINT64 pushCount() { return m_ring.written(); }
+  UINT64 dropCount() { return m_ring.drops();   }
+
+public slots:
+  void write(SnoopPacket* packet);
+
+signals:
+  void written(SnoopPacket* packet);
+  void dropped(SnoopPacket* packet);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux
+
+#endif // __SNOOP_SHM_PIPE_WRITER_H__
@@ -0,0 +1,648 @@
+#include <SnoopXdpOffload>
+#include <SnoopAdapter>
+#include <SnoopBpFilter>
+#include <SnoopPacketMmap>
+#include <SnoopXdpCapture>
+#include <VDebugNew>
+
+#if defined(linux) && defined(SNOOP_XDP)
+
+#include <errno.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <xdp/libxdp.h>
+
+REGISTER_METACLASS(SnoopXdpOffload, SnoopProcess)
+
+// ----------------------------------------------------------------------------
+// SnoopXdpFlow
+// ----------------------------------------------------------------------------
+QString SnoopXdpFlow::str()
+{
+  char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &key.saddr, src, sizeof(src));
+  inet_ntop(AF_INET, &key.daddr, dst, sizeof(dst));
+  return qformat("%s:%u > %s:%u proto=%u packets=%llu bytes=%llu drops=%llu",
+    src, ntohs(key.sport), dst, ntohs(key.dport), key.proto,
+    (unsigned long long)value.packets, (unsigned long long)value.bytes, (unsigned long long)value.drops);
+}
+
+// ----------------------------------------------------------------------------
+// filter compile
+// ----------------------------------------------------------------------------
+//
+// Primitive gives one or two alternatives("host", "net" and "port" without direction match either side).
+//
+static bool parsePrimitive(QStringList t, QList<snoop_xdp_rule>& alts, QString& reason)
+{
+  snoop_xdp_rule rule;
+  memset(&rule, 0, sizeof(rule));
+  int n = t.count();
+  int i = 0;
+
+  if (t[i] == "tcp")       { rule.proto = IPPROTO_TCP;  i++; }
+  else if (t[i] == "udp")  { rule.proto = IPPROTO_UDP;  i++; }
+  else if (t[i] == "icmp") { rule.proto = IPPROTO_ICMP; i++; }
+  else if (t[i] == "sctp") { rule.proto = IPPROTO_SCTP; i++; }
+  else if (t[i] == "ip")
+  {
+    i++;
+    if (i < n && t[i] == "proto")
+    {
+      if (++i >= n) { reason = "proto value missing"; return false; }
+      QString v = t[i++];
+      bool ok;
+      int proto = v.toInt(&ok);
+      if (v == "tcp") proto = IPPROTO_TCP;
+      else if (v == "udp") proto = IPPROTO_UDP;
+      else if (v == "icmp") proto = IPPROTO_ICMP;
+      else if (v == "sctp") proto = IPPROTO_SCTP;
+      else if (!ok || proto <= 0 || proto > 255) { reason = "unknown proto " + v; return false; }
+      rule.proto = (__u8)proto;
+    }
+  }
+  if (i == n)
+  {
+    alts.push_back(rule);
+    return true;
+  }
+
+  int dir = 0; // 1 : src, 2 : dst, 0 : either
+  if (t[i] == "src")      { dir = 1; i++; }
+  else if (t[i] == "dst") { dir = 2; i++; }
+  if (i >= n) { reason = "value missing"; return false; }
+
+  QString type = "host";
+  if (t[i] == "host" || t[i] == "net" || t[i] == "port") type = t[i++];
+  if (i != n - 1) { reason = "unsupported primitive " + t.join(" "); return false; }
+  QString v = t[i];
+
+  __u32 addr = 0, mask = 0;
+  __u16 port = 0;
+  if (type == "port")
+  {
+    bool ok;
+    int _port = v.toInt(&ok);
+    if (!ok || _port <= 0 || _port > 65535) { reason = "unsupported port " + v; return false; }
+    if (rule.proto == IPPROTO_ICMP) { reason = "icmp has no port"; return false; }
+    port = htons((__u16)_port);
+  } else
+  {
+    int prefix = 32;
+    QString a = v;
+    if (type == "net" && v.contains('/'))
+    {
+      a = v.section('/', 0, 0);
+      bool ok;
+      prefix = v.section('/', 1).toInt(&ok);
+      if (!ok || prefix < 0 || prefix > 32) { reason = "invalid net " + v; return false; }
+    }
+    in_addr ia;
+    if (inet_pton(AF_INET, qPrintable(a), &ia) != 1) { reason = "unsupported address " + v; return false; }
+    mask = prefix == 0 ? 0 : htonl(0xFFFFFFFF << (32 - prefix));
+    addr = ia.s_addr & mask;
+  }
+
+  for (int d = 1; d <= 2; d++)
+  {
+    if (dir != 0 && dir != d) continue;
+    snoop_xdp_rule alt = rule;
+    if (type == "port")
+    {
+      if (d == 1) alt.sport = port; else alt.dport = port;
+    } else
+    {
+      if (d == 1) { alt.saddr = addr; alt.smask = mask; } else { alt.daddr = addr; alt.dmask = mask; }
+    }
+    alts.push_back(alt);
+  }
+  return true;
+}
+
+//
+// Intersection of two rules, false if no packet can match both.
+//
+static bool mergeRule(const snoop_xdp_rule& a, const snoop_xdp_rule& b, snoop_xdp_rule& res)
+{
+  if (a.proto != 0 && b.proto != 0 && a.proto != b.proto) return false;
+  if (((a.saddr ^ b.saddr) & a.smask & b.smask) != 0) return false;
+  if (((a.daddr ^ b.daddr) & a.dmask & b.dmask) != 0) return false;
+  if (a.sport != 0 && b.sport != 0 && a.sport != b.sport) return false;
+  if (a.dport != 0 && b.dport != 0 && a.dport != b.dport) return false;
+
+  memset(&res, 0, sizeof(res));
+  res.proto = a.proto != 0 ? a.proto : b.proto;
+  res.saddr = a.saddr | b.saddr;
+  res.smask = a.smask | b.smask;
+  res.daddr = a.daddr | b.daddr;
+  res.dmask = a.dmask | b.dmask;
+  res.sport = a.sport != 0 ? a.sport : b.sport;
+  res.dport = a.dport != 0 ? a.dport : b.dport;
+  if (res.proto == IPPROTO_ICMP && (res.sport != 0 || res.dport != 0)) return false;
+  return true;
+}
+
+bool SnoopXdpOffload::compile(QString filter, QVector<snoop_xdp_rule>& rules, QString& reason)
+{
+  rules.clear();
+  QString f = filter.toLower();
+  f.replace("&&", " and ").replace("||", " or ");
+  if (f.contains('(') || f.contains(')') || f.contains('!'))
+  {
+    reason = "parenthesis and negation are not offloaded";
+    return false;
+  }
+  QStringList tokens = f.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+  if (tokens.isEmpty()) return true; // count only
+  if (tokens.contains("not"))
+  {
+    reason = "negation is not offloaded";
+    return false;
+  }
+
+  //
+  // "a and b or c" : or of ands, each and expands to rules(product of alternatives).
+  //
+  tokens.append("or");
+  QList<snoop_xdp_rule> conj;
+  QStringList primitive;
+  snoop_xdp_rule any;
+  memset(&any, 0, sizeof(any));
+  conj.push_back(any);
+  foreach (const QString& token, tokens)
+  {
+    if (token != "and" && token != "or")
+    {
+      primitive.append(token);
+      continue;
+    }
+    if (primitive.isEmpty())
+    {
+      reason = "empty primitive";
+      return false;
+    }
+    QList<snoop_xdp_rule> alts;
+    if (!parsePrimitive(primitive, alts, reason)) return false;
+    primitive.clear();
+
+    QList<snoop_xdp_rule> next;
+    foreach (const snoop_xdp_rule& a, conj)
+      foreach (const snoop_xdp_rule& b, alts)
+      {
+        snoop_xdp_rule merged;
+        if (mergeRule(a, b, merged)) next.push_back(merged);
+      }
+    conj = next;
+    if (conj.count() > SNOOP_XDP_MAX_RULES)
+    {
+      reason = "too many rules";
+      return false;
+    }
+
+    if (token == "or")
+    {
+      foreach (const snoop_xdp_rule& r, conj) rules.push_back(r);
+      if (rules.count() > SNOOP_XDP_MAX_RULES)
+      {
+        reason = "too many rules";
+        return false;
+      }
+      conj.clear();
+      conj.push_back(any);
+    }
+  }
+  if (rules.isEmpty())
+  {
+    reason = "filter matches nothing offloadable";
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// SnoopXdpOffload
+// ----------------------------------------------------------------------------
+SnoopXdpOffload::SnoopXdpOffload(void* owner) : SnoopProcess(owner)
+{
+  captureName = "";
+  filterName  = "";
+  filter      = "";
+  objectPath  = "snoopxdpfilter.bpf.o";
+  skbMode     = false;
+  flowCount   = 65536;
+  topFlows    = 10;
+
+  m_prog      = NULL;
+  m_ifIndex   = 0;
+  m_skbMode   = false;
+  m_statsFd   = -1;
+  m_flowsFd   = -1;
+  m_ruleCount = 0;
+}
+
+SnoopXdpOffload::~SnoopXdpOffload()
+{
+  close();
+}
+
+bool SnoopXdpOffload::resolve(QString& devName, QString& _filter)
+{
+  VGraph* graph = (VGraph*)owner;
+  if (graph == NULL)
+  {
+    SET_ERROR(SnoopError, "offload is not owned by graph", VERR_OBJECT_IS_NULL);
+    return false;
+  }
+
+  VObject* capture = graph->objectList.findByName(captureName);
+  int adapterIndex = snoop::INVALID_ADAPTER_INDEX;
+  if (dynamic_cast<SnoopAdapter*>(capture) != NULL)         adapterIndex = ((SnoopAdapter*)capture)->adapterIndex;
+  else if (dynamic_cast<SnoopPacketMmap*>(capture) != NULL) adapterIndex = ((SnoopPacketMmap*)capture)->adapterIndex;
+  else if (dynamic_cast<SnoopXdpCapture*>(capture) != NULL) adapterIndex = ((SnoopXdpCapture*)capture)->adapterIndex;
+  else
+  {
+    SET_ERROR(SnoopError, qformat("can not find adapter capture(%s)", qPrintable(captureName)), VERR_CAN_NOT_FIND_OBJECT);
+    return false;
+  }
+  if (adapterIndex == snoop::INVALID_ADAPTER_INDEX)
+  {
+    SET_ERROR(SnoopError, "invalid adapter index(-1)", VERR_INVALID_INDEX);
+    return false;
+  }
+  devName = SnoopInterfaces::instance().at(adapterIndex).name;
+
+  _filter = filter;
+  if (filterName != "")
+  {
+    SnoopBpFilter* bpFilter = dynamic_cast<SnoopBpFilter*>(graph->objectList.findByName(filterName));
+    if (bpFilter == NULL)
+    {
+      SET_ERROR(SnoopError, qformat("can not find filter(%s)", qPrintable(filterName)), VERR_CAN_NOT_FIND_OBJECT);
+      return false;
+    }
+    _filter = bpFilter->filter;
+  }
+  return true;
+}
+
+bool SnoopXdpOffload::doOpen()
+{
+  QString devName, _filter;
+  if (!resolve(devName, _filter)) return false;
+  m_ifIndex = (int)if_nametoindex(qPrintable(devName));
+  if (m_ifIndex == 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in if_nametoindex(%s)", qPrintable(devName)), VERR_INVALID_INDEX);
+    return false;
+  }
+
+  //
+  // Rules that can not express filter exactly would drop wanted packets, so then only flows are counted.
+  //
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+  if (!compile(_filter, rules, reason))
+  {
+    LOG_WARN("filter \"%s\" is not offloaded(%s)", qPrintable(_filter), qPrintable(reason));
+    rules.clear();
+  }
+
+  m_prog = xdp_program__open_file(qPrintable(objectPath), "xdp", NULL);
+  int res = libxdp_get_error(m_prog);
+  if (res != 0)
+  {
+    m_prog = NULL;
+    SET_ERROR(SnoopError, qformat("error in xdp_program__open_file(%s)(%s)", qPrintable(objectPath), strerror(-res)), VERR_FAIL);
+    return false;
+  }
+  bpf_object* obj = xdp_program__bpf_obj(m_prog);
+  bpf_map* flowsMap = bpf_object__find_map_by_name(obj, "snoop_flows");
+  if (flowsMap != NULL && flowCount > 0) bpf_map__set_max_entries(flowsMap, (__u32)flowCount);
+  xdp_program__set_run_prio(m_prog, 10); // before AF_XDP redirect program of SnoopXdpCapture
+
+  //
+  // Native mode first, then generic mode(veth without native support, for example).
+  //
+  res = -EOPNOTSUPP;
+  if (!skbMode)
+  {
+    res = xdp_program__attach(m_prog, m_ifIndex, XDP_MODE_NATIVE, 0);
+    m_skbMode = false;
+  }
+  if (res != 0)
+  {
+    res = xdp_program__attach(m_prog, m_ifIndex, XDP_MODE_SKB, 0);
+    m_skbMode = true;
+  }
+  if (res != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in xdp_program__attach(%s)(%s)", qPrintable(devName), strerror(-res)), VERR_FAIL);
+    xdp_program__close(m_prog);
+    m_prog = NULL;
+    return false;
+  }
+
+  int rulesFd  = bpf_object__find_map_fd_by_name(obj, "snoop_rules");
+  int configFd = bpf_object__find_map_fd_by_name(obj, "snoop_config");
+  m_statsFd    = bpf_object__find_map_fd_by_name(obj, "snoop_stats");
+  m_flowsFd    = bpf_object__find_map_fd_by_name(obj, "snoop_flows");
+  if (rulesFd < 0 || configFd < 0 || m_statsFd < 0 || m_flowsFd < 0)
+  {
+    SET_ERROR(SnoopError, qformat("map not found in %s", qPrintable(objectPath)), VERR_FAIL);
+    return false;
+  }
+
+  //
+  // Rules go first, ruleCount last, so that program never sees half written rule set.
+  //
+  for (int i = 0; i < rules.count(); i++)
+  {
+    __u32 key = (__u32)i;
+    if (bpf_map_update_elem(rulesFd, &key, &rules[i], BPF_ANY) != 0)
+    {
+      SET_ERROR(SnoopError, qformat("error in bpf_map_update_elem(rules)(%s)", strerror(errno)), VERR_FAIL);
+      return false;
+    }
+  }
+  snoop_xdp_config config;
+  memset(&config, 0, sizeof(config));
+  config.ruleCount = (__u32)rules.count();
+  __u32 zero = 0;
+  if (bpf_map_update_elem(configFd, &zero, &config, BPF_ANY) != 0)
+  {
+    SET_ERROR(SnoopError, qformat("error in bpf_map_update_elem(config)(%s)", strerror(errno)), VERR_FAIL);
+    return false;
+  }
+  m_ruleCount = rules.count();
+
+  LOG_INFO("attached to %s(%s mode) filter=\"%s\" rules=%d", qPrintable(devName), m_skbMode ? "skb" : "native", qPrintable(_filter), m_ruleCount);
+  return SnoopProcess::doOpen();
+}
+
+bool SnoopXdpOffload::doClose()
+{
+  if (m_prog != NULL)
+  {
+    UINT64 pass, drop, other;
+    if (readStats(pass, drop, other))
+      LOG_INFO("pass=%llu drop=%llu other=%llu", pass, drop, other);
+    QList<SnoopXdpFlow> flows;
+    if (topFlows > 0 && readFlows(flows))
+    {
+      for (int i = 0; i < flows.count() && i < topFlows; i++)
+        LOG_INFO("%s", qPrintable(flows[i].str()));
+    }
+
+    xdp_program__detach(m_prog, m_ifIndex, m_skbMode ? XDP_MODE_SKB : XDP_MODE_NATIVE, 0);
+    xdp_program__close(m_prog);
+    m_prog = NULL;
+  }
+  m_statsFd   = -1;
+  m_flowsFd   = -1;
+  m_ruleCount = 0;
+
+  return SnoopProcess::doClose();
+}
+
+bool SnoopXdpOffload::readStats(UINT64& pass, UINT64& drop, UINT64& other)
+{
+  if (m_statsFd < 0) return false;
+  int cpus = libbpf_num_possible_cpus();
+  if (cpus <= 0) return false;
+  QVector<__u64> values(cpus);
+  UINT64 sum[SNOOP_XDP_STAT_MAX];
+  for (__u32 key = 0; key < SNOOP_XDP_STAT_MAX; key++)
+  {
+    sum[key] = 0;
+    if (bpf_map_lookup_elem(m_statsFd, &key, values.data()) != 0) return false;
+    for (int c = 0; c < cpus; c++) sum[key] += values[c];
+  }
+  pass  = sum[SNOOP_XDP_STAT_PASS];
+  drop  = sum[SNOOP_XDP_STAT_DROP];
+  other = sum[SNOOP_XDP_STAT_OTHER];
+  return true;
+}
+
+static bool flowGreater(const SnoopXdpFlow& a, const SnoopXdpFlow& b)
+{
+  return a.value.packets > b.value.packets;
+}
+
+bool SnoopXdpOffload::readFlows(QList<SnoopXdpFlow>& flows)
+{
+  flows.clear();
+  if (m_flowsFd < 0) return false;
+  int cpus = libbpf_num_possible_cpus();
+  if (cpus <= 0) return false;
+  QVector<snoop_xdp_flow_value> values(cpus);
+
+  snoop_xdp_flow_key key, prevKey;
+  bool first = true;
+  while (bpf_map_get_next_key(m_flowsFd, first ? NULL : &prevKey, &key) == 0)
+  {
+    first   = false;
+    prevKey = key;
+    if (bpf_map_lookup_elem(m_flowsFd, &key, values.data()) != 0) continue; // evicted meanwhile
+    SnoopXdpFlow flow;
+    flow.key = key;
+    memset(&flow.value, 0, sizeof(flow.value));
+    for (int c = 0; c < cpus; c++)
+    {
+      flow.value.packets += values[c].packets;
+      flow.value.bytes   += values[c].bytes;
+      flow.value.drops   += values[c].drops;
+    }
+    flows.push_back(flow);
+  }
+  qSort(flows.begin(), flows.end(), flowGreater);
+  return true;
+}
+
+void SnoopXdpOffload::load(VXml xml)
+{
+  SnoopProcess::load(xml);
+
+  captureName = xml.getStr("captureName", captureName);
+  filterName  = xml.getStr("filterName", filterName);
+  filter      = xml.getStr("filter", filter);
+  objectPath  = xml.getStr("objectPath", objectPath);
+  skbMode     = xml.getBool("skbMode", skbMode);
+  flowCount   = xml.getInt("flowCount", flowCount);
+  topFlows    = xml.getInt("topFlows", topFlows);
+}
+
+void SnoopXdpOffload::save(VXml xml)
+{
+  SnoopProcess::save(xml);
+
+  xml.setStr("captureName", captureName);
+  xml.setStr("filterName", filterName);
+  xml.setStr("filter", filter);
+  xml.setStr("objectPath", objectPath);
+  xml.setBool("skbMode", skbMode);
+  xml.setInt("flowCount", flowCount);
+  xml.setInt("topFlows", topFlows);
+}
+
+#ifdef QT_GUI_LIB
+void SnoopXdpOffload::optionAddWidget(QLayout* layout)
+{
+  SnoopProcess::optionAddWidget(layout);
+
+  QStringList captureList = ((VGraph*)owner)->objectList.findNamesByCategoryName("SnoopCapture");
+  VOptionable::addComboBox(layout, "cbxCapture", "Capture", captureList, -1, captureName);
+  QStringList filterList = ((VGraph*)owner)->objectList.findNamesByClassName("SnoopBpFilter");
+  VOptionable::addComboBox(layout, "cbxFilter", "BpFilter", filterList, -1, filterName);
+  VOptionable::addLineEdit(layout, "leFilter",     "Filter",      filter);
+  VOptionable::addLineEdit(layout, "leObjectPath", "Object Path", objectPath);
+  VOptionable::addCheckBox(layout, "chkSkbMode",   "SKB Mode",    skbMode);
+  VOptionable::addLineEdit(layout, "leFlowCount",  "Flow Count",  QString::number(flowCount));
+  VOptionable::addLineEdit(layout, "leTopFlows",   "Top Flows",   QString::number(topFlows));
+}
+
+void SnoopXdpOffload::optionSaveDlg(QDialog* dialog)
+{
+  SnoopProcess::optionSaveDlg(dialog);
+
+  captureName = dialog->findChild<QComboBox*>("cbxCapture")->currentText();
+  filterName  = dialog->findChild<QComboBox*>("cbxFilter")->currentText();
+  filter      = dialog->findChild<QLineEdit*>("leFilter")->text();
+  objectPath  = dialog->findChild<QLineEdit*>("leObjectPath")->text();
+  skbMode     = dialog->findChild<QCheckBox*>("chkSkbMode")->checkState() == Qt::Checked;
+  flowCount   = dialog->findChild<QLineEdit*>("leFlowCount")->text().toInt();
+  topFlows    = dialog->findChild<QLineEdit*>("leTopFlows")->text().toInt();
+}
+#endif // QT_GUI_LIB
+
+#ifdef GTEST
+#include <gtest/gtest.h>
+
+static __u32 xdpAddr(const char* s)
+{
+  in_addr ia;
+  inet_pton(AF_INET, s, &ia);
+  return ia.s_addr;
+}
+
+TEST( SnoopXdpOffload, empty )
+{
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+  EXPECT_TRUE( SnoopXdpOffload::compile("", rules, reason) );
+  EXPECT_EQ( 0, rules.count() );
+}
+
+TEST( SnoopXdpOffload, direction )
+{
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+
+  EXPECT_TRUE( SnoopXdpOffload::compile("src host 1.2.3.4", rules, reason) );
+  ASSERT_EQ( 1, rules.count() );
+  EXPECT_EQ( xdpAddr("1.2.3.4"), rules[0].saddr );
+  EXPECT_EQ( 0xFFFFFFFF, rules[0].smask );
+  EXPECT_EQ( 0u, rules[0].dmask );
+
+  EXPECT_TRUE( SnoopXdpOffload::compile("dst port 53", rules, reason) );
+  ASSERT_EQ( 1, rules.count() );
+  EXPECT_EQ( 0, rules[0].sport );
+  EXPECT_EQ( htons(53), rules[0].dport );
+
+  //
+  // No direction : one rule for each side.
+  //
+  EXPECT_TRUE( SnoopXdpOffload::compile("host 1.2.3.4", rules, reason) );
+  ASSERT_EQ( 2, rules.count() );
+  EXPECT_EQ( xdpAddr("1.2.3.4"), rules[0].saddr );
+  EXPECT_EQ( 0u, rules[0].dmask );
+  EXPECT_EQ( xdpAddr("1.2.3.4"), rules[1].daddr );
+  EXPECT_EQ( 0u, rules[1].smask );
+}
+
+TEST( SnoopXdpOffload, net )
+{
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+
+  EXPECT_TRUE( SnoopXdpOffload::compile("src net 10.1.2.3/8", rules, reason) );
+  ASSERT_EQ( 1, rules.count() );
+  EXPECT_EQ( xdpAddr("10.0.0.0"), rules[0].saddr );
+  EXPECT_EQ( htonl(0xFF000000), rules[0].smask );
+
+  EXPECT_TRUE( SnoopXdpOffload::compile("dst net 0.0.0.0/0", rules, reason) );
+  ASSERT_EQ( 1, rules.count() );
+  EXPECT_EQ( 0u, rules[0].dmask );
+
+  EXPECT_FALSE( SnoopXdpOffload::compile("net 10.0.0.0/33", rules, reason) );
+}
+
+TEST( SnoopXdpOffload, andOr )
+{
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+
+  //
+  // and : product of alternatives(2 x 2).
+  //
+  EXPECT_TRUE( SnoopXdpOffload::compile("tcp port 80 and host 1.2.3.4", rules, reason) );
+  ASSERT_EQ( 4, rules.count() );
+  for (int i = 0; i < 4; i++) EXPECT_EQ( IPPROTO_TCP, rules[i].proto );
+  EXPECT_EQ( htons(80), rules[0].sport );
+  EXPECT_EQ( 0xFFFFFFFF, rules[0].smask );
+  EXPECT_EQ( htons(80), rules[1].sport );
+  EXPECT_EQ( 0xFFFFFFFF, rules[1].dmask );
+  EXPECT_EQ( htons(80), rules[2].dport );
+  EXPECT_EQ( 0xFFFFFFFF, rules[2].smask );
+  EXPECT_EQ( htons(80), rules[3].dport );
+  EXPECT_EQ( 0xFFFFFFFF, rules[3].dmask );
+
+  //
+  // or : rules of each side are appended.
+  //
+  EXPECT_TRUE( SnoopXdpOffload::compile("src host 1.2.3.4 || udp", rules, reason) );
+  ASSERT_EQ( 2, rules.count() );
+  EXPECT_EQ( xdpAddr("1.2.3.4"), rules[0].saddr );
+  EXPECT_EQ( 0, rules[0].proto );
+  EXPECT_EQ( IPPROTO_UDP, rules[1].proto );
+  EXPECT_EQ( 0u, rules[1].smask );
+
+  //
+  // and binds tighter than or.
+  //
+  EXPECT_TRUE( SnoopXdpOffload::compile("udp and dst port 53 or icmp", rules, reason) );
+  ASSERT_EQ( 2, rules.count() );
+  EXPECT_EQ( IPPROTO_UDP, rules[0].proto );
+  EXPECT_EQ( htons(53), rules[0].dport );
+  EXPECT_EQ( IPPROTO_ICMP, rules[1].proto );
+
+  //
+  // Conjunction nothing can match is dropped.
+  //
+  EXPECT_TRUE( SnoopXdpOffload::compile("tcp and udp or ip proto 47", rules, reason) );
+  ASSERT_EQ( 1, rules.count() );
+  EXPECT_EQ( 47, rules[0].proto );
+  EXPECT_FALSE( SnoopXdpOffload::compile("tcp and udp", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("tcp and", rules, reason) );
+}
+
+TEST( SnoopXdpOffload, reject )
+{
+  QVector<snoop_xdp_rule> rules;
+  QString reason;
+
+  EXPECT_FALSE( SnoopXdpOffload::compile("not tcp", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("! tcp", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("(tcp or udp) and port 80", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("portrange 1-1024", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("host www.example.com", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("ip6", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("ip6 host ::1", rules, reason) );
+  EXPECT_FALSE( SnoopXdpOffload::compile("icmp port 7", rules, reason) );
+  EXPECT_FALSE( reason.isEmpty() );
+}
+#endif // GTEST
+
+#endif // linux && SNOOP_XDP
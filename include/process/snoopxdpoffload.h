@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------
+//
+// Snoop Component Suite version 9.0
+//
+// http://www.gilgil.net
+//
+// Copyright (c) Gilbert Lee All rights reserved
+//
+// ----------------------------------------------------------------------------
+
+#ifndef __SNOOP_XDP_OFFLOAD_H__
+#define __SNOOP_XDP_OFFLOAD_H__
+
+#include <SnoopProcess>
+
+#if defined(linux) && defined(SNOOP_XDP)
+
+#include <ebpf/snoopxdpfilter.h>
+
+struct xdp_program;
+
+// ----------------------------------------------------------------------------
+// SnoopXdpFlow
+// ----------------------------------------------------------------------------
+class SnoopXdpFlow
+{
+public:
+  snoop_xdp_flow_key   key;
+  snoop_xdp_flow_value value; // summed over cpus
+
+public:
+  QString str();
+};
+
+// ----------------------------------------------------------------------------
+// SnoopXdpOffload
+// ----------------------------------------------------------------------------
+/// Attaches snoopxdpfilter.bpf.o to the interface of a capture. IPv4 packets the filter surely rejects
+/// are dropped in kernel before being copied to user, and every IPv4 flow is counted in a BPF map.
+/// Only host, net, port and protocol primitives joined by and/or are offloaded, otherwise nothing is dropped.
+/// A dropped packet does not reach the host stack either, so use it on monitoring or in-path interfaces.
+class SnoopXdpOffload : public SnoopProcess
+{
+  Q_OBJECT
+  Q_CLASSINFO("fanout", "shared") // program is attached once per interface
+
+public:
+  SnoopXdpOffload(void* owner = NULL);
+  virtual ~SnoopXdpOffload();
+
+  //
+  // Properties
+  //
+public:
+  QString captureName; // capture whose adapter gets the program
+  QString filterName;  // SnoopBpFilter whose filter is offloaded(empty : filter)
+  QString filter;
+  QString objectPath;
+  bool    skbMode;     // force generic(SKB) mode
+  int     flowCount;   // flow map entries(LRU)
+  int     topFlows;    // flows logged on close
+
+protected:
+  xdp_program* m_prog;
+  int          m_ifIndex;
+  bool         m_skbMode; // mode actually attached
+  int          m_statsFd;
+  int          m_flowsFd;
+  int          m_ruleCount;
+
+protected:
+  virtual bool doOpen();
+  virtual bool doClose();
+
+protected:
+  bool resolve(QString& devName, QString& _filter);
+
+public:
+  static bool compile(QString filter, QVector<snoop_xdp_rule>& rules, QString& reason);
+
+public:
+  int  ruleCount() { return m_ruleCount; }
+  bool readStats(UINT64& pass, UINT64& drop, UINT64& other);
+  bool readFlows(QList<SnoopXdpFlow>& flows);
+
+public:
+  virtual void load(VXml xml);
+  virtual void save(VXml xml);
+
+#ifdef QT_GUI_LIB
+public: // for VOptionable
+  virtual void optionAddWidget(QLayout* layout);
+  virtual void optionSaveDlg(QDialog* dialog);
+#endif // QT_GUI_LIB
+};
+
+#endif // linux && SNOOP_XDP
+
+#endif // __SNOOP_XDP_OFFLOAD_H__
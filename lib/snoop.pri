@@ -39,5 +39,50 @@ CONFIG(SNOOP_LIB_BUILD) {
 } else {
   win32:PRE_TARGETDEPS +=   $${SNOOP_PATH}/lib/$${SNOOP_LIB_NAME}.lib
   unix: PRE_TARGETDEPS +=   $${SNOOP_PATH}/lib/lib$${SNOOP_LIB_NAME}.a
-  unix:LIBS            +=  -lpcap
+  unix:LIBS            +=  -lpcap -lrt
+}
+
+#-------------------------------------------------
+# xdp (qmake CONFIG+=SNOOP_XDP)
+#-------------------------------------------------
+CONFIG(SNOOP_XDP) {
+  DEFINES              +=  SNOOP_XDP
+  unix:LIBS            +=  -lxdp -lbpf
+}
+
+#-------------------------------------------------
+# dpdk (qmake CONFIG+=SNOOP_DPDK, pkg-config libdpdk)
+#-------------------------------------------------
+CONFIG(SNOOP_DPDK) {
+  DEFINES              +=  SNOOP_DPDK
+  CONFIG               +=  link_pkgconfig
+  PKGCONFIG            +=  libdpdk
+}
+
+#-------------------------------------------------
+# netfilter queue (qmake CONFIG+=SNOOP_NFQUEUE)
+#-------------------------------------------------
+CONFIG(SNOOP_NFQUEUE) {
+  DEFINES              +=  SNOOP_NFQUEUE
+  unix:LIBS            +=  -lnetfilter_queue -lnfnetlink
+}
+
+#-------------------------------------------------
+# remote capture compression (qmake CONFIG+=SNOOP_LZ4)
+#-------------------------------------------------
+CONFIG(SNOOP_LZ4) {
+  DEFINES              +=  SNOOP_LZ4
+  unix:LIBS            +=  -llz4
+}
+
+#-------------------------------------------------
+# compressed capture file (qmake CONFIG+=SNOOP_ZLIB CONFIG+=SNOOP_ZSTD)
+#-------------------------------------------------
+CONFIG(SNOOP_ZLIB) {
+  DEFINES              +=  SNOOP_ZLIB
+  unix:LIBS            +=  -lz
+}
+CONFIG(SNOOP_ZSTD) {
+  DEFINES              +=  SNOOP_ZSTD
+  unix:LIBS            +=  -lzstd
 }
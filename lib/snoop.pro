@@ -19,12 +19,27 @@ SOURCES += \
     ../include/capture/snooparpspoof.cpp \
     ../include/capture/snoopcapture.cpp \
     ../include/capture/snoopcapturefactory.cpp \
+    ../include/capture/snoopdpdk.cpp \
+    ../include/capture/snoopfanout.cpp \
     ../include/capture/snoopfile.cpp \
+    ../include/capture/snoopfileindex.cpp \
+    ../include/capture/snoopfilemap.cpp \
+    ../include/capture/snoopfileset.cpp \
+    ../include/capture/snoopfilestream.cpp \
+    ../include/capture/snoopnfqueue.cpp \
+    ../include/capture/snooppacer.cpp \
+    ../include/capture/snooppacketmmap.cpp \
     ../include/capture/snooppcap.cpp \
     ../include/capture/snoopremote.cpp \
+    ../include/capture/snoopshmpipe.cpp \
+    ../include/capture/snoopshmring.cpp \
     ../include/capture/snoopsourcepcap.cpp \
+    ../include/capture/snooptun.cpp \
+    ../include/capture/snooptxqueue.cpp \
+    ../include/capture/snooptxring.cpp \
     ../include/capture/snoopvirtualnat.cpp \
     ../include/capture/snoopwindivert.cpp \
+    ../include/capture/snoopxdpcapture.cpp \
     ../include/common/snoopautodetectadapter.cpp \
     ../include/common/snoopcommon.cpp \
     ../include/common/snoopfindhost.cpp \
@@ -33,12 +48,14 @@ SOURCES += \
     ../include/common/snoopnetinfo.cpp \
     ../include/common/snoopnetstat.cpp \
     ../include/common/snooppacket.cpp \
+    ../include/common/snoopremoteproto.cpp \
     ../include/common/snooprtm.cpp \
     ../include/common/snooptype.cpp \
     ../include/common/snooptypekey.cpp \
     ../include/filter/snoopbpfilter.cpp \
     ../include/filter/snoopfilter.cpp \
     ../include/filter/snoopfilterfactory.cpp \
+    ../include/filter/snoopfilterpushdown.cpp \
     ../include/filter/snoopprocessfilter.cpp \
     ../include/filter/snoopprocessfilterwidget.cpp \
     ../include/parse/snooparp.cpp \
@@ -64,24 +81,43 @@ SOURCES += \
     ../include/process/snoopflowmgrtest.cpp \
     ../include/process/snoopprocess.cpp \
     ../include/process/snoopprocessfactory.cpp \
+    ../include/process/snoopreactor.cpp \
+    ../include/process/snoopremoteserver.cpp \
+    ../include/process/snoopshmpipewriter.cpp \
     ../include/process/snooptcpblock.cpp \
     ../include/process/snoopudpchunk.cpp \
     ../include/process/snoopudpreceiver.cpp \
     ../include/process/snoopudpsender.cpp \
     ../include/process/snoopwriteadapter.cpp \
-    ../include/process/snoopwritewindivert.cpp
+    ../include/process/snoopwritewindivert.cpp \
+    ../include/process/snoopxdpoffload.cpp
 
 HEADERS += \
     ../include/capture/snoopadapter.h \
     ../include/capture/snooparpspoof.h \
     ../include/capture/snoopcapture.h \
     ../include/capture/snoopcapturefactory.h \
+    ../include/capture/snoopdpdk.h \
+    ../include/capture/snoopfanout.h \
     ../include/capture/snoopfile.h \
+    ../include/capture/snoopfileindex.h \
+    ../include/capture/snoopfilemap.h \
+    ../include/capture/snoopfileset.h \
+    ../include/capture/snoopfilestream.h \
+    ../include/capture/snoopnfqueue.h \
+    ../include/capture/snooppacer.h \
+    ../include/capture/snooppacketmmap.h \
     ../include/capture/snooppcap.h \
     ../include/capture/snoopremote.h \
+    ../include/capture/snoopshmpipe.h \
+    ../include/capture/snoopshmring.h \
     ../include/capture/snoopsourcepcap.h \
+    ../include/capture/snooptun.h \
+    ../include/capture/snooptxqueue.h \
+    ../include/capture/snooptxring.h \
     ../include/capture/snoopvirtualnat.h \
     ../include/capture/snoopwindivert.h \
+    ../include/capture/snoopxdpcapture.h \
     ../include/common/snoop.h \
     ../include/common/snoopautodetectadapter.h \
     ../include/common/snoopcommon.h \
@@ -91,12 +127,15 @@ HEADERS += \
     ../include/common/snoopnetinfo.h \
     ../include/common/snoopnetstat.h \
     ../include/common/snooppacket.h \
+    ../include/common/snoopremoteproto.h \
     ../include/common/snooprtm.h \
     ../include/common/snooptype.h \
     ../include/common/snooptypekey.h \
+    ../include/ebpf/snoopxdpfilter.h \
     ../include/filter/snoopbpfilter.h \
     ../include/filter/snoopfilter.h \
     ../include/filter/snoopfilterfactory.h \
+    ../include/filter/snoopfilterpushdown.h \
     ../include/filter/snoopprocessfilter.h \
     ../include/filter/snoopprocessfilterwidget.h \
     ../include/libnet/config.h \
@@ -129,14 +168,30 @@ HEADERS += \
     ../include/process/snoopflowmgrtest.h \
     ../include/process/snoopprocess.h \
     ../include/process/snoopprocessfactory.h \
+    ../include/process/snoopreactor.h \
+    ../include/process/snoopremoteserver.h \
+    ../include/process/snoopshmpipewriter.h \
     ../include/process/snooptcpblock.h \
     ../include/process/snoopudpchunk.h \
     ../include/process/snoopudpreceiver.h \
     ../include/process/snoopudpsender.h \
     ../include/process/snoopwriteadapter.h \
     ../include/process/snoopwritewindivert.h \
+    ../include/process/snoopxdpoffload.h \
     ../include/windivert/windivert.h
 
 FORMS += \
     ../include/filter/snoopprocessfilterwidget.ui \
     ../include/process/snoopcommandwidget.ui
+
+#-------------------------------------------------
+# xdp offload program (clang -target bpf into bin)
+#-------------------------------------------------
+CONFIG(SNOOP_XDP) {
+  BPF_SOURCES           +=  ../include/ebpf/snoopxdpfilter.bpf.c
+  bpf.input              =  BPF_SOURCES
+  bpf.output             =  ../bin/${QMAKE_FILE_BASE}.o
+  bpf.commands           =  clang -O2 -g -target bpf -I../include/ebpf -c ${QMAKE_FILE_NAME} -o ${QMAKE_FILE_OUT}
+  bpf.CONFIG            +=  no_link target_predeps
+  QMAKE_EXTRA_COMPILERS +=  bpf
+}